@@ -0,0 +1,57 @@
+// Line rasterization throughput, single thread: random directions on a
+// 1920x1080 framebuffer, per halo thickness and line length. Uses only
+// resize/clear/line/flush, so the same file builds against older
+// rasterizers for before/after comparisons.
+//
+//   line_bench                default thickness/length table
+//   line_bench 2 200          one thickness and length
+#include "Rasterizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+
+static void run(int thick, int length) {
+    const int W = 1920, H = 1080;
+    // enough lines for a few milliseconds of work whatever the length
+    const int n = std::max(2000, 2000000 / (length * (2 * thick + 1)));
+    std::mt19937 rng(44 + thick * 1000 + length);
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    struct L { int x0, y0, x1, y1; float z0, z1; };
+    std::vector<L> lines(n);
+    for (L& l : lines) {
+        float a = u(rng) * 6.2831853f;
+        l.x0 = (int)(u(rng) * W); l.y0 = (int)(u(rng) * H);
+        l.x1 = l.x0 + (int)std::lround(length * std::cos(a));
+        l.y1 = l.y0 + (int)std::lround(length * std::sin(a));
+        l.z0 = u(rng); l.z1 = u(rng);
+    }
+
+    Rasterizer rast;
+    rast.resize(W, H);
+    double best = 1e30;
+    for (int rep = 0; rep < 5; rep++) {
+        rast.clear();
+        auto t0 = std::chrono::steady_clock::now();
+        for (const L& l : lines) rast.line(l.x0, l.y0, l.z0, l.x1, l.y1, l.z1, thick, {200, 120, 40}, 0.8f);
+        rast.flush(false);
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+    }
+    printf("  %5d  %6d  %7.2f\n", thick, length, n / best * 1e-6);
+}
+
+int main(int argc, char** argv) {
+    printf("  thick  length  M lines/s\n");
+    if (argc > 2) {
+        run(atoi(argv[1]), atoi(argv[2]));
+        return 0;
+    }
+    const std::pair<int, int> table[] = {{0, 8}, {0, 24}, {1, 8}, {1, 24}, {2, 8}, {2, 24}, {2, 200}};
+    for (const auto& [thick, length] : table) run(thick, length);
+    return 0;
+}
@@ -0,0 +1,68 @@
+// Normal-mode scaling: time NormalModes::compute on compact synthetic chains
+// of growing length, or on the CA traces of the structure files given.
+//
+//   nma_bench                 1k, 5k and 20k residues
+//   nma_bench 50000           any residue counts
+//   nma_bench file.cif ...    real structures
+#include "NormalModes.hpp"
+#include "StructureSearch.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+// a chain folded back and forth through a cube, one CA per 3.8 A step, with
+// a little jitter so no two contacts are exactly alike
+static CATrace compact_chain(int n) {
+    const float step = 3.8f;
+    int side = (int)std::ceil(std::cbrt((double)n));
+    std::mt19937 rng(n);
+    std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+    CATrace trace;
+    for (int r = 0; r < n; r++) {
+        int i = r % side, j = (r / side) % side, k = r / (side * side);
+        if (j % 2) i = side - 1 - i;
+        if (k % 2) j = side - 1 - j;
+        trace.push_back(i * step + jitter(rng), j * step + jitter(rng), k * step + jitter(rng),
+                        r + 1, "A", 'A');
+    }
+    return trace;
+}
+
+static void run(const std::string& name, const CATrace& trace) {
+    NormalModes modes;
+    auto t0 = std::chrono::steady_clock::now();
+    bool ok = modes.compute(trace, 3);
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    printf("%-24s %8zu residues %10zu contacts %4d iterations %9.3f s%s\n", name.c_str(),
+           trace.size(), modes.num_contacts(), modes.iterations(), s, ok ? "" : "  (no modes)");
+    if (ok) {
+        printf("%24s lowest eigenvalues", "");
+        for (int m = 0; m < modes.num_modes(); m++) printf(" %.5f", modes.eigenvalue(m));
+        printf("\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    if (args.empty()) args = {"1000", "5000", "20000"};
+    for (const std::string& a : args) {
+        char* end;
+        long n = strtol(a.c_str(), &end, 10);
+        if (*end == '\0' && n > 0) {
+            run("chain " + a, compact_chain((int)n));
+            continue;
+        }
+        CATrace trace;
+        if (!StructureSearch::read_ca_trace(a, trace)) {
+            fprintf(stderr, "cannot read %s\n", a.c_str());
+            return 1;
+        }
+        run(a, trace);
+    }
+    return 0;
+}
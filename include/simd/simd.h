@@ -39,7 +39,7 @@
 #define MAX_VECSIZE_INT		AVX512_VECSIZE_INT
 
 #define SIMDE_ENABLE_NATIVE_ALIASES
-#include "../commons/simde/simde-features.h"
+#include "simde/simde-features.h"
 
 // FIXME: Finish AVX512 implementation
 //#if defined(SIMDE_X86_AVX512F_NATIVE) && defined(SIMDE_X86_AVX512BW_NATIVE)
@@ -51,8 +51,8 @@
 #endif
 
 #ifdef AVX512
-#include "../commons/simde/x86/avx512f.h"
-#include "../commons/simde/x86/avx512bw.h"
+#include "simde/x86/avx512f.h"
+#include "simde/x86/avx512bw.h"
 
 // double support
 #ifndef SIMD_DOUBLE
@@ -86,11 +86,14 @@ typedef __m512  simd_float;
 #define simdf32_sub(x,y)    _mm512_sub_ps(x,y)
 #define simdf32_mul(x,y)    _mm512_mul_ps(x,y)
 #define simdf32_div(x,y)    _mm512_div_ps(x,y)
+#define simdf32_sqrt(x)     _mm512_sqrt_ps(x)
 #define simdf32_rcp(x)      _mm512_rcp_ps(x)
 #define simdf32_max(x,y)    _mm512_max_ps(x,y)
 #define simdf32_min(x,y)    _mm512_min_ps(x,y)
 #define simdf32_load(x)     _mm512_load_ps(x)
+#define simdf32_loadu(x)    _mm512_loadu_ps(x)
 #define simdf32_store(x,y)  _mm512_store_ps(x,y)
+#define simdf32_storeu(x,y) _mm512_storeu_ps(x,y)
 #define simdf32_set(x)      _mm512_set1_ps(x)
 #define simdf32_setzero(x)  _mm512_setzero_ps()
 #define simdf32_gt(x,y)     _mm512_cmpnle_ps_mask(x,y)
@@ -157,7 +160,7 @@ typedef __m512i simd_int;
 
 
 #ifdef AVX2
-#include "../commons/simde/x86/avx2.h"
+#include "simde/x86/avx2.h"
 // integer support  (usable with AVX2)
 #ifndef SIMD_INT
 #define SIMD_INT
@@ -283,7 +286,7 @@ typedef __m256i simd_int;
 #define simdi_i2fcast(x)    _mm256_castsi256_ps(x)
 #endif
 
-#include "../commons/simde/x86/avx.h"
+#include "simde/x86/avx.h"
 // double support (usable with AVX1)
 #ifndef SIMD_DOUBLE
 #define SIMD_DOUBLE
@@ -321,6 +324,7 @@ typedef __m256 simd_float;
 #define simdf32_max(x,y)    _mm256_max_ps(x,y)
 #define simdf32_min(x,y)    _mm256_min_ps(x,y)
 #define simdf32_load(x)     _mm256_load_ps(x)
+#define simdf32_loadu(x)    _mm256_loadu_ps(x)
 #define simdf32_store(x,y)  _mm256_store_ps(x,y)
 #define simdf32_storeu(x,y)   _mm256_storeu_ps(x,y)
 #define simdf32_set(x)      _mm256_set1_ps(x)
@@ -337,7 +341,7 @@ typedef __m256 simd_float;
 #endif
 #endif
 
-#include "../commons/simde/x86/sse4.1.h"
+#include "simde/x86/sse4.1.h"
 inline uint16_t simd_hmax16_sse(const __m128i buffer) {
     __m128i tmp1 = _mm_subs_epu16(_mm_set1_epi16((short)65535), buffer);
     __m128i tmp3 = _mm_minpos_epu16(tmp1);
@@ -393,11 +397,14 @@ typedef __m128  simd_float;
 #define simdf32_sub(x,y)    _mm_sub_ps(x,y)
 #define simdf32_mul(x,y)    _mm_mul_ps(x,y)
 #define simdf32_div(x,y)    _mm_div_ps(x,y)
+#define simdf32_sqrt(x)     _mm_sqrt_ps(x)
 #define simdf32_rcp(x)      _mm_rcp_ps(x)
 #define simdf32_max(x,y)    _mm_max_ps(x,y)
 #define simdf32_min(x,y)    _mm_min_ps(x,y)
 #define simdf32_load(x)     _mm_load_ps(x)
+#define simdf32_loadu(x)    _mm_loadu_ps(x)
 #define simdf32_store(x,y)  _mm_store_ps(x,y)
+#define simdf32_storeu(x,y) _mm_storeu_ps(x,y)
 #define simdf32_set(x)      _mm_set1_ps(x)
 #define simdf32_setzero(x)  _mm_setzero_ps()
 #define simdf32_gt(x,y)     _mm_cmpgt_ps(x,y)
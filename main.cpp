@@ -13,6 +13,7 @@ int main(int argc, char* argv[]) {
 
     bool use_sixel = params.get_sixel();
     UnicodeScreen screen(params.get_show_structure(), params.get_mode(), use_sixel);
+    screen.set_show_stats(params.get_show_stats());
 
     if (!params.get_pdb_id().empty()) {
         // Fetch specific PDB by ID
@@ -37,15 +38,32 @@ int main(int argc, char* argv[]) {
             screen.set_protein(params.get_in_file(i), i, params.get_show_structure());
         }
         screen.set_tmatrix();
+        screen.set_align(params.get_align());
+        screen.set_morph(params.get_morph());
         if (!params.get_utmatrix().empty()) {
             screen.set_utmatrix(params.get_utmatrix(), false);
         }
         screen.normalize_proteins(params.get_utmatrix());
+        if (!params.get_search_dir().empty()) {
+            screen.run_search(params.get_in_file(0), params.get_search_dir());
+        }
+    }
+
+    for (const std::string& sel : params.get_selections()) {
+        if (!screen.run_selection(sel)) {
+            std::cerr << "Error: invalid selection: " << sel << std::endl;
+            return -1;
+        }
+    }
+
+    if (!params.get_map_path().empty() && !screen.load_map(params.get_map_path(), params.get_map_level())) {
+        return -1;
     }
 
     // Headless render mode
     if (!params.get_render_path().empty()) {
-        if (screen.write_framebuffer_png(params.get_render_path())) {
+        if (screen.write_framebuffer_png(params.get_render_path(), params.get_render_width(),
+                                         params.get_render_height(), params.get_render_ssaa())) {
             std::cout << "Screenshot saved to " << params.get_render_path() << std::endl;
             return 0;
         } else {
@@ -6,6 +6,14 @@ struct Atom {
     float y;
     float z;
     char structure='x';        // 'x' : default, 'h' : helix, 's' : sheet
+    bool new_stroke=false;     // renderer: do not connect to the previous point
+    float occlusion=1.0f;      // ambient light reaching the residue, 1 : fully exposed
+    float exposure=1.0f;       // relative solvent accessible area of the residue, 0 : buried, < 0 : pending
+    bool interface=false;      // residue within reach of another chain
+    bool hidden=false;         // selection: not drawn
+    bool highlight=false;      // selection: drawn emphasized
+    int color=-1;              // selection: 0xRRGGBB override, -1 : color scheme
+    int residue=-1;            // renderer: trace residue of a cartoon point in its chain
 
     Atom(float x_, float y_, float z_) : x(x_), y(y_), z(z_), structure{'x'} {}
     Atom(float x_, float y_, float z_, char c) : x(x_), y(y_), z(z_), structure{c} {}
@@ -0,0 +1,69 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Points binned on a uniform grid, queried through the 27 surrounding bins.
+struct CellList {
+    float ox = 0, oy = 0, oz = 0, inv_cell = 1;
+    int nx = 1, ny = 1, nz = 1;
+    std::vector<int> start, items;
+
+    void build(const float* x, const float* y, const float* z, size_t n, float cell) {
+        if (n == 0) return;
+        inv_cell = 1.0f / cell;
+        ox = *std::min_element(x, x + n);
+        oy = *std::min_element(y, y + n);
+        oz = *std::min_element(z, z + n);
+        nx = (int)((*std::max_element(x, x + n) - ox) * inv_cell) + 1;
+        ny = (int)((*std::max_element(y, y + n) - oy) * inv_cell) + 1;
+        nz = (int)((*std::max_element(z, z + n) - oz) * inv_cell) + 1;
+
+        std::vector<int> bin(n);
+        start.assign((size_t)nx * ny * nz + 1, 0);
+        for (size_t i = 0; i < n; i++) {
+            bin[i] = index(cx(x[i]), cy(y[i]), cz(z[i]));
+            start[bin[i] + 1]++;
+        }
+        for (size_t b = 1; b < start.size(); b++) start[b] += start[b - 1];
+        items.resize(n);
+        std::vector<int> fill(start.begin(), start.end() - 1);
+        for (size_t i = 0; i < n; i++) items[fill[bin[i]]++] = (int)i;
+    }
+
+    int cx(float v) const { return std::clamp((int)((v - ox) * inv_cell), 0, nx - 1); }
+    int cy(float v) const { return std::clamp((int)((v - oy) * inv_cell), 0, ny - 1); }
+    int cz(float v) const { return std::clamp((int)((v - oz) * inv_cell), 0, nz - 1); }
+    int index(int i, int j, int k) const { return (k * ny + j) * nx + i; }
+
+    template <typename F>
+    void for_near(float px, float py, float pz, F&& f) const {
+        if (items.empty()) return;
+        // points beyond one bin of the clamped cell are out of range anyway
+        int i0 = (int)std::floor((px - ox) * inv_cell), j0 = (int)std::floor((py - oy) * inv_cell);
+        int k0 = (int)std::floor((pz - oz) * inv_cell);
+        for (int k = std::max(k0 - 1, 0); k <= std::min(k0 + 1, nz - 1); k++)
+            for (int j = std::max(j0 - 1, 0); j <= std::min(j0 + 1, ny - 1); j++)
+                for (int i = std::max(i0 - 1, 0); i <= std::min(i0 + 1, nx - 1); i++) {
+                    int b = index(i, j, k);
+                    for (int s = start[b]; s < start[b + 1]; s++) f(items[s]);
+                }
+    }
+
+    // like for_near, but stops at the first point for which f returns true
+    template <typename F>
+    bool any_near(float px, float py, float pz, F&& f) const {
+        if (items.empty()) return false;
+        int i0 = (int)std::floor((px - ox) * inv_cell), j0 = (int)std::floor((py - oy) * inv_cell);
+        int k0 = (int)std::floor((pz - oz) * inv_cell);
+        for (int k = std::max(k0 - 1, 0); k <= std::min(k0 + 1, nz - 1); k++)
+            for (int j = std::max(j0 - 1, 0); j <= std::min(j0 + 1, ny - 1); j++)
+                for (int i = std::max(i0 - 1, 0); i <= std::min(i0 + 1, nx - 1); i++) {
+                    int b = index(i, j, k);
+                    for (int s = start[b]; s < start[b + 1]; s++)
+                        if (f(items[s])) return true;
+                }
+        return false;
+    }
+};
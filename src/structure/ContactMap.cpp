@@ -0,0 +1,84 @@
+#include "ContactMap.hpp"
+#include "CellList.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void ContactMap::build(const CATrace& trace_, float cutoff_) {
+    trace = trace_;
+    cutoff = cutoff_;
+    pool.clear();
+    pool_side = 0;
+
+    const size_t n = trace.size();
+    row_start.assign(n + 1, 0);
+    cols.clear();
+    dists.clear();
+    if (n == 0) return;
+
+    CellList grid;
+    grid.build(trace.x.data(), trace.y.data(), trace.z.data(), n, cutoff);
+
+    // rows are filled per block, then concatenated in order
+    const size_t block = 512;
+    const size_t n_blocks = (n + block - 1) / block;
+    std::vector<std::vector<int>> block_cols(n_blocks);
+    std::vector<std::vector<float>> block_dists(n_blocks);
+    parallel_for(n_blocks, [&](size_t b) {
+        std::vector<std::pair<int, float>> row;
+        for (size_t i = b * block; i < std::min(n, (b + 1) * block); i++) {
+            row.clear();
+            float x = trace.x[i], y = trace.y[i], z = trace.z[i];
+            grid.for_near(x, y, z, [&](int j) {
+                if (j == (int)i) return;
+                float dx = trace.x[j] - x, dy = trace.y[j] - y, dz = trace.z[j] - z;
+                float d2 = dx * dx + dy * dy + dz * dz;
+                if (d2 < cutoff * cutoff) row.push_back({j, std::sqrt(d2)});
+            });
+            std::sort(row.begin(), row.end());
+            row_start[i + 1] = (int)row.size();
+            for (const auto& [j, d] : row) {
+                block_cols[b].push_back(j);
+                block_dists[b].push_back(d);
+            }
+        }
+    });
+
+    for (size_t i = 0; i < n; i++) row_start[i + 1] += row_start[i];
+    cols.reserve(row_start[n]);
+    dists.reserve(row_start[n]);
+    for (size_t b = 0; b < n_blocks; b++) {
+        cols.insert(cols.end(), block_cols[b].begin(), block_cols[b].end());
+        dists.insert(dists.end(), block_dists[b].begin(), block_dists[b].end());
+    }
+}
+
+float ContactMap::distance(int i, int j) const {
+    if (i < 0 || j < 0 || i >= (int)size() || j >= (int)size()) return -1.0f;
+    if (i == j) return 0.0f;
+    auto first = cols.begin() + row_start[i], last = cols.begin() + row_start[i + 1];
+    auto it = std::lower_bound(first, last, j);
+    if (it == last || *it != j) return -1.0f;
+    return dists[it - cols.begin()];
+}
+
+const std::vector<float>& ContactMap::pooled(int side) {
+    if (side == pool_side && !pool.empty()) return pool;
+    pool_side = side;
+    pool.assign((size_t)side * side, 0.0f);
+    const size_t n = size();
+    if (n == 0 || side <= 0) return pool;
+
+    // every residue pair lands in exactly one bin, so the pass is O(contacts)
+    for (size_t i = 0; i < n; i++) {
+        int py = (int)(i * side / n);
+        float* row = &pool[(size_t)py * side];
+        row[i * side / n] = 1.0f;
+        for (int k = row_start[i]; k < row_start[i + 1]; k++) {
+            int px = (int)((size_t)cols[k] * side / n);
+            row[px] = std::max(row[px], 1.0f - dists[k] / cutoff);
+        }
+    }
+    return pool;
+}
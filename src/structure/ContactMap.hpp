@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+
+#include "Superposer.hpp"
+
+// Residue-residue CA contacts within a cutoff, kept as sorted CSR rows.
+class ContactMap {
+public:
+    void build(const CATrace& trace_, float cutoff_ = 8.0f);
+
+    bool empty() const { return trace.size() == 0; }
+    size_t size() const { return trace.size(); }
+    const CATrace& get_trace() const { return trace; }
+
+    // distance between residues i and j, or -1 when they are not in contact
+    float distance(int i, int j) const;
+
+    // Contact strength (1 at 0 A, 0 at the cutoff) max-pooled onto a
+    // side x side raster, row-major with residue i along y. Cached per side.
+    const std::vector<float>& pooled(int side);
+
+    float cutoff = 8.0f;
+
+private:
+    CATrace trace;
+    std::vector<int> row_start;
+    std::vector<int> cols;
+    std::vector<float> dists;
+
+    std::vector<float> pool;
+    int pool_side = 0;
+};
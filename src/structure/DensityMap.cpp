@@ -0,0 +1,283 @@
+#include "DensityMap.hpp"
+#include "MarchingTets.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+int32_t word_i(const unsigned char* header, int w) {
+    int32_t v;
+    std::memcpy(&v, header + 4 * w, 4);
+    return v;
+}
+
+float word_f(const unsigned char* header, int w) {
+    float v;
+    std::memcpy(&v, header + 4 * w, 4);
+    return v;
+}
+
+int voxel_bytes(int mode) {
+    switch (mode) {
+        case 0: return 1;   // int8
+        case 1: return 2;   // int16
+        case 2: return 4;   // float32
+        case 6: return 2;   // uint16
+        default: return 0;
+    }
+}
+
+template <typename T>
+void copy_rows(const unsigned char* voxels, const int (&dim)[3], const int (&lo)[3], const int (&hi)[3], float* out) {
+    const size_t row = (size_t)(hi[0] - lo[0] + 1);
+    for (int k = lo[2]; k <= hi[2]; k++)
+        for (int j = lo[1]; j <= hi[1]; j++) {
+            const unsigned char* src = voxels + (((size_t)k * dim[1] + j) * dim[0] + lo[0]) * sizeof(T);
+            for (size_t i = 0; i < row; i++) {
+                T v;
+                std::memcpy(&v, src + i * sizeof(T), sizeof(T));
+                *out++ = (float)v;
+            }
+        }
+}
+
+} // namespace
+
+DensityMap::~DensityMap() {
+    close();
+}
+
+void DensityMap::close() {
+    if (data) munmap((void*)data, file_size);
+    data = voxels = nullptr;
+    file_size = 0;
+    bmin.clear(); bmax.clear(); in_region.clear();
+    meshes.clear(); active.clear();
+    level_set = false;
+    sum = sum_sq = 0.0;
+    count = 0;
+}
+
+void DensityMap::open(const std::string& path_) {
+    close();
+    path = path_;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("cannot open map " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 1024) {
+        ::close(fd);
+        throw std::runtime_error("not a CCP4/MRC map: " + path);
+    }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) throw std::runtime_error("cannot map " + path);
+    data = (const unsigned char*)p;
+    file_size = (size_t)st.st_size;
+    // pages are only ever touched brick by brick
+    madvise((void*)data, file_size, MADV_RANDOM);
+
+    const unsigned char* h = data;
+    if (h[212] == 0x11 && h[213] == 0x11) {
+        close();
+        throw std::runtime_error("big-endian maps are not supported: " + path);
+    }
+    for (int a = 0; a < 3; a++) dim[a] = word_i(h, a);
+    mode = word_i(h, 3);
+    const int bytes = voxel_bytes(mode);
+    const size_t offset = 1024 + (size_t)std::max(0, word_i(h, 23));
+    if (bytes == 0) {
+        close();
+        throw std::runtime_error("unsupported map mode " + std::to_string(word_i(h, 3)) + " in " + path);
+    }
+    if (dim[0] < 2 || dim[1] < 2 || dim[2] < 2 ||
+        offset + (size_t)dim[0] * dim[1] * dim[2] * bytes > file_size) {
+        close();
+        throw std::runtime_error("truncated or malformed map: " + path);
+    }
+    voxels = data + offset;
+
+    // grid index -> fractional -> Cartesian, with the file axes mapped onto
+    // the crystal axes; the first voxel sits at the MRC2014 origin if the
+    // file gives one, else at NSTART cells
+    int start[3], grid[3], axis[3];
+    float cell[6];
+    for (int a = 0; a < 3; a++) {
+        start[a] = word_i(h, 4 + a);
+        grid[a] = word_i(h, 7 + a);
+        axis[a] = word_i(h, 16 + a) - 1;
+    }
+    for (int a = 0; a < 6; a++) cell[a] = word_f(h, 10 + a);
+    bool axes_ok = true;
+    for (int a = 0; a < 3; a++) axes_ok &= axis[a] >= 0 && axis[a] < 3;
+    if (!axes_ok || axis[0] == axis[1] || axis[1] == axis[2] || axis[0] == axis[2])
+        axis[0] = 0, axis[1] = 1, axis[2] = 2;
+    for (int a = 3; a < 6; a++) if (cell[a] <= 0.0f) cell[a] = 90.0f;
+
+    const double rad = M_PI / 180.0;
+    double ca = cos(cell[3] * rad), cb = cos(cell[4] * rad), cg = cos(cell[5] * rad), sg = sin(cell[5] * rad);
+    double vol = std::sqrt(std::max(0.0, 1.0 - ca * ca - cb * cb - cg * cg + 2.0 * ca * cb * cg));
+    double orth[9] = {cell[0], cell[1] * cg, cell[2] * cb,
+                      0.0, cell[1] * sg, cell[2] * (ca - cb * cg) / sg,
+                      0.0, 0.0, cell[2] * vol / sg};
+    int cells_per_axis[3];
+    for (int x = 0; x < 3; x++) cells_per_axis[x] = (grid[x] > 0) ? grid[x] : dim[x];
+    float origin[3] = {word_f(h, 49), word_f(h, 50), word_f(h, 51)};
+    // writers that fill ORIGIN mostly leave NSTART at 0, but not all do, and
+    // the two describe the same shift
+    const bool has_origin = origin[0] != 0.0f || origin[1] != 0.0f || origin[2] != 0.0f;
+    for (int r = 0; r < 3; r++) {
+        double t = origin[r];
+        for (int a = 0; a < 3; a++) {
+            int x = axis[a];
+            double col = orth[3 * r + x] / cells_per_axis[x];
+            to_angstrom[3 * r + a] = (float)col;
+            if (!has_origin) t += col * start[a];
+        }
+        to_angstrom[9 + r] = (float)t;
+    }
+
+    float rms = word_f(h, 54);
+    header_stats = std::isfinite(rms) && rms > 0.0f;
+    if (header_stats) {
+        stat_mean = word_f(h, 21);
+        stat_rms = rms;
+    }
+
+    for (int a = 0; a < 3; a++) nb[a] = (dim[a] - 1 + BRICK - 1) / BRICK;
+    size_t n = (size_t)nb[0] * nb[1] * nb[2];
+    bmin.assign(n, std::numeric_limits<float>::quiet_NaN());
+    bmax.assign(n, std::numeric_limits<float>::quiet_NaN());
+    in_region.assign(n, 1);
+    meshes.assign(n, BrickMesh());
+}
+
+void DensityMap::read_block(const int (&lo)[3], const int (&hi)[3], float* out) const {
+    switch (mode) {
+        case 0: copy_rows<int8_t>(voxels, dim, lo, hi, out); break;
+        case 1: copy_rows<int16_t>(voxels, dim, lo, hi, out); break;
+        case 6: copy_rows<uint16_t>(voxels, dim, lo, hi, out); break;
+        default: copy_rows<float>(voxels, dim, lo, hi, out); break;
+    }
+}
+
+// voxel range of brick b, one voxel of overlap so its cubes are complete
+static void brick_range(uint32_t b, const int (&nb)[3], const int (&dim)[3], int (&lo)[3], int (&hi)[3]) {
+    int idx[3] = {(int)(b % nb[0]), (int)((b / nb[0]) % nb[1]), (int)(b / ((size_t)nb[0] * nb[1]))};
+    for (int a = 0; a < 3; a++) {
+        lo[a] = idx[a] * DensityMap::BRICK;
+        hi[a] = std::min(dim[a] - 1, lo[a] + DensityMap::BRICK);
+    }
+}
+
+void DensityMap::index_bricks(const std::vector<uint32_t>& bricks) {
+    std::vector<double> part_sum(bricks.size()), part_sq(bricks.size());
+    std::vector<size_t> part_n(bricks.size());
+    parallel_for(bricks.size(), [&](size_t t) {
+        uint32_t b = bricks[t];
+        int lo[3], hi[3];
+        brick_range(b, nb, dim, lo, hi);
+        std::vector<float> v((size_t)(hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) * (hi[2] - lo[2] + 1));
+        read_block(lo, hi, v.data());
+        auto [mn, mx] = std::minmax_element(v.begin(), v.end());
+        bmin[b] = *mn;
+        bmax[b] = *mx;
+        double s = 0.0, s2 = 0.0;
+        for (float f : v) { s += f; s2 += (double)f * f; }
+        part_sum[t] = s; part_sq[t] = s2; part_n[t] = v.size();
+    });
+    if (header_stats) return;
+    // overlap voxels count twice; close enough for a contour scale
+    for (size_t t = 0; t < bricks.size(); t++) { sum += part_sum[t]; sum_sq += part_sq[t]; count += part_n[t]; }
+    if (count == 0) return;
+    stat_mean = (float)(sum / count);
+    stat_rms = (float)std::sqrt(std::max(0.0, sum_sq / count - (sum / count) * (sum / count)));
+    if (stat_rms <= 0.0f) stat_rms = 1.0f;
+}
+
+void DensityMap::set_region(const float (&lo)[3], const float (&hi)[3]) {
+    if (!is_open()) return;
+    std::vector<uint32_t> todo;
+    for (uint32_t b = 0; b < in_region.size(); b++) {
+        // Angstrom box of the brick's corners against the region
+        int vlo[3], vhi[3];
+        brick_range(b, nb, dim, vlo, vhi);
+        float blo[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                        std::numeric_limits<float>::max()};
+        float bhi[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(),
+                        std::numeric_limits<float>::lowest()};
+        for (int c = 0; c < 8; c++) {
+            float g[3] = {(float)((c & 1) ? vhi[0] : vlo[0]), (float)((c & 2) ? vhi[1] : vlo[1]),
+                          (float)((c & 4) ? vhi[2] : vlo[2])};
+            for (int r = 0; r < 3; r++) {
+                float v = to_angstrom[3 * r] * g[0] + to_angstrom[3 * r + 1] * g[1] + to_angstrom[3 * r + 2] * g[2] + to_angstrom[9 + r];
+                blo[r] = std::min(blo[r], v);
+                bhi[r] = std::max(bhi[r], v);
+            }
+        }
+        bool in = true;
+        for (int r = 0; r < 3; r++) in &= bhi[r] >= lo[r] && blo[r] <= hi[r];
+        in_region[b] = in;
+        if (in && std::isnan(bmin[b])) todo.push_back(b);
+    }
+    index_bricks(todo);
+    if (level_set) set_level(level);
+}
+
+void DensityMap::set_level(float level_) {
+    if (!is_open()) return;
+    std::vector<uint32_t> todo;
+    for (uint32_t b = 0; b < in_region.size(); b++)
+        if (in_region[b] && std::isnan(bmin[b])) todo.push_back(b);
+    if (!todo.empty()) index_bricks(todo);
+
+    level = level_;
+    level_set = true;
+    // bricks the new level crosses are re-extracted; meshes of the ones it
+    // left are dropped; every other brick is not read at all
+    std::vector<uint32_t> crossing;
+    for (uint32_t b = 0; b < in_region.size(); b++)
+        if (in_region[b] && crosses(b, level)) crossing.push_back(b);
+    size_t dropped = 0;
+    for (uint32_t b : active)
+        if (!in_region[b] || !crosses(b, level)) {
+            meshes[b] = BrickMesh();
+            dropped++;
+        }
+    parallel_for(crossing.size(), [&](size_t t) { extract(crossing[t], meshes[crossing[t]]); });
+    active.swap(crossing);
+    last_touched = active.size() + dropped;
+}
+
+void DensityMap::extract(uint32_t b, BrickMesh& mesh) const {
+    mesh = BrickMesh();
+    int lo[3], hi[3];
+    brick_range(b, nb, dim, lo, hi);
+    const int nx = hi[0] - lo[0] + 1, ny = hi[1] - lo[1] + 1, nz = hi[2] - lo[2] + 1;
+    std::vector<float> field((size_t)nx * ny * nz);
+    read_block(lo, hi, field.data());
+    for (float& f : field) f -= level;
+    auto vertex = [&](size_t a, size_t c, float t) -> uint32_t {
+        float ga[3] = {(float)(a % nx), (float)((a / nx) % ny), (float)(a / ((size_t)nx * ny))};
+        float gc[3] = {(float)(c % nx), (float)((c / nx) % ny), (float)(c / ((size_t)nx * ny))};
+        float g[3];
+        for (int d = 0; d < 3; d++) g[d] = lo[d] + ga[d] + t * (gc[d] - ga[d]);
+        const float* m = to_angstrom;
+        mesh.x.push_back(m[0] * g[0] + m[1] * g[1] + m[2] * g[2] + m[9]);
+        mesh.y.push_back(m[3] * g[0] + m[4] * g[1] + m[5] * g[2] + m[10]);
+        mesh.z.push_back(m[6] * g[0] + m[7] * g[1] + m[8] * g[2] + m[11]);
+        return (uint32_t)mesh.x.size() - 1;
+    };
+    // same triangulation as SurfaceBuilder, so bricks share edges and the
+    // mesh closes across brick borders
+    march_tetrahedra(nx, ny, 0, nz - 1, [&](size_t g) { return field[g]; }, vertex, mesh.tris);
+}
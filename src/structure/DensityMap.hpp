@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CCP4/MRC map read through mmap, never copied. Voxels are grouped into
+// bricks of BRICK^3 cubes with a min/max index, so only bricks the iso level
+// crosses are read, and each keeps its own mesh: a new level re-extracts the
+// bricks crossing the old or the new level and leaves the rest alone.
+// Indexing and extraction are limited to a region (the model plus a margin),
+// so the whole map never has to be resident.
+class DensityMap {
+public:
+    static const int BRICK = 16;
+
+    struct BrickMesh {
+        std::vector<float> x, y, z;     // Angstrom, same frame as the model
+        std::vector<uint32_t> tris;
+    };
+
+    DensityMap() = default;
+    DensityMap(const DensityMap&) = delete;
+    DensityMap& operator=(const DensityMap&) = delete;
+    ~DensityMap();
+
+    // throws std::runtime_error for unreadable or unsupported files
+    void open(const std::string& path);
+    void close();
+    bool is_open() const { return data != nullptr; }
+    const std::string& get_path() const { return path; }
+
+    // limit indexing and meshing to an Angstrom box; everything until called
+    void set_region(const float (&lo)[3], const float (&hi)[3]);
+    // absolute iso level
+    void set_level(float level);
+    float get_level() const { return level; }
+    // statistics of the map, from the header or the indexed region
+    float mean() const { return stat_mean; }
+    float rms() const { return stat_rms; }
+
+    // bricks holding a mesh at the current level
+    const std::vector<uint32_t>& active_bricks() const { return active; }
+    const BrickMesh& brick_mesh(uint32_t b) const { return meshes[b]; }
+    size_t num_bricks() const { return meshes.size(); }
+    size_t bricks_touched() const { return last_touched; }     // by the last set_level
+
+private:
+    void index_bricks(const std::vector<uint32_t>& bricks);
+    void extract(uint32_t b, BrickMesh& mesh) const;
+    // voxels [i0, i1] x [j0, j1] x [k0, k1] into out, fastest index first
+    void read_block(const int (&lo)[3], const int (&hi)[3], float* out) const;
+    bool crosses(uint32_t b, float v) const { return bmin[b] <= v && v < bmax[b]; }
+
+    std::string path;
+    const unsigned char* data = nullptr;    // mmap of the whole file
+    size_t file_size = 0;
+    const unsigned char* voxels = nullptr;  // after the header
+    int mode = 2;
+    int dim[3] = {0, 0, 0};                 // columns, rows, sections
+    int nb[3] = {0, 0, 0};                  // bricks per file axis
+    float to_angstrom[12];                  // x' = m[0..8] * (col, row, sec) + m[9..11]
+
+    std::vector<float> bmin, bmax;          // per brick, NaN until indexed
+    std::vector<char> in_region;
+    std::vector<BrickMesh> meshes;
+    std::vector<uint32_t> active;
+    float level = 0.0f;
+    bool level_set = false;
+    float stat_mean = 0.0f, stat_rms = 1.0f;
+    bool header_stats = false;
+    double sum = 0.0, sum_sq = 0.0;         // over indexed bricks, without header statistics
+    size_t count = 0;
+    size_t last_touched = 0;
+};
@@ -0,0 +1,50 @@
+#include "FullAtoms.hpp"
+#include "CellList.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+
+static float covalent_radius(char element) {
+    switch (element) {
+        case 'C': return 0.76f;
+        case 'N': return 0.71f;
+        case 'O': return 0.66f;
+        case 'S': return 1.05f;
+        case 'P': return 1.07f;
+        default:  return 1.30f;     // metals and halogens, generous
+    }
+}
+
+void FullAtoms::build_bonds() {
+    bonds.clear();
+    const size_t n = size();
+    if (n == 0) return;
+
+    const float tolerance = 0.45f;
+    const float reach = 2.0f * covalent_radius('X') + tolerance;
+    CellList grid;
+    grid.build(table.x.data(), table.y.data(), table.z.data(), n, reach);
+
+    // each atom keeps its bonds to higher indices, blocks concatenated in order
+    const size_t block = 2048;
+    const size_t n_blocks = (n + block - 1) / block;
+    std::vector<std::vector<uint32_t>> block_bonds(n_blocks);
+    parallel_for(n_blocks, [&](size_t b) {
+        for (size_t i = b * block; i < std::min(n, (b + 1) * block); i++) {
+            float x = table.x[i], y = table.y[i], z = table.z[i];
+            float ri = covalent_radius(element[i]);
+            grid.for_near(x, y, z, [&](int j) {
+                if (j <= (int)i) return;
+                float dx = table.x[j] - x, dy = table.y[j] - y, dz = table.z[j] - z;
+                float d2 = dx * dx + dy * dy + dz * dz;
+                float max_d = ri + covalent_radius(element[j]) + tolerance;
+                if (d2 > 0.16f && d2 < max_d * max_d) {
+                    block_bonds[b].push_back((uint32_t)i);
+                    block_bonds[b].push_back((uint32_t)j);
+                }
+            });
+        }
+    });
+    for (const std::vector<uint32_t>& part : block_bonds)
+        bonds.insert(bonds.end(), part.begin(), part.end());
+}
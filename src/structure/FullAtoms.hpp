@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Selection.hpp"
+
+// Every heavy atom of the loaded chains (waters left out) in the Angstrom
+// frame, as columns the selection engine and the all-atom view read.
+struct FullAtoms {
+    AtomTable table;
+    std::vector<char> element;      // 'C', 'N', 'O', 'S', 'P', or 'X' for anything else
+    std::vector<int> residue;       // row of the residue in get_atoms() order, -1 : no CA (ligand, nucleotide)
+    std::vector<uint32_t> bonds;    // two atom indices per bond
+
+    size_t size() const { return table.size(); }
+    size_t num_bonds() const { return bonds.size() / 2; }
+
+    // covalent bonds from element radii, replaces any existing ones
+    void build_bonds();
+};
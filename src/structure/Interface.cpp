@@ -0,0 +1,87 @@
+#include "Interface.hpp"
+#include "CellList.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <limits>
+
+std::vector<char> InterfaceFinder::find(const AtomTable& atoms, const std::vector<int>& residue, size_t n_residues) {
+    std::vector<char> flags(n_residues, 0);
+    n_pairs = n_total = 0;
+
+    // atoms grouped by chain, in SoA so every chain gets its own cell list
+    struct Chain {
+        std::vector<float> x, y, z;
+        std::vector<int> residue;
+        float lo[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                       std::numeric_limits<float>::max()};
+        float hi[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(),
+                       std::numeric_limits<float>::lowest()};
+        CellList grid;
+    };
+    size_t n_chains = 0;
+    for (uint16_t c : atoms.chain) n_chains = std::max(n_chains, (size_t)c + 1);
+    std::vector<Chain> chains(n_chains);
+    for (size_t i = 0; i < atoms.size(); i++) {
+        int r = residue[i];
+        if (r < 0 || r >= (int)n_residues) continue;
+        Chain& ch = chains[atoms.chain[i]];
+        float p[3] = {atoms.x[i], atoms.y[i], atoms.z[i]};
+        ch.x.push_back(p[0]); ch.y.push_back(p[1]); ch.z.push_back(p[2]);
+        ch.residue.push_back(r);
+        for (int a = 0; a < 3; a++) { ch.lo[a] = std::min(ch.lo[a], p[a]); ch.hi[a] = std::max(ch.hi[a], p[a]); }
+    }
+    std::vector<int> order;
+    for (size_t c = 0; c < n_chains; c++)
+        if (!chains[c].x.empty()) order.push_back((int)c);
+    n_total = order.size() * (order.size() - (order.empty() ? 0 : 1)) / 2;
+
+    // sweep along x: a chain only meets the ones that start before it ends
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return chains[a].lo[0] < chains[b].lo[0]; });
+    std::vector<std::pair<int, int>> pairs;
+    for (size_t s = 0; s < order.size(); s++) {
+        const Chain& a = chains[order[s]];
+        for (size_t t = s + 1; t < order.size(); t++) {
+            const Chain& b = chains[order[t]];
+            if (b.lo[0] > a.hi[0] + cutoff) break;
+            if (b.lo[1] > a.hi[1] + cutoff || a.lo[1] > b.hi[1] + cutoff) continue;
+            if (b.lo[2] > a.hi[2] + cutoff || a.lo[2] > b.hi[2] + cutoff) continue;
+            // the smaller chain is walked, the larger one queried
+            if (a.x.size() <= b.x.size()) pairs.push_back({order[s], order[t]});
+            else pairs.push_back({order[t], order[s]});
+        }
+    }
+    n_pairs = pairs.size();
+    if (pairs.empty()) return flags;
+
+    // a grid only for chains that are queried
+    std::vector<char> queried(n_chains, 0);
+    for (const auto& [walk, query] : pairs) queried[query] = 1;
+    parallel_for(n_chains, [&](size_t c) {
+        if (queried[c]) chains[c].grid.build(chains[c].x.data(), chains[c].y.data(), chains[c].z.data(), chains[c].x.size(), cutoff);
+    });
+
+    std::vector<std::vector<int>> marked(pairs.size());
+    const float c2 = cutoff * cutoff;
+    parallel_for(pairs.size(), [&](size_t k) {
+        const Chain& a = chains[pairs[k].first];
+        const Chain& b = chains[pairs[k].second];
+        std::vector<int>& out = marked[k];
+        for (size_t i = 0; i < a.x.size(); i++) {
+            float x = a.x[i], y = a.y[i], z = a.z[i];
+            if (x < b.lo[0] - cutoff || x > b.hi[0] + cutoff || y < b.lo[1] - cutoff || y > b.hi[1] + cutoff ||
+                z < b.lo[2] - cutoff || z > b.hi[2] + cutoff) continue;
+            bool hit = false;
+            b.grid.for_near(x, y, z, [&](int j) {
+                float dx = b.x[j] - x, dy = b.y[j] - y, dz = b.z[j] - z;
+                if (dx * dx + dy * dy + dz * dz > c2) return;
+                hit = true;
+                if (out.empty() || out.back() != b.residue[j]) out.push_back(b.residue[j]);
+            });
+            if (hit) out.push_back(a.residue[i]);
+        }
+    });
+    for (const std::vector<int>& rows : marked)
+        for (int r : rows) flags[r] = 1;
+    return flags;
+}
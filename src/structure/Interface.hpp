@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "Selection.hpp"
+
+// Residues within `cutoff` of an atom of another chain. Chains are paired
+// by a sweep over their bounding boxes grown by the cutoff, so large
+// assemblies only test chains that can touch; each surviving pair runs as
+// one task against the cell list of its larger chain.
+class InterfaceFinder {
+public:
+    // atoms.chain groups the atoms, residue[i] is the row atom i marks (-1 : skipped);
+    // returns one flag per residue row
+    std::vector<char> find(const AtomTable& atoms, const std::vector<int>& residue, size_t n_residues);
+
+    size_t chain_pairs() const { return n_pairs; }         // pairs whose boxes overlap
+    size_t chain_pairs_total() const { return n_total; }   // all pairs of non-empty chains
+
+    float cutoff = 4.5f;            // Angstrom, heavy atom to heavy atom
+
+private:
+    size_t n_pairs = 0, n_total = 0;
+};
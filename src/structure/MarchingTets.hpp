@@ -0,0 +1,76 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace marching_detail {
+
+// Kuhn triangulation of the unit cube: all cubes split their faces along the
+// same diagonals, so neighbouring tetrahedra share edges and the mesh is closed.
+constexpr int CORNER[8][3] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+                              {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}};
+constexpr int TETS[6][4] = {{0, 1, 2, 6}, {0, 1, 5, 6}, {0, 3, 2, 6},
+                            {0, 3, 7, 6}, {0, 4, 5, 6}, {0, 4, 7, 6}};
+
+} // namespace marching_detail
+
+// Marching tetrahedra over the cubes of layers [k0, k1) of an nx*ny*nz grid
+// indexed (k * ny + j) * nx + i. field(g) is the value at grid point g, with
+// the surface at zero. vertex(a, b, t) adds the point a fraction t of the way
+// from grid point a to b and returns its index; each crossed edge is asked for
+// once. Triangles go to tris as index triples.
+template <class Field, class Vertex>
+void march_tetrahedra(int nx, int ny, int k0, int k1, const Field& field, const Vertex& vertex,
+                      std::vector<uint32_t>& tris) {
+    using namespace marching_detail;
+    auto gidx = [&](int i, int j, int k) { return ((size_t)k * ny + j) * nx + i; };
+
+    std::unordered_map<uint64_t, uint32_t> edges;
+    auto cross = [&](size_t a, size_t b) -> uint32_t {
+        if (a > b) std::swap(a, b);
+        uint64_t key = ((uint64_t)a << 32) | b;
+        auto it = edges.find(key);
+        if (it != edges.end()) return it->second;
+        float fa = field(a), fb = field(b);
+        uint32_t v = vertex(a, b, fa / (fa - fb));
+        edges.emplace(key, v);
+        return v;
+    };
+    auto tri = [&](uint32_t a, uint32_t b, uint32_t c) {
+        if (a == b || b == c || a == c) return;
+        tris.insert(tris.end(), {a, b, c});
+    };
+
+    for (int k = k0; k < k1; k++)
+        for (int j = 0; j < ny - 1; j++)
+            for (int i = 0; i < nx - 1; i++) {
+                size_t g[8];
+                int mask = 0;
+                for (int c = 0; c < 8; c++) {
+                    g[c] = gidx(i + CORNER[c][0], j + CORNER[c][1], k + CORNER[c][2]);
+                    if (field(g[c]) > 0.0f) mask |= 1 << c;
+                }
+                if (mask == 0 || mask == 0xFF) continue;
+
+                for (const int* tet : TETS) {
+                    size_t in[4], out[4];
+                    int n_in = 0, n_out = 0;
+                    for (int c = 0; c < 4; c++) {
+                        if (mask & (1 << tet[c])) in[n_in++] = g[tet[c]];
+                        else out[n_out++] = g[tet[c]];
+                    }
+                    if (n_in == 1) {
+                        tri(cross(in[0], out[0]), cross(in[0], out[1]), cross(in[0], out[2]));
+                    } else if (n_in == 3) {
+                        tri(cross(out[0], in[0]), cross(out[0], in[1]), cross(out[0], in[2]));
+                    } else if (n_in == 2) {
+                        uint32_t e0 = cross(in[0], out[0]), e1 = cross(in[0], out[1]);
+                        uint32_t e2 = cross(in[1], out[1]), e3 = cross(in[1], out[0]);
+                        tri(e0, e1, e2);
+                        tri(e0, e2, e3);
+                    }
+                }
+            }
+}
@@ -0,0 +1,53 @@
+#include "Morph.hpp"
+#include "simd.h"
+
+void Morph::set(const std::vector<Atom>& start, const std::vector<Atom>& end) {
+    clear();
+    n = std::min(start.size(), end.size());
+    // padding lanes stay zero, the kernels run over whole vectors
+    size_t padded = (n + VECSIZE_FLOAT - 1) / VECSIZE_FLOAT * VECSIZE_FLOAT;
+    for (std::vector<float>* v : {&ax, &ay, &az, &dx, &dy, &dz, &ox, &oy, &oz})
+        v->assign(padded, 0.0f);
+    for (size_t i = 0; i < n; i++) {
+        ax[i] = start[i].x; ay[i] = start[i].y; az[i] = start[i].z;
+        dx[i] = end[i].x - start[i].x; dy[i] = end[i].y - start[i].y; dz[i] = end[i].z - start[i].z;
+    }
+    evaluate(0.0f);
+}
+
+void Morph::clear() {
+    n = 0;
+    for (std::vector<float>* v : {&ax, &ay, &az, &dx, &dy, &dz, &ox, &oy, &oz})
+        v->clear();
+}
+
+void Morph::transform(const float (&m)[12]) {
+    simd_float m0 = simdf32_set(m[0]), m1 = simdf32_set(m[1]), m2 = simdf32_set(m[2]);
+    simd_float m3 = simdf32_set(m[3]), m4 = simdf32_set(m[4]), m5 = simdf32_set(m[5]);
+    simd_float m6 = simdf32_set(m[6]), m7 = simdf32_set(m[7]), m8 = simdf32_set(m[8]);
+    simd_float t0 = simdf32_set(m[9]), t1 = simdf32_set(m[10]), t2 = simdf32_set(m[11]);
+    auto apply = [&](float* px, float* py, float* pz, bool shift) {
+        for (size_t i = 0; i < ax.size(); i += VECSIZE_FLOAT) {
+            simd_float x = simdf32_loadu(px + i), y = simdf32_loadu(py + i), z = simdf32_loadu(pz + i);
+            simd_float nx = simdf32_add(simdf32_add(simdf32_mul(m0, x), simdf32_mul(m1, y)), simdf32_mul(m2, z));
+            simd_float ny = simdf32_add(simdf32_add(simdf32_mul(m3, x), simdf32_mul(m4, y)), simdf32_mul(m5, z));
+            simd_float nz = simdf32_add(simdf32_add(simdf32_mul(m6, x), simdf32_mul(m7, y)), simdf32_mul(m8, z));
+            if (shift) { nx = simdf32_add(nx, t0); ny = simdf32_add(ny, t1); nz = simdf32_add(nz, t2); }
+            simdf32_storeu(px + i, nx);
+            simdf32_storeu(py + i, ny);
+            simdf32_storeu(pz + i, nz);
+        }
+    };
+    // the offsets are directions, they take the linear part only
+    apply(ax.data(), ay.data(), az.data(), true);
+    apply(dx.data(), dy.data(), dz.data(), false);
+}
+
+void Morph::evaluate(float t) {
+    simd_float vt = simdf32_set(t);
+    for (size_t i = 0; i < ax.size(); i += VECSIZE_FLOAT) {
+        simdf32_storeu(ox.data() + i, simdf32_add(simdf32_loadu(ax.data() + i), simdf32_mul(vt, simdf32_loadu(dx.data() + i))));
+        simdf32_storeu(oy.data() + i, simdf32_add(simdf32_loadu(ay.data() + i), simdf32_mul(vt, simdf32_loadu(dy.data() + i))));
+        simdf32_storeu(oz.data() + i, simdf32_add(simdf32_loadu(az.data() + i), simdf32_mul(vt, simdf32_loadu(dz.data() + i))));
+    }
+}
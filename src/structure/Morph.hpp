@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "Atom.hpp"
+
+// Straight-line interpolation between two conformations of the same points,
+// start + t * (end - start). Both ends are kept in SoA, padded to whole SIMD
+// vectors, so a frame is a single vector pass with no allocation.
+class Morph {
+public:
+    // start and end pair up index for index
+    void set(const std::vector<Atom>& start, const std::vector<Atom>& end);
+    void clear();
+    bool empty() const { return n == 0; }
+    size_t size() const { return n; }
+
+    // x' = m[0..8] * x + m[9..11] on both ends, so the morph follows the view
+    void transform(const float (&m)[12]);
+    // positions at t in [0, 1] into x(), y(), z()
+    void evaluate(float t);
+    // point i at t, leaving the evaluated frame alone
+    void point(size_t i, float t, float (&p)[3]) const {
+        p[0] = ax[i] + t * dx[i];
+        p[1] = ay[i] + t * dy[i];
+        p[2] = az[i] + t * dz[i];
+    }
+
+    const float* x() const { return ox.data(); }
+    const float* y() const { return oy.data(); }
+    const float* z() const { return oz.data(); }
+
+private:
+    size_t n = 0;
+    std::vector<float> ax, ay, az;      // start
+    std::vector<float> dx, dy, dz;      // end - start
+    std::vector<float> ox, oy, oz;      // last evaluated frame
+};
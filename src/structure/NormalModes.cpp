@@ -0,0 +1,316 @@
+#include "NormalModes.hpp"
+#include "CellList.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+
+// Column v of an interleaved block: x[dof * k + v]
+double dot(const std::vector<double>& a, int va, const std::vector<double>& b, int vb, int k, size_t dim) {
+    double s = 0.0;
+    for (size_t d = 0; d < dim; d++) s += a[d * k + va] * b[d * k + vb];
+    return s;
+}
+
+void axpy(double alpha, const std::vector<double>& x, int vx, std::vector<double>& y, int vy, int k, size_t dim) {
+    for (size_t d = 0; d < dim; d++) y[d * k + vy] += alpha * x[d * k + vx];
+}
+
+// Modified Gram-Schmidt, twice for stability; a column that collapses is
+// replaced with a random one. Columns are also kept orthogonal to `locked`.
+void orthonormalize(std::vector<double>& X, int k, size_t dim,
+                    const std::vector<double>& locked, int kl, std::mt19937& rng) {
+    std::uniform_real_distribution<double> u(-1.0, 1.0);
+    for (int v = 0; v < k; v++) {
+        for (int attempt = 0; attempt < 3; attempt++) {
+            double before = std::sqrt(dot(X, v, X, v, k, dim));
+            for (int pass = 0; pass < 2; pass++) {
+                for (int b = 0; b < kl; b++) {
+                    double c = 0.0;
+                    for (size_t d = 0; d < dim; d++) c += locked[d * kl + b] * X[d * k + v];
+                    for (size_t d = 0; d < dim; d++) X[d * k + v] -= c * locked[d * kl + b];
+                }
+                for (int w = 0; w < v; w++) {
+                    double c = dot(X, w, X, v, k, dim);
+                    axpy(-c, X, w, X, v, k, dim);
+                }
+            }
+            double norm = std::sqrt(dot(X, v, X, v, k, dim));
+            if (norm > 1e-10 * std::max(before, 1e-300)) {
+                for (size_t d = 0; d < dim; d++) X[d * k + v] /= norm;
+                break;
+            }
+            for (size_t d = 0; d < dim; d++) X[d * k + v] = u(rng);
+        }
+    }
+}
+
+// Eigen-decomposition of a symmetric k x k matrix (cyclic Jacobi), ascending.
+void symmetric_eigen(std::vector<double> A, int k, std::vector<double>& values, std::vector<double>& V) {
+    V.assign((size_t)k * k, 0.0);
+    for (int i = 0; i < k; i++) V[i * k + i] = 1.0;
+    for (int sweep = 0; sweep < 100; sweep++) {
+        double off = 0.0, total = 0.0;
+        for (int p = 0; p < k; p++)
+            for (int q = 0; q < k; q++) {
+                total += A[p * k + q] * A[p * k + q];
+                if (p != q) off += A[p * k + q] * A[p * k + q];
+            }
+        if (off <= 1e-30 * total) break;
+
+        for (int p = 0; p < k; p++) {
+            for (int q = p + 1; q < k; q++) {
+                double apq = A[p * k + q];
+                if (std::fabs(apq) < 1e-300) continue;
+                double theta = (A[q * k + q] - A[p * k + p]) / (2.0 * apq);
+                double t = (theta >= 0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                double c = 1.0 / std::sqrt(t * t + 1.0), s = t * c;
+                for (int r = 0; r < k; r++) {
+                    double arp = A[r * k + p], arq = A[r * k + q];
+                    A[r * k + p] = c * arp - s * arq;
+                    A[r * k + q] = s * arp + c * arq;
+                }
+                for (int r = 0; r < k; r++) {
+                    double apr = A[p * k + r], aqr = A[q * k + r];
+                    A[p * k + r] = c * apr - s * aqr;
+                    A[q * k + r] = s * apr + c * aqr;
+                }
+                for (int r = 0; r < k; r++) {
+                    double vrp = V[r * k + p], vrq = V[r * k + q];
+                    V[r * k + p] = c * vrp - s * vrq;
+                    V[r * k + q] = s * vrp + c * vrq;
+                }
+            }
+        }
+    }
+
+    std::vector<int> order(k);
+    for (int i = 0; i < k; i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return A[a * k + a] < A[b * k + b]; });
+    std::vector<double> sorted((size_t)k * k);
+    values.resize(k);
+    for (int c = 0; c < k; c++) {
+        values[c] = A[order[c] * k + order[c]];
+        for (int r = 0; r < k; r++) sorted[r * k + c] = V[r * k + order[c]];
+    }
+    V.swap(sorted);
+}
+
+// X <- X * V for an interleaved block and a k x k matrix
+void rotate_block(std::vector<double>& X, int k, size_t dim, const std::vector<double>& V) {
+    parallel_for((dim + 4095) / 4096, [&](size_t blk) {
+        std::vector<double> row(k);
+        for (size_t d = blk * 4096; d < std::min(dim, (blk + 1) * 4096); d++) {
+            double* x = &X[d * k];
+            for (int c = 0; c < k; c++) {
+                double s = 0.0;
+                for (int r = 0; r < k; r++) s += x[r] * V[r * k + c];
+                row[c] = s;
+            }
+            std::copy(row.begin(), row.end(), x);
+        }
+    });
+}
+
+} // namespace
+
+void NormalModes::build_network(const CATrace& trace) {
+    n = trace.size();
+    row_start.assign(n + 1, 0);
+    cols.clear();
+    ux.clear(); uy.clear(); uz.clear();
+
+    CellList grid;
+    grid.build(trace.x.data(), trace.y.data(), trace.z.data(), n, cutoff);
+
+    // both directions of every contact, rows filled per block then concatenated
+    const size_t block = 512;
+    const size_t n_blocks = (n + block - 1) / block;
+    struct Part { std::vector<int> cols; std::vector<float> ux, uy, uz; };
+    std::vector<Part> parts(n_blocks);
+    parallel_for(n_blocks, [&](size_t b) {
+        Part& part = parts[b];
+        std::vector<std::pair<int, float>> row;
+        for (size_t i = b * block; i < std::min(n, (b + 1) * block); i++) {
+            row.clear();
+            float x = trace.x[i], y = trace.y[i], z = trace.z[i];
+            grid.for_near(x, y, z, [&](int j) {
+                if (j == (int)i) return;
+                float dx = trace.x[j] - x, dy = trace.y[j] - y, dz = trace.z[j] - z;
+                float d2 = dx * dx + dy * dy + dz * dz;
+                if (d2 < cutoff * cutoff && d2 > 1e-6f) row.push_back({j, d2});
+            });
+            std::sort(row.begin(), row.end());
+            row_start[i + 1] = (int)row.size();
+            for (const auto& [j, d2] : row) {
+                float inv = 1.0f / std::sqrt(d2);
+                part.cols.push_back(j);
+                part.ux.push_back((trace.x[j] - x) * inv);
+                part.uy.push_back((trace.y[j] - y) * inv);
+                part.uz.push_back((trace.z[j] - z) * inv);
+            }
+        }
+    });
+    for (size_t i = 0; i < n; i++) row_start[i + 1] += row_start[i];
+    for (Part& part : parts) {
+        cols.insert(cols.end(), part.cols.begin(), part.cols.end());
+        ux.insert(ux.end(), part.ux.begin(), part.ux.end());
+        uy.insert(uy.end(), part.uy.begin(), part.uy.end());
+        uz.insert(uz.end(), part.uz.begin(), part.uz.end());
+    }
+}
+
+void NormalModes::multiply(const double* X, double* Y, int k) const {
+    // (H x)_i = gamma * sum_j u_ij (u_ij . (x_i - x_j)), four vectors at a time
+    // so the accumulators stay in registers; k is a multiple of four
+    const size_t block = 256;
+    parallel_for((n + block - 1) / block, [&](size_t b) {
+        for (size_t i = b * block; i < std::min(n, (b + 1) * block); i++) {
+            const double* xi = X + 3 * i * k;
+            double* yi = Y + 3 * i * k;
+            for (int v0 = 0; v0 < k; v0 += 4) {
+                double a0[4] = {0, 0, 0, 0}, a1[4] = {0, 0, 0, 0}, a2[4] = {0, 0, 0, 0};
+                double x0[4], x1[4], x2[4];
+                for (int l = 0; l < 4; l++) {
+                    x0[l] = xi[v0 + l]; x1[l] = xi[k + v0 + l]; x2[l] = xi[2 * k + v0 + l];
+                }
+                for (int s = row_start[i]; s < row_start[i + 1]; s++) {
+                    const double* xj = X + 3 * (size_t)cols[s] * k + v0;
+                    double u0 = ux[s], u1 = uy[s], u2 = uz[s];
+                    for (int l = 0; l < 4; l++) {
+                        double d = u0 * (x0[l] - xj[l]) + u1 * (x1[l] - xj[k + l]) + u2 * (x2[l] - xj[2 * k + l]);
+                        a0[l] += u0 * d;
+                        a1[l] += u1 * d;
+                        a2[l] += u2 * d;
+                    }
+                }
+                for (int l = 0; l < 4; l++) {
+                    yi[v0 + l] = gamma * a0[l];
+                    yi[k + v0 + l] = gamma * a1[l];
+                    yi[2 * k + v0 + l] = gamma * a2[l];
+                }
+            }
+        }
+    });
+}
+
+double NormalModes::upper_bound() const {
+    // Gershgorin: every 3x3 block row of u u^T sums to |u_c| (|u_x| + |u_y| + |u_z|),
+    // once off the diagonal and once on it
+    double bound = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double r[3] = {0.0, 0.0, 0.0};
+        for (int s = row_start[i]; s < row_start[i + 1]; s++) {
+            double l1 = std::fabs(ux[s]) + std::fabs(uy[s]) + std::fabs(uz[s]);
+            r[0] += std::fabs(ux[s]) * l1;
+            r[1] += std::fabs(uy[s]) * l1;
+            r[2] += std::fabs(uz[s]) * l1;
+        }
+        bound = std::max({bound, 2.0 * r[0], 2.0 * r[1], 2.0 * r[2]});
+    }
+    return bound * gamma;
+}
+
+bool NormalModes::compute(const CATrace& trace, int n_modes, const std::atomic<bool>* cancel) {
+    values.clear();
+    modes.clear();
+    iters = 0;
+    auto cancelled = [&]() { return cancel && cancel->load(std::memory_order_relaxed); };
+    if (trace.size() < 4 || n_modes <= 0) return false;
+
+    build_network(trace);
+    const size_t dim = 3 * n;
+    // block of wanted plus guard vectors, a multiple of four for multiply()
+    int k = (n_modes + std::max(4, n_modes) + 3) / 4 * 4;
+    while (k > (int)dim - 6) k -= 4;
+    n_modes = std::min(n_modes, k);
+    if (k <= 0 || cancelled()) return false;
+
+    // rigid-body motions: translations, and rotations about the centroid
+    const int kr = 6;
+    std::vector<double> rigid(dim * kr, 0.0);
+    double c[3] = {0.0, 0.0, 0.0};
+    for (size_t i = 0; i < n; i++) { c[0] += trace.x[i]; c[1] += trace.y[i]; c[2] += trace.z[i]; }
+    for (double& v : c) v /= n;
+    for (size_t i = 0; i < n; i++) {
+        double p[3] = {trace.x[i] - c[0], trace.y[i] - c[1], trace.z[i] - c[2]};
+        for (int a = 0; a < 3; a++) {
+            rigid[(3 * i + a) * kr + a] = 1.0;
+            // e_a x p
+            double e[3] = {0.0, 0.0, 0.0};
+            e[a] = 1.0;
+            double r[3] = {e[1] * p[2] - e[2] * p[1], e[2] * p[0] - e[0] * p[2], e[0] * p[1] - e[1] * p[0]};
+            for (int d = 0; d < 3; d++) rigid[(3 * i + d) * kr + 3 + a] = r[d];
+        }
+    }
+    std::mt19937 rng(12345);
+    std::vector<double> none;
+    orthonormalize(rigid, kr, dim, none, 0, rng);
+
+    std::vector<double> X(dim * k), Y(dim * k), HX(dim * k), T(dim * k);
+    std::uniform_real_distribution<double> u(-1.0, 1.0);
+    for (double& v : X) v = u(rng);
+
+    std::vector<double> G((size_t)k * k), V, ritz, residual(k);
+    auto rayleigh_ritz = [&]() {
+        orthonormalize(X, k, dim, rigid, kr, rng);
+        multiply(X.data(), HX.data(), k);
+        for (int a = 0; a < k; a++)
+            for (int b = a; b < k; b++)
+                G[a * k + b] = G[b * k + a] = dot(X, a, HX, b, k, dim);
+        symmetric_eigen(G, k, ritz, V);
+        rotate_block(X, k, dim, V);
+        rotate_block(HX, k, dim, V);
+        for (int v = 0; v < k; v++) {
+            double r2 = 0.0;
+            for (size_t d = 0; d < dim; d++) {
+                double e = HX[d * k + v] - ritz[v] * X[d * k + v];
+                r2 += e * e;
+            }
+            residual[v] = std::sqrt(r2);
+        }
+    };
+    rayleigh_ritz();
+
+    // Scaled Chebyshev filter: damps [a, b], amplifies the spectrum below a
+    const double b = upper_bound();
+    const double a0 = 0.0;
+    for (iters = 1; iters <= max_iterations; iters++) {
+        if (cancelled()) return false;
+        double a = std::max(ritz[k - 1], 1e-12 * b);
+        double e = (b - a) / 2.0, cen = (b + a) / 2.0;
+        double sigma = e / (a0 - cen), sigma1 = sigma;
+
+        // three-term recurrence, X holds the previous term and T the current one
+        multiply(X.data(), T.data(), k);
+        for (size_t d = 0; d < dim * k; d++) T[d] = (T[d] - cen * X[d]) * sigma1 / e;
+        for (int m = 2; m <= filter_degree; m++) {
+            if (cancelled()) return false;
+            double sigma2 = 1.0 / (2.0 / sigma1 - sigma);
+            multiply(T.data(), Y.data(), k);
+            for (size_t d = 0; d < dim * k; d++)
+                Y[d] = 2.0 * sigma2 / e * (Y[d] - cen * T[d]) - sigma * sigma2 * X[d];
+            X.swap(T);
+            T.swap(Y);
+            sigma = sigma2;
+        }
+        X.swap(T);
+
+        rayleigh_ritz();
+        bool done = true;
+        for (int v = 0; v < n_modes; v++)
+            if (residual[v] > tolerance * std::max(ritz[v], 1e-9 * b)) done = false;
+        if (done) break;
+    }
+
+    for (int v = 0; v < n_modes; v++) {
+        values.push_back((float)ritz[v]);
+        std::vector<float> m(dim);
+        for (size_t d = 0; d < dim; d++) m[d] = (float)X[d * k + v];
+        modes.push_back(std::move(m));
+    }
+    return !cancelled();
+}
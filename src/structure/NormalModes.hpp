@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "Superposer.hpp"
+
+// Anisotropic network model on the CA trace: equal springs between residues
+// within the cutoff. The sparse Hessian is kept as one unit bond vector per
+// contact, and the lowest non-rigid modes come from Chebyshev-filtered
+// subspace iteration with the six rigid-body motions projected out.
+class NormalModes {
+public:
+    // false when cancelled or when the trace is too small to have modes
+    bool compute(const CATrace& trace, int n_modes, const std::atomic<bool>* cancel = nullptr);
+
+    int num_modes() const { return (int)values.size(); }
+    size_t num_residues() const { return n; }
+    size_t num_contacts() const { return cols.size() / 2; }
+    int iterations() const { return iters; }
+    float eigenvalue(int m) const { return values[m]; }
+    // 3 * num_residues() displacements, xyz per residue, unit norm
+    const std::vector<float>& mode(int m) const { return modes[m]; }
+
+    float cutoff = 15.0f;           // Angstrom
+    float gamma = 1.0f;             // spring constant
+    int filter_degree = 30;
+    int max_iterations = 100;
+    double tolerance = 1e-2;        // residual relative to the eigenvalue
+
+private:
+    void build_network(const CATrace& trace);
+    // Y = H X for k vectors stored interleaved, X[dof * k + v]
+    void multiply(const double* X, double* Y, int k) const;
+    double upper_bound() const;
+
+    size_t n = 0;
+    std::vector<int> row_start, cols;
+    std::vector<float> ux, uy, uz;  // unit bond vector per contact
+    std::vector<float> values;
+    std::vector<std::vector<float>> modes;
+    int iters = 0;
+};
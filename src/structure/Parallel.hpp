@@ -0,0 +1,133 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace parallel_detail {
+
+// set on threads that run long builds beside the frame loop
+inline thread_local bool background = false;
+
+// Threads started on first use and kept for the life of the program, so a
+// parallel_for costs a wake-up rather than thread creation (and no heap
+// allocation, which keeps the frame loop off the heap). One job at a time:
+// run() refuses while another is in flight, including nested calls.
+// Background threads get a pool of their own: a surface build holding the
+// pool for seconds would otherwise leave every frame to one thread.
+class Pool {
+public:
+    static Pool& get() {
+        if (background) {
+            static Pool builds;
+            return builds;
+        }
+        static Pool pool;
+        return pool;
+    }
+    size_t threads() const { return workers.size() + 1; }
+
+    // job(ctx) on every worker and on the caller; returns once all are done
+    bool run(void (*job)(void*), void* ctx) {
+        bool idle = false;
+        if (!busy.compare_exchange_strong(idle, true)) return false;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            this->job = job;
+            this->ctx = ctx;
+            pending = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        job(ctx);
+        {
+            std::unique_lock<std::mutex> lock(m);
+            done.wait(lock, [&] { return pending == 0; });
+        }
+        busy = false;
+        return true;
+    }
+
+    ~Pool() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stop = true;
+            generation++;
+        }
+        wake.notify_all();
+        for (auto& th : workers) th.join();
+    }
+
+private:
+    Pool() {
+        size_t n = std::max(1u, std::thread::hardware_concurrency());
+        workers.reserve(n - 1);
+        for (size_t t = 1; t < n; ++t) workers.emplace_back([this] { loop(); });
+    }
+
+    void loop() {
+        size_t seen = 0;
+        std::unique_lock<std::mutex> lock(m);
+        for (;;) {
+            wake.wait(lock, [&] { return generation != seen; });
+            seen = generation;
+            if (stop) return;
+            void (*j)(void*) = job;
+            void* c = ctx;
+            lock.unlock();
+            j(c);
+            lock.lock();
+            if (--pending == 0) done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex m;
+    std::condition_variable wake, done;
+    std::atomic<bool> busy{false};
+    void (*job)(void*) = nullptr;
+    void* ctx = nullptr;
+    size_t pending = 0;
+    size_t generation = 0;
+    bool stop = false;
+};
+
+} // namespace parallel_detail
+
+// Marks the calling thread as a background one: its parallel_for calls share
+// the cores with the frame loop instead of taking its pool.
+inline void set_background_thread() { parallel_detail::background = true; }
+
+// Run f(i) for every i in [0, n) on up to hardware_concurrency threads, or
+// on the calling thread alone while the pool is busy with another job.
+// Items are handed out one at a time, so uneven work balances itself.
+template <typename F>
+void parallel_for(size_t n, F&& f) {
+    parallel_detail::Pool& pool = parallel_detail::Pool::get();
+    size_t n_threads = std::min<size_t>(pool.threads(), n);
+    if (n_threads <= 1) {
+        for (size_t i = 0; i < n; ++i) f(i);
+        return;
+    }
+
+    struct Work {
+        std::atomic<size_t> next{0};
+        size_t n;
+        std::remove_reference_t<F>* f;
+    } work;
+    work.n = n;
+    work.f = &f;
+    auto job = [](void* p) {
+        Work& w = *static_cast<Work*>(p);
+        for (size_t i = w.next++; i < w.n; i = w.next++) (*w.f)(i);
+    };
+    if (pool.run(job, &work)) return;
+
+    // the pool is taken (a call from inside f): the caller does the work
+    // itself rather than start threads on top of the pool
+    job(&work);
+}
@@ -1,5 +1,6 @@
 #include "Parameters.hpp"
 #include <cmath>
+#include <cstdio>
 
 static void print_help(){
     std::cout << "pdbterm — Terminal protein structure viewer\n\n";
@@ -12,19 +13,39 @@ static void print_help(){
     std::cout << "  -s, --structure      Show secondary structure (alpha helix, beta sheet)\n";
     std::cout << "  -p, --predict        Predict secondary structure if not in input file\n";
     std::cout << "  -c, --chains <file>  Show only selected chains (see example/chainfile)\n";
+    std::cout << "  -al, --align         Superpose all input structures onto the first one\n";
+    std::cout << "  --morph              Animate between two input conformations (implies --align)\n";
+    std::cout << "  --search <dir>       Rank structures in <dir> by TM-score against the input\n";
+    std::cout << "  --select \"<cmd>\"     Apply a selection command, repeatable (see below)\n";
+    std::cout << "  --map <file>         Overlay a CCP4/MRC density map as a mesh\n";
+    std::cout << "  --level <sigma>      Map contour level in sigma above the mean (default 1.5)\n";
     std::cout << "  --sixel              Render using Sixel graphics (requires Sixel-capable terminal)\n";
-    std::cout << "  --render <path>      Render a PNG screenshot and exit (headless, 1280x720)\n";
+    std::cout << "  --render <path>      Render a PNG screenshot and exit (headless)\n";
+    std::cout << "  --size <W>x<H>       Screenshot size in pixels (default 1280x720)\n";
+    std::cout << "  --ssaa <n>           Supersample the screenshot n x n, 1 to 4 (default 1)\n";
+    std::cout << "  --stats              Show rasterizer culling and overdraw per frame\n";
     std::cout << "  --help               Show this help message\n\n";
     std::cout << "Interactive controls:\n";
-    std::cout << "  Arrow keys / WASD   Pan the view\n";
+    std::cout << "  Arrow keys / WASD   Pan the view (contact map: move cursor)\n";
     std::cout << "  x / y / z           Rotate around axis\n";
     std::cout << "  r / f               Zoom in / out\n";
-    std::cout << "  v                   Cycle view mode (backbone/grid/surface)\n";
-    std::cout << "  c                   Cycle color scheme (rainbow/chain/structure)\n";
+    std::cout << "  v                   Cycle view mode (backbone/grid/surface/atoms/contacts)\n";
+    std::cout << "  c                   Cycle color scheme (rainbow/chain/structure/exposure/interface)\n";
     std::cout << "  p                   Cycle palette (neon/cool/warm/earth/pastel)\n";
+    std::cout << "  t                   Toggle secondary structure (CA trace / cartoon)\n";
     std::cout << "  Space               Toggle auto-rotation\n";
+    std::cout << "  m                   Pause / resume the morph (--morph mode)\n";
+    std::cout << "  e                   Cycle normal-mode animation (off/1/2/3)\n";
+    std::cout << "  + / -               Raise / lower the map contour level (--map mode)\n";
     std::cout << "  n                   Next random structure (--random mode)\n";
-    std::cout << "  q                   Quit\n";
+    std::cout << "  [ / ]               Previous / next search hit (--search mode)\n";
+    std::cout << "  h                   Toggle hover labels (residue under the mouse)\n";
+    std::cout << "  /                   Type a selection command\n";
+    std::cout << "  q                   Quit\n\n";
+    std::cout << "Selection commands:\n";
+    std::cout << "  hide|show|highlight <sel>, color <#rrggbb|name> <sel>, reset\n";
+    std::cout << "  <sel>: chain A,B  resi 10-20,35  resn LYS  ss helix,sheet,coil  interface  all  none\n";
+    std::cout << "         within 8 of <sel>  not <sel>  <sel> and <sel>  <sel> or <sel>  ( ... )\n";
 }
 
 Parameters::Parameters(int argc, char* argv[]) {
@@ -72,9 +93,18 @@ Parameters::Parameters(int argc, char* argv[]) {
             else if (!strcmp(argv[i], "-p") || !strcmp(argv[i], "--predict")) {
                 predict_structure = true;
             }
+            else if (!strcmp(argv[i], "-al") || !strcmp(argv[i], "--align")) {
+                align = true;
+            }
+            else if (!strcmp(argv[i], "--morph")) {
+                morph = true;
+            }
             else if (!strcmp(argv[i], "--sixel")) {
                 sixel = true;
             }
+            else if (!strcmp(argv[i], "--stats")) {
+                show_stats = true;
+            }
             else if (!strcmp(argv[i], "--random")) {
                 random_pdb = true;
             }
@@ -94,6 +124,63 @@ Parameters::Parameters(int argc, char* argv[]) {
                     throw std::runtime_error("Error: Missing value for --render.");
                 }
             }
+            else if (!strcmp(argv[i], "--size")) {
+                if (i + 1 < argc) {
+                    int w = 0, h = 0;
+                    char rest = 0;
+                    if (sscanf(argv[++i], "%dx%d%c", &w, &h, &rest) != 2 || w < 1 || h < 1 || w > 16384 || h > 16384) {
+                        throw std::runtime_error("Error: Invalid value for --size. Use <width>x<height>, e.g. 1920x1080.");
+                    }
+                    render_width = w;
+                    render_height = h;
+                } else {
+                    throw std::runtime_error("Error: Missing value for --size.");
+                }
+            }
+            else if (!strcmp(argv[i], "--ssaa")) {
+                if (i + 1 < argc) {
+                    render_ssaa = std::stoi(argv[++i]);
+                    if (render_ssaa < 1 || render_ssaa > 4) {
+                        throw std::runtime_error("Error: Invalid value for --ssaa. Use 1 to 4.");
+                    }
+                } else {
+                    throw std::runtime_error("Error: Missing value for --ssaa.");
+                }
+            }
+            else if (!strcmp(argv[i], "--select")) {
+                if (i + 1 < argc) {
+                    selections.push_back(argv[++i]);
+                } else {
+                    throw std::runtime_error("Error: Missing value for --select.");
+                }
+            }
+            else if (!strcmp(argv[i], "--map")) {
+                if (i + 1 < argc) {
+                    map_path = argv[++i];
+                    if (!fs::is_regular_file(map_path)) {
+                        throw std::runtime_error("Error: --map file not found: " + map_path);
+                    }
+                } else {
+                    throw std::runtime_error("Error: Missing value for --map.");
+                }
+            }
+            else if (!strcmp(argv[i], "--level")) {
+                if (i + 1 < argc) {
+                    map_level = std::stof(argv[++i]);
+                } else {
+                    throw std::runtime_error("Error: Missing value for --level.");
+                }
+            }
+            else if (!strcmp(argv[i], "--search")) {
+                if (i + 1 < argc) {
+                    search_dir = argv[++i];
+                    if (!fs::is_directory(search_dir)) {
+                        throw std::runtime_error("Error: --search needs a directory: " + search_dir);
+                    }
+                } else {
+                    throw std::runtime_error("Error: Missing value for --search.");
+                }
+            }
             else if (!strcmp(argv[i], "-ut") || !strcmp(argv[i], "--utmatrix")) {
                 if (i + 1 < argc) {
                     utmatrix = argv[++i];
@@ -125,6 +212,24 @@ Parameters::Parameters(int argc, char* argv[]) {
         return;
     }
 
+    if (align && !utmatrix.empty()) {
+        std::cerr << "Error: --align and --utmatrix are mutually exclusive." << std::endl;
+        arg_okay = false;
+        return;
+    }
+
+    if (morph && (in_file.size() != 2 || !utmatrix.empty() || !search_dir.empty())) {
+        std::cerr << "Error: --morph needs exactly two input files and no --utmatrix or --search." << std::endl;
+        arg_okay = false;
+        return;
+    }
+
+    if (!search_dir.empty() && in_file.size() != 1) {
+        std::cerr << "Error: --search needs exactly one input file as the query." << std::endl;
+        arg_okay = false;
+        return;
+    }
+
     // Need at least one input source
     if (in_file.size() == 0 && !random_pdb && pdb_id.empty()){
         std::cerr << "Error: Need input file, --pdb <ID>, or --random" << std::endl;
@@ -149,10 +254,28 @@ void Parameters::print_args() {
     cout << "  utmatrix: " << utmatrix << endl;
     cout << "  chainfile: " << chainfile << endl;
     cout << "  show_structure: " << show_structure << endl;
+    cout << "  align: " << align << endl;
+    if (morph) {
+        cout << "  morph: " << morph << endl;
+    }
     cout << "  sixel: " << sixel << endl;
     cout << "  random: " << random_pdb << endl;
+    if (show_stats) {
+        cout << "  stats: " << show_stats << endl;
+    }
+    if (!search_dir.empty()) {
+        cout << "  search: " << search_dir << endl;
+    }
+    if (!map_path.empty()) {
+        cout << "  map: " << map_path << " at " << map_level << " sigma" << endl;
+    }
+    for (const string& sel : selections) {
+        cout << "  select: " << sel << endl;
+    }
     if (!render_path.empty()) {
-        cout << "  render: " << render_path << endl;
+        cout << "  render: " << render_path << " at " << render_width << "x" << render_height;
+        if (render_ssaa > 1) cout << ", " << render_ssaa << "x" << render_ssaa << " supersampled";
+        cout << endl;
     }
     cout << "\n";
     return;
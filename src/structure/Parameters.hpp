@@ -15,14 +15,24 @@ class Parameters{
         bool predict_structure = false;
         bool sixel = false;
         bool random_pdb = false;
+        bool align = false;
+        bool morph = false;
+        bool show_stats = false;
         bool arg_okay = true;
         vector<string> in_file;
         vector<string> chains;
+        vector<string> selections;
         string utmatrix = "";
         string chainfile = "";
         string mode = "protein";
         string pdb_id = "";
         string render_path = "";
+        int render_width = 1280;
+        int render_height = 720;
+        int render_ssaa = 1;
+        string search_dir = "";
+        string map_path = "";
+        float map_level = 1.5f;
     public:
         Parameters(int argc, char* argv[]);
 
@@ -61,10 +71,40 @@ class Parameters{
         bool get_random_pdb(){
             return random_pdb;
         }
+        bool get_align(){
+            return align;
+        }
+        bool get_morph(){
+            return morph;
+        }
+        bool get_show_stats(){
+            return show_stats;
+        }
         string get_pdb_id(){
             return pdb_id;
         }
         string get_render_path(){
             return render_path;
         }
+        int get_render_width(){
+            return render_width;
+        }
+        int get_render_height(){
+            return render_height;
+        }
+        int get_render_ssaa(){
+            return render_ssaa;
+        }
+        string get_search_dir(){
+            return search_dir;
+        }
+        string get_map_path(){
+            return map_path;
+        }
+        float get_map_level(){
+            return map_level;
+        }
+        vector<string>& get_selections(){
+            return selections;
+        }
 };
@@ -1,4 +1,7 @@
 #include "Protein.hpp"
+#include <bitset>
+#include "CellList.hpp"
+#include "Parallel.hpp"
 
 static gemmi::Structure read_structure(const std::string& path) {
     gemmi::Structure st = gemmi::read_structure_file(path);
@@ -21,13 +24,90 @@ Protein::Protein(const std::string& in_file_, const std::string& target_chains_,
 }
 
 Protein::~Protein() {
+    stop_surface_build();
+    stop_modes();
+    stop_exposure();
 }
 
 std::map<std::string, std::vector<Atom>>& Protein::get_atoms() {
     return screen_atoms;  
 }
 
-std::map<std::string, int> Protein::get_residue_count() {
+std::map<std::string, std::vector<Atom>>& Protein::get_render_atoms(float px_per_unit) {
+    // the trace is screen_atoms itself, its cartoon control points trail each
+    // chain past get_chain_length()
+    if (!show_structure) return screen_atoms;
+
+    for (auto& [chainID, cartoon] : cartoons) {
+        const std::vector<Atom>& controls = screen_atoms[chainID];
+        structureMaker.tessellate(controls, px_per_unit, cartoon);
+        structureMaker.evaluate(controls, cartoon, render_atoms[chainID]);
+    }
+    return render_atoms;
+}
+
+CATrace Protein::get_ca_trace() {
+    CATrace trace;
+    for (const auto& [chainID, atoms] : init_atoms) {
+        const std::vector<int>& nums = residue_numbers[chainID];
+        const std::string& seq = sequences[chainID];
+        for (size_t i = 0; i < atoms.size(); i++) {
+            trace.push_back(atoms[i].x, atoms[i].y, atoms[i].z, nums[i], chainID, seq[i]);
+        }
+    }
+    return trace;
+}
+
+const AtomTable& Protein::get_atom_table() {
+    // "ss" has to match without the cartoon ever having been built
+    ensure_ss();
+    if (atom_table_ready) return atom_table;
+    compute_interface();
+    atom_table = AtomTable();
+    for (const auto& [chainID, atoms] : init_atoms) {
+        uint16_t c = (uint16_t)atom_table.chain_names.size();
+        atom_table.chain_names.push_back(chainID);
+        const std::vector<int>& nums = residue_numbers[chainID];
+        const std::string& seq = sequences[chainID];
+        for (size_t i = 0; i < atoms.size(); i++) {
+            atom_table.x.push_back(atoms[i].x);
+            atom_table.y.push_back(atoms[i].y);
+            atom_table.z.push_back(atoms[i].z);
+            atom_table.resnum.push_back(nums[i]);
+            atom_table.chain.push_back(c);
+            atom_table.ss.push_back(atoms[i].structure);
+            atom_table.aa.push_back(seq[i]);
+            atom_table.interface.push_back(atoms[i].interface);
+        }
+    }
+    atom_table_ready = true;
+    return atom_table;
+}
+
+size_t Protein::apply_selection(const SelectionCommand& command) {
+    Bitset sel = (command.action == SelectAction::RESET) ? Bitset(get_length(), true)
+                                                          : command.selection.evaluate(get_atom_table());
+    // display flags live on the trace part of screen_atoms, which the cartoon
+    // and the surface read them from
+    size_t row = 0;
+    for (auto& [chainID, atoms] : screen_atoms) {
+        size_t n = init_atoms[chainID].size();
+        for (size_t i = 0; i < n && i < atoms.size(); i++, row++) {
+            if (!sel.test(row)) continue;
+            Atom& a = atoms[i];
+            switch (command.action) {
+                case SelectAction::HIDE:      a.hidden = true; break;
+                case SelectAction::SHOW:      a.hidden = false; break;
+                case SelectAction::HIGHLIGHT: a.highlight = true; break;
+                case SelectAction::COLOR:     a.color = command.color; break;
+                case SelectAction::RESET:     a.hidden = a.highlight = false; a.color = -1; break;
+            }
+        }
+    }
+    return sel.count();
+}
+
+const std::map<std::string, int>& Protein::get_residue_count() {
     return chain_res_count;
 }
 
@@ -40,8 +120,8 @@ std::map<std::string, int> Protein::get_chain_length() {
 }
 
 int Protein::get_chain_length(std::string chainID) {
-    if (screen_atoms.count(chainID)) {
-        return screen_atoms[chainID].size();
+    if (init_atoms.count(chainID)) {
+        return init_atoms[chainID].size();
     }
     return 0;
 }
@@ -71,21 +151,14 @@ void Protein::set_scale(float scale_) {
     cx = 0.5f * (bounding_box.min_x + bounding_box.max_x);
     cy = 0.5f * (bounding_box.min_y + bounding_box.max_y);
     cz = 0.5f * (bounding_box.min_z + bounding_box.max_z);
-    ssPredictor.set_scale(1.0f/scale);
 }    
 
-bool Protein::is_ss_in_file(const std::string& in_file) {
-    try {
-        gemmi::Structure st = read_structure(in_file);
-        return (!st.helices.empty() || !st.sheets.empty());
-    } catch (...) {
-        return false;
-    }
-}
-
 void Protein::set_bounding_box() {
+    // CA atoms only, the cartoon control points after them would move the box
     for (auto& [chainID, chain_atoms] : screen_atoms) {
-        for (Atom& atom : chain_atoms) {
+        size_t n = std::min(chain_atoms.size(), (size_t)get_chain_length(chainID));
+        for (size_t i = 0; i < n; i++) {
+            const Atom& atom = chain_atoms[i];
             bounding_box.min_x = std::min(bounding_box.min_x, atom.x);
             bounding_box.min_y = std::min(bounding_box.min_y, atom.y);
             bounding_box.min_z = std::min(bounding_box.min_z, atom.z);
@@ -94,15 +167,19 @@ void Protein::set_bounding_box() {
             bounding_box.max_z = std::max(bounding_box.max_z, atom.z);
         }
     }
+    if (!morph.empty()) {
+        // the far end of the morph has to fit as well
+        morph.evaluate(1.0f);
+        for (size_t i = 0; i < morph.size(); i++)
+            bounding_box.expand(morph.x()[i], morph.y()[i], morph.z()[i]);
+    }
 }         
 
-void Protein::count_seqres(const std::string& file) {
+void Protein::count_seqres(const gemmi::Structure& st) {
     // std::cout << "  count SEQRES\n";
     chain_res_count.clear();
 
     try {
-        gemmi::Structure st = read_structure(file);
-
         for (const gemmi::Entity& ent : st.entities) {
             int len = (int)ent.full_sequence.size();
             if (len <= 0) continue;
@@ -118,14 +195,15 @@ void Protein::count_seqres(const std::string& file) {
     }
 }
 
-void Protein::load_init_atoms(const std::string& in_file, 
+void Protein::load_init_atoms(gemmi::Structure& st,
                               const std::string& target_chains,
-                              const std::vector<std::tuple<std::string, int, std::string, int, char>>& ss_info, 
-                              float * vectorpointers , bool yesUT) {
+                              const std::vector<std::tuple<std::string, int, std::string, int, char>>& ss_info) {
     // std::cout << "  load atoms\n";
     init_atoms.clear();
-
-    gemmi::Structure st = read_structure(in_file);
+    residue_numbers.clear();
+    sequences.clear();
+    full_atoms = FullAtoms();
+    full_bonds_built = false;
 
     // Extract metadata
     auto it_title = st.info.find("_struct.title");
@@ -144,83 +222,90 @@ void Protein::load_init_atoms(const std::string& in_file,
         if (!chain_ok(target_chains, cid))
             continue;
 
+        uint16_t chain_row = (uint16_t)full_atoms.table.chain_names.size();
+        full_atoms.table.chain_names.push_back(cid);
         for (gemmi::Residue& res : chain.residues) {
             const gemmi::Atom* ca = res.get_ca();
+            add_full_atoms(res, chain_row, ca ? (int)init_atoms[cid].size() : -1);
             if (!ca) continue;
-            if (!res.seqid.num.has_value()) continue;
 
-            int resn = (int)res.seqid.num;
             float x = (float)ca->pos.x;
             float y = (float)ca->pos.y;
             float z = (float)ca->pos.z;
 
             Atom a(x, y, z);
+            int resn = res.seqid.num.has_value() ? (int)res.seqid.num : 0;
 
-            for (auto& t : ss_info) {
-                std::string sc; int s; std::string ec; int e; char type;
-                std::tie(sc, s, ec, e, type) = t;
+            if (res.seqid.num.has_value()) {
+                for (auto& t : ss_info) {
+                    std::string sc; int s; std::string ec; int e; char type;
+                    std::tie(sc, s, ec, e, type) = t;
 
-                if (cid == sc && resn >= s && resn <= e) {
-                    a.set_structure(type);
-                    break;
+                    if (cid == sc && resn >= s && resn <= e) {
+                        a.set_structure(type);
+                        break;
+                    }
                 }
             }
             init_atoms[cid].push_back(a);
+            residue_numbers[cid].push_back(resn);
+            sequences[cid].push_back(Superposer::one_letter(res.name));
         }
     }
-}
 
-void Protein::load_init_atoms(const std::string& in_file,
-                              const std::string& target_chains, float * vectorpointers, bool yesUT) {
-    // std::cout << "  load atoms\n";
-    init_atoms.clear();
-
-    gemmi::Structure st = read_structure(in_file);
-
-    // Extract metadata (same as SS overload)
-    if (protein_title.empty()) {
-        auto it_title = st.info.find("_struct.title");
-        if (it_title != st.info.end())
-            protein_title = it_title->second;
+    // residues were numbered within their chain; make them rows in
+    // get_atoms() order, which is sorted by chain ID
+    std::map<std::string, int> chain_offset;
+    int offset = 0;
+    for (const auto& [chainID, atoms] : init_atoms) {
+        chain_offset[chainID] = offset;
+        offset += (int)atoms.size();
     }
-    if (pdb_id.empty()) {
-        auto it_id = st.info.find("_entry.id");
-        if (it_id != st.info.end())
-            pdb_id = it_id->second;
-        else
-            pdb_id = st.name;
+    AtomTable& table = full_atoms.table;
+    for (size_t i = 0; i < full_atoms.size(); i++) {
+        int& r = full_atoms.residue[i];
+        if (r < 0) continue;
+        const std::string& cid = table.chain_names[table.chain[i]];
+        table.ss[i] = init_atoms[cid][r].structure;
+        r += chain_offset[cid];
     }
+}
 
-    gemmi::Model& model = st.first_model();
-
-    for (gemmi::Chain& chain : model.chains) {
-        std::string cid = chain.name.empty() ? "?" : chain.name;
-        if (!chain_ok(target_chains, cid))
-            continue;
-
-        for (gemmi::Residue& res : chain.residues) {
-            const gemmi::Atom* ca = res.get_ca();
-            if (!ca) continue;
-
-            float x = (float)ca->pos.x;
-            float y = (float)ca->pos.y;
-            float z = (float)ca->pos.z;
-
-            Atom a(x, y, z, 'x'); 
-            init_atoms[cid].push_back(a);
-        }
+void Protein::add_full_atoms(const gemmi::Residue& res, uint16_t chain_row, int residue) {
+    if (res.is_water()) return;
+    int resn = res.seqid.num.has_value() ? (int)res.seqid.num : 0;
+    char aa = Superposer::one_letter(res.name);
+    AtomTable& table = full_atoms.table;
+    for (auto it = res.atoms.begin(); it != res.atoms.end(); ++it) {
+        const gemmi::Atom& atom = *it;
+        if (atom.element.is_hydrogen()) continue;
+        // of alternate conformers the first listed, whatever its label (B only,
+        // '1'), as get_ca() picks the trace atom
+        if (atom.altloc != '\0' && std::any_of(res.atoms.begin(), it, [&](const gemmi::Atom& o) {
+                return o.altloc != '\0' && o.name == atom.name;
+            })) continue;
+        std::string el = atom.element.name();
+        char e = (el.size() == 1 && std::string("CNOSP").find(el[0]) != std::string::npos) ? el[0] : 'X';
+
+        table.x.push_back((float)atom.pos.x);
+        table.y.push_back((float)atom.pos.y);
+        table.z.push_back((float)atom.pos.z);
+        table.resnum.push_back(resn);
+        table.chain.push_back(chain_row);
+        table.ss.push_back('x');
+        table.aa.push_back(aa);
+        full_atoms.element.push_back(e);
+        full_atoms.residue.push_back(residue);
     }
 }
 
-void Protein::load_ss_info(const std::string& in_file,
+void Protein::load_ss_info(const gemmi::Structure& st,
                                const std::string& target_chains,
                                std::vector<std::tuple<std::string,int,std::string,int,char>>& ss_info)
 {
     // std::cout << "  load SS info\n";
     ss_info.clear();
 
-    gemmi::Structure st = read_structure(in_file);
-
     // Helix → H
     for (const gemmi::Helix& h : st.helices) {
         auto beg = h.start;
@@ -275,31 +360,32 @@ std::ostream& operator<<(std::ostream& os, const std::tuple<std::string, int, st
 void Protein::load_data(float * vectorpointers, bool yesUT) {    
     // pdb
     if (in_file.find(".pdb") != std::string::npos || in_file.find(".cif") != std::string::npos) {
-        if (show_structure){
-            if (is_ss_in_file(in_file)){
-                std::vector<std::tuple<std::string, int, std::string, int, char>> ss_info;
-                load_ss_info(in_file, target_chains, ss_info);
-                load_init_atoms(in_file, target_chains, ss_info, vectorpointers, yesUT);
-            }
-            else{
-                load_init_atoms(in_file, target_chains, vectorpointers, yesUT);
-                ssPredictor.run(init_atoms);
-            }
-        }
-        else{
-            load_init_atoms(in_file, target_chains, vectorpointers, yesUT);
-        }
+        // parse once; SS records are kept even when hidden so toggling needs no reload
+        gemmi::Structure st = read_structure(in_file);
+        std::vector<std::tuple<std::string, int, std::string, int, char>> ss_info;
+        load_ss_info(st, target_chains, ss_info);
+        load_init_atoms(st, target_chains, ss_info);
+        ss_assigned = !ss_info.empty();
         
         if (init_atoms.empty()) {
             std::cerr << "Error: input PDB file is empty." << std::endl;
             return;
         }
         
+        compute_occlusion();
+        stop_exposure();
+        interface_ready = false;
+        atom_table_ready = false;
+        stop_modes();
+        morph.clear();
+        screen_atoms = init_atoms;
+        cartoons.clear();
+        render_atoms.clear();
         if (show_structure){
-            structureMaker.calculate_ss_points(init_atoms, screen_atoms);
+            build_cartoons();
         }
-        else{ screen_atoms = init_atoms; }
-        count_seqres(in_file);
+        count_seqres(st);
+        start_surface_build();
     }
 
     // others
@@ -310,6 +396,459 @@ void Protein::load_data(float * vectorpointers, bool yesUT) {
     std::cout << std::endl;
 }
 
+void Protein::ensure_ss() {
+    if (ss_assigned) return;
+    ssPredictor.run(init_atoms);
+    for (auto& [chainID, atoms] : init_atoms) {
+        std::vector<Atom>& controls = screen_atoms[chainID];
+        for (size_t i = 0; i < atoms.size() && i < controls.size(); i++)
+            controls[i].set_structure(atoms[i].get_structure());
+    }
+    ss_assigned = true;
+    // the selection table carries the assignment as a column
+    atom_table_ready = false;
+}
+
+void Protein::build_cartoons() {
+    ensure_ss();
+
+    // built from the current (already transformed) trace, so Angstrom
+    // lengths are converted with the normalization scale once it is set
+    float unit = (scale > 0.0f) ? scale : 1.0f;
+    for (auto& [chainID, controls] : screen_atoms) {
+        structureMaker.build_cartoon(controls, unit, cartoons[chainID]);
+    }
+}
+
+// View-independent ambient occlusion per residue: the fraction of a fixed set
+// of directions not blocked by a neighbouring residue (a 3 A sphere) within
+// 12 A. Computed once here, applied by the renderer with the depth cue.
+void Protein::compute_occlusion() {
+    const int n_dirs = 32;
+    const float reach = 12.0f, blocker = 3.0f;
+    const float floor_ = 0.4f;      // fully buried residues keep this much light
+    const float exposed = 0.6f;     // open fraction treated as fully lit
+
+    static float dirs[n_dirs][3];
+    static bool dirs_ready = [] {
+        // Fibonacci sphere
+        const float golden = 2.39996323f;
+        for (int k = 0; k < n_dirs; k++) {
+            float z = 1.0f - (2.0f * k + 1.0f) / n_dirs;
+            float r = sqrtf(1.0f - z * z);
+            dirs[k][0] = r * cosf(golden * k); dirs[k][1] = r * sinf(golden * k); dirs[k][2] = z;
+        }
+        return true;
+    }();
+    (void)dirs_ready;
+
+    std::vector<float> x, y, z;
+    std::vector<Atom*> atoms;
+    for (auto& [chainID, chain_atoms] : init_atoms)
+        for (Atom& atom : chain_atoms) {
+            x.push_back(atom.x); y.push_back(atom.y); z.push_back(atom.z);
+            atoms.push_back(&atom);
+        }
+    if (atoms.empty()) return;
+
+    CellList grid;
+    grid.build(x.data(), y.data(), z.data(), atoms.size(), reach);
+    const size_t block = 256;
+    parallel_for((atoms.size() + block - 1) / block, [&](size_t b) {
+        for (size_t i = b * block; i < std::min(atoms.size(), (b + 1) * block); i++) {
+            uint32_t blocked = 0;
+            grid.for_near(x[i], y[i], z[i], [&](int j) {
+                float dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+                float d2 = dx * dx + dy * dy + dz * dz;
+                if (d2 < 1e-4f || d2 > reach * reach) return;
+                float d = sqrtf(d2);
+                // cone covered by the neighbour's sphere
+                float cos_cone = (d > blocker) ? sqrtf(1.0f - blocker * blocker / d2) : 0.0f;
+                for (int k = 0; k < n_dirs; k++)
+                    if (dx * dirs[k][0] + dy * dirs[k][1] + dz * dirs[k][2] > cos_cone * d) blocked |= 1u << k;
+            });
+            float open = 1.0f - (float)std::bitset<32>(blocked).count() / n_dirs;
+            atoms[i]->occlusion = floor_ + (1.0f - floor_) * std::min(1.0f, open / exposed);
+        }
+    });
+}
+
+void Protein::start_surface_build() {
+    stop_surface_build();
+
+    std::vector<float> x, y, z;
+    std::vector<std::pair<std::string, int>> ids;
+    for (const auto& [chainID, atoms] : init_atoms) {
+        for (size_t i = 0; i < atoms.size(); i++) {
+            x.push_back(atoms[i].x); y.push_back(atoms[i].y); z.push_back(atoms[i].z);
+            ids.push_back({chainID, (int)i});
+        }
+    }
+
+    // anchors: a far point, the point farthest from it, the one farthest from
+    // that line and the one farthest from the resulting plane
+    anchors_valid = false;
+    if (x.size() < 4) return;
+    auto farthest = [&](auto&& dist) {
+        size_t best = 0;
+        float best_d = -1.0f;
+        for (size_t i = 0; i < x.size(); i++) {
+            float d = dist(i);
+            if (d > best_d) { best_d = d; best = i; }
+        }
+        return best;
+    };
+    size_t a0 = farthest([&](size_t i) { return fabsf(x[i] - x[0]) + fabsf(y[i] - y[0]) + fabsf(z[i] - z[0]); });
+    auto edge = [&](size_t from, size_t to, float (&e)[3]) {
+        e[0] = x[to] - x[from]; e[1] = y[to] - y[from]; e[2] = z[to] - z[from];
+    };
+    float e1[3], e2[3], e3[3], n[3];
+    size_t a1 = farthest([&](size_t i) { edge(a0, i, e1); return e1[0]*e1[0] + e1[1]*e1[1] + e1[2]*e1[2]; });
+    edge(a0, a1, e1);
+    size_t a2 = farthest([&](size_t i) {
+        float e[3]; edge(a0, i, e);
+        float c[3] = {e1[1]*e[2] - e1[2]*e[1], e1[2]*e[0] - e1[0]*e[2], e1[0]*e[1] - e1[1]*e[0]};
+        return c[0]*c[0] + c[1]*c[1] + c[2]*c[2];
+    });
+    edge(a0, a2, e2);
+    n[0] = e1[1]*e2[2] - e1[2]*e2[1]; n[1] = e1[2]*e2[0] - e1[0]*e2[2]; n[2] = e1[0]*e2[1] - e1[1]*e2[0];
+    size_t a3 = farthest([&](size_t i) { float e[3]; edge(a0, i, e); return fabsf(n[0]*e[0] + n[1]*e[1] + n[2]*e[2]); });
+    edge(a0, a3, e3);
+
+    // columns e1 e2 e3; det is the tetrahedron volume times six
+    float det = n[0]*e3[0] + n[1]*e3[1] + n[2]*e3[2];
+    if (fabsf(det) < 1.0f) return;
+    float E[9] = {e1[0], e2[0], e3[0], e1[1], e2[1], e3[1], e1[2], e2[2], e3[2]};
+    anchor_inv[0] = (E[4]*E[8] - E[5]*E[7]) / det;
+    anchor_inv[1] = (E[2]*E[7] - E[1]*E[8]) / det;
+    anchor_inv[2] = (E[1]*E[5] - E[2]*E[4]) / det;
+    anchor_inv[3] = (E[5]*E[6] - E[3]*E[8]) / det;
+    anchor_inv[4] = (E[0]*E[8] - E[2]*E[6]) / det;
+    anchor_inv[5] = (E[2]*E[3] - E[0]*E[5]) / det;
+    anchor_inv[6] = (E[3]*E[7] - E[4]*E[6]) / det;
+    anchor_inv[7] = (E[1]*E[6] - E[0]*E[7]) / det;
+    anchor_inv[8] = (E[0]*E[4] - E[1]*E[3]) / det;
+    anchor_origin[0] = x[a0]; anchor_origin[1] = y[a0]; anchor_origin[2] = z[a0];
+    surface_anchor[0] = ids[a0]; surface_anchor[1] = ids[a1];
+    surface_anchor[2] = ids[a2]; surface_anchor[3] = ids[a3];
+    anchors_valid = true;
+
+    surface_thread = std::thread([this, x = std::move(x), y = std::move(y), z = std::move(z)]() {
+        set_background_thread();
+        if (surfaceBuilder.build(x, y, z, surface, &surface_cancel))
+            surface_ready.store(true, std::memory_order_release);
+    });
+}
+
+void Protein::stop_surface_build() {
+    if (surface_thread.joinable()) {
+        surface_cancel = true;
+        surface_thread.join();
+    }
+    surface_cancel = false;
+    surface_ready = false;
+}
+
+void Protein::request_modes(int n_modes) {
+    if (modes_thread.joinable() || init_atoms.empty()) return;
+    modes_thread = std::thread([this, trace = get_ca_trace(), n_modes]() {
+        set_background_thread();
+        if (modes.compute(trace, n_modes, &modes_cancel))
+            modes_ready.store(true, std::memory_order_release);
+    });
+}
+
+void Protein::stop_modes() {
+    if (modes_thread.joinable()) {
+        modes_cancel = true;
+        modes_thread.join();
+    }
+    modes_cancel = false;
+    modes_ready = false;
+}
+
+const NormalModes* Protein::get_modes() {
+    if (!modes_ready.load(std::memory_order_acquire)) return nullptr;
+    return &modes;
+}
+
+bool Protein::animate_mode(int m) {
+    stop_morph();
+    const NormalModes* nm = get_modes();
+    float M[12];
+    if (!nm || m < 0 || m >= nm->num_modes() || !get_surface_transform(M)) return false;
+    const std::vector<float>& v = nm->mode(m);
+
+    // at most 6 A for the residue that moves most, 2 A rms over the chain
+    float peak = 0.0f;
+    for (size_t i = 0; i < v.size(); i += 3)
+        peak = std::max(peak, v[i] * v[i] + v[i + 1] * v[i + 1] + v[i + 2] * v[i + 2]);
+    if (peak <= 0.0f) return false;
+    float amplitude = std::min(2.0f * std::sqrt((float)nm->num_residues()), 6.0f / std::sqrt(peak));
+
+    // the mode lives in the Angstrom frame; only the linear part of the
+    // screen map applies to a displacement
+    std::vector<float> lo(v.size()), hi(v.size());
+    for (size_t i = 0; i < v.size(); i += 3)
+        for (int r = 0; r < 3; r++) {
+            float d = amplitude * (M[3*r] * v[i] + M[3*r + 1] * v[i + 1] + M[3*r + 2] * v[i + 2]);
+            lo[i + r] = -d;
+            hi[i + r] = d;
+        }
+    // the rest frame sits at mid-phase with no displacement, and that is the
+    // frame get_surface_transform pins the surface and atom layers to
+    if (!set_morph_path(lo, hi, 0.5f)) return false;
+    set_morph_frame(0.5f);
+    return true;
+}
+
+const FullAtoms& Protein::get_full_atoms() {
+    if (!full_bonds_built) {
+        full_atoms.build_bonds();
+        full_bonds_built = true;
+    }
+    return full_atoms;
+}
+
+bool Protein::set_morph_target(Protein& other) {
+    stop_morph();
+    std::vector<int> ref_idx, mob_idx;
+    Superposer superposer;
+    superposer.match_residues(get_ca_trace(), other.get_ca_trace(), ref_idx, mob_idx);
+    if (ref_idx.size() < 3) return false;
+
+    std::vector<const Atom*> other_rows;
+    for (auto& [chainID, atoms] : other.screen_atoms)
+        for (size_t i = 0; i < other.init_atoms[chainID].size(); i++) other_rows.push_back(&atoms[i]);
+    std::vector<int> partner(get_length(), -1);
+    for (size_t k = 0; k < ref_idx.size(); k++) partner[ref_idx[k]] = mob_idx[k];
+
+    std::vector<float> disp(3 * partner.size(), 0.0f);
+    int row = 0;
+    for (auto& [chainID, controls] : screen_atoms) {
+        const int n = (int)init_atoms[chainID].size();
+        float* d = &disp[3 * row];
+        int prev = -1;
+        auto fill_gap = [&](int from, int to) {
+            // residues between two paired ones move by the blend of their displacements
+            for (int g = from + 1; g < to; g++) {
+                int src_lo = (from >= 0) ? from : to, src_hi = (to < n) ? to : from;
+                if (src_lo < 0 || src_hi >= n) continue;
+                float w = (src_lo == src_hi) ? 0.0f : (float)(g - from) / (to - from);
+                for (int c = 0; c < 3; c++)
+                    d[3 * g + c] = d[3 * src_lo + c] + w * (d[3 * src_hi + c] - d[3 * src_lo + c]);
+            }
+        };
+        for (int i = 0; i < n; i++) {
+            int p = partner[row + i];
+            if (p < 0) continue;
+            d[3 * i] = other_rows[p]->x - controls[i].x;
+            d[3 * i + 1] = other_rows[p]->y - controls[i].y;
+            d[3 * i + 2] = other_rows[p]->z - controls[i].z;
+            fill_gap(prev, i);
+            prev = i;
+        }
+        if (prev >= 0) fill_gap(prev, n);
+        row += n;
+    }
+    return set_morph_path(std::vector<float>(disp.size(), 0.0f), disp, 0.0f);
+}
+
+bool Protein::set_morph_path(const std::vector<float>& start_disp, const std::vector<float>& end_disp, float rest) {
+    morph.clear();
+    // both ends need the same control points, so the cartoon is built up front
+    // even while the trace is shown
+    if (cartoons.empty()) build_cartoons();
+    float unit = (scale > 0.0f) ? scale : 1.0f;
+
+    std::vector<Atom> start, end;
+    size_t row = 0;
+    for (auto& [chainID, controls] : screen_atoms) {
+        const size_t n = init_atoms[chainID].size();
+        if (3 * (row + n) > start_disp.size() || 3 * (row + n) > end_disp.size()) return false;
+        for (int side = 0; side < 2; side++) {
+            const float* d = &(side ? end_disp : start_disp)[3 * row];
+            std::vector<Atom> moved(controls.begin(), controls.begin() + n);
+            for (size_t i = 0; i < n; i++)
+                moved[i].set_position(moved[i].x + d[3 * i], moved[i].y + d[3 * i + 1], moved[i].z + d[3 * i + 2]);
+            if (cartoons.count(chainID)) {
+                Cartoon unused;
+                structureMaker.build_cartoon(moved, unit, unused);
+            }
+            if (moved.size() != controls.size()) return false;
+            std::vector<Atom>& out = side ? end : start;
+            out.insert(out.end(), moved.begin(), moved.end());
+        }
+        row += n;
+    }
+    morph.set(start, end);
+    morph_rest = rest;
+    return true;
+}
+
+void Protein::stop_morph() {
+    if (morph.empty()) return;
+    set_morph_frame(morph_rest);
+    morph.clear();
+}
+
+void Protein::set_morph_frame(float t) {
+    if (morph.empty()) return;
+    morph.evaluate(t);
+    const float *x = morph.x(), *y = morph.y(), *z = morph.z();
+    size_t k = 0;
+    for (auto& [chainID, controls] : screen_atoms)
+        for (Atom& atom : controls) {
+            atom.x = x[k]; atom.y = y[k]; atom.z = z[k];
+            k++;
+        }
+}
+
+void Protein::compute_exposure() {
+    if (exposure_ready || init_atoms.empty()) return;
+    if (!exposure_thread.joinable()) {
+        set_exposure(std::vector<float>(get_length(), -1.0f));
+        // the atoms go to the thread by value, as for the surface build
+        const size_t n_res = (size_t)get_length();
+        if (full_atoms.size() > n_res) {
+            exposure_thread = std::thread([this, n_res, table = full_atoms.table, element = full_atoms.element,
+                                           residue = full_atoms.residue]() {
+                set_background_thread();
+                // heavy atoms, ligands included as occluders, summed per residue
+                SasaCalculator sasa;
+                std::vector<float> radius(element.size());
+                for (size_t i = 0; i < radius.size(); i++) radius[i] = SasaCalculator::vdw_radius(element[i]);
+                std::vector<float> area = sasa.compute(table.x, table.y, table.z, radius);
+                std::vector<float> sum(n_res, 0.0f), rel(n_res, 1.0f);
+                std::vector<char> aa(n_res, 'X');
+                for (size_t i = 0; i < area.size(); i++) {
+                    int r = residue[i];
+                    if (r < 0 || r >= (int)sum.size()) continue;
+                    sum[r] += area[i];
+                    aa[r] = table.aa[i];
+                }
+                for (size_t r = 0; r < rel.size(); r++)
+                    rel[r] = std::min(1.0f, sum[r] / SasaCalculator::max_residue_area(aa[r]));
+                exposure = std::move(rel);
+                exposure_done.store(true, std::memory_order_release);
+            });
+        } else {
+            exposure_thread = std::thread([this, n_res, trace = get_ca_trace()]() {
+                set_background_thread();
+                // CA only: the open fraction of a residue-sized pseudo-atom
+                SasaCalculator sasa;
+                const float r_ca = 3.0f;
+                std::vector<float> area = sasa.compute(trace.x, trace.y, trace.z, std::vector<float>(trace.size(), r_ca));
+                float full = 4.0f * (float)M_PI * (r_ca + sasa.probe_radius) * (r_ca + sasa.probe_radius);
+                std::vector<float> rel(n_res, 1.0f);
+                for (size_t r = 0; r < rel.size() && r < area.size(); r++) rel[r] = area[r] / full;
+                exposure = std::move(rel);
+                exposure_done.store(true, std::memory_order_release);
+            });
+        }
+        return;
+    }
+    if (!exposure_done.load(std::memory_order_acquire)) return;
+    exposure_thread.join();
+    exposure_ready = true;
+    set_exposure(exposure);
+}
+
+void Protein::set_exposure(const std::vector<float>& rel) {
+    size_t row = 0;
+    for (auto& [chainID, atoms] : init_atoms) {
+        std::vector<Atom>& controls = screen_atoms[chainID];
+        for (size_t i = 0; i < atoms.size(); i++, row++) {
+            atoms[i].exposure = rel[row];
+            if (i < controls.size()) controls[i].exposure = rel[row];
+        }
+    }
+}
+
+void Protein::stop_exposure() {
+    // Shrake-Rupley has no cancel point; a reload waits for the one running
+    if (exposure_thread.joinable()) exposure_thread.join();
+    exposure_done = false;
+    exposure_ready = false;
+}
+
+void Protein::compute_interface() {
+    if (interface_ready || init_atoms.empty()) return;
+    interface_ready = true;
+    InterfaceFinder finder;
+    std::vector<char> flags;
+    if (full_atoms.size() > (size_t)get_length()) {
+        flags = finder.find(full_atoms.table, full_atoms.residue, get_length());
+    } else {
+        // CA only: residue centres, with a cutoff to match
+        finder.cutoff = 8.0f;
+        const AtomTable& table = get_atom_table();
+        std::vector<int> rows(table.size());
+        for (size_t i = 0; i < rows.size(); i++) rows[i] = (int)i;
+        flags = finder.find(table, rows, get_length());
+    }
+
+    size_t row = 0;
+    for (auto& [chainID, atoms] : init_atoms) {
+        std::vector<Atom>& controls = screen_atoms[chainID];
+        for (size_t i = 0; i < atoms.size(); i++, row++) {
+            atoms[i].interface = flags[row] != 0;
+            if (i < controls.size()) controls[i].interface = atoms[i].interface;
+        }
+    }
+    // the selection table carries the flags as a column
+    atom_table_ready = false;
+}
+
+ContactMap& Protein::get_contact_map() {
+    if (!contacts_built) {
+        contact_map.build(get_ca_trace());
+        contacts_built = true;
+    }
+    return contact_map;
+}
+
+const SurfaceMesh* Protein::get_surface() {
+    if (!anchors_valid || !surface_ready.load(std::memory_order_acquire)) return nullptr;
+    return &surface;
+}
+
+bool Protein::get_surface_transform(float (&m)[12]) {
+    if (!anchors_valid) return false;
+    float s[4][3];
+    for (int k = 0; k < 4; k++) {
+        const auto& [chainID, idx] = surface_anchor[k];
+        auto it = screen_atoms.find(chainID);
+        if (it == screen_atoms.end() || idx >= (int)it->second.size()) return false;
+        if (morph.empty()) {
+            const Atom& atom = it->second[idx];
+            s[k][0] = atom.x; s[k][1] = atom.y; s[k][2] = atom.z;
+        } else {
+            // a morph frame moves the anchors apart from each other, so the
+            // fit would shear the mesh; the rest frame moves only with the view
+            size_t row = 0;
+            for (auto c = screen_atoms.begin(); c != it; ++c) row += c->second.size();
+            if (row + idx >= morph.size()) return false;
+            morph.point(row + idx, morph_rest, s[k]);
+        }
+    }
+    // M = [s1-s0 s2-s0 s3-s0] * anchor_inv, t = s0 - M * p0
+    for (int r = 0; r < 3; r++) {
+        float e[3] = {s[1][r] - s[0][r], s[2][r] - s[0][r], s[3][r] - s[0][r]};
+        for (int c = 0; c < 3; c++)
+            m[3*r + c] = e[0] * anchor_inv[c] + e[1] * anchor_inv[3 + c] + e[2] * anchor_inv[6 + c];
+        m[9 + r] = s[0][r] - (m[3*r] * anchor_origin[0] + m[3*r + 1] * anchor_origin[1] + m[3*r + 2] * anchor_origin[2]);
+    }
+    return true;
+}
+
+void Protein::set_show_structure(bool on) {
+    show_structure = on;
+    if (show_structure && cartoons.empty()) {
+        build_cartoons();
+    }
+}
+
 void Protein::set_rotate(int x_rotate, int y_rotate, int z_rotate){
     const float PI = 3.14159265359;
     // const float UNIT = 12;
@@ -374,6 +913,11 @@ void Protein::do_naive_rotation(float * rotate_mat) {
             atom.z  = avgx * rotate_mat[6] + avgy * rotate_mat[7]+ avgz * rotate_mat[8];
         }
     }
+    if (!morph.empty()) {
+        float m[12] = {0};
+        std::copy(rotate_mat, rotate_mat + 9, m);
+        morph.transform(m);
+    }
 }
 void Protein::do_rotation(float * rotate_mat) {
     float avgx = 0;
@@ -392,9 +936,12 @@ void Protein::do_rotation(float * rotate_mat) {
     // avgy /= num;
     // avgz /= num;
 
+    // the center is taken over the CA atoms, like the bounding box
     float minx,maxx,miny,maxy,minz,maxz;
     for (auto& [chainID, chain_atoms] : screen_atoms) {
-        for (Atom& atom : chain_atoms) {
+        size_t n = std::min(chain_atoms.size(), (size_t)get_chain_length(chainID));
+        for (size_t i = 0; i < n; i++) {
+            const Atom& atom = chain_atoms[i];
             if (num == 0) {
                 minx = atom.x;
                 maxx = atom.x;
@@ -438,6 +985,14 @@ void Protein::do_rotation(float * rotate_mat) {
             atom.z = rotate_mat[6] * (x - avgx) + rotate_mat[7] * (y - avgy) +  avgz + rotate_mat[8] * (z - avgz);
         }
     }
+    if (!morph.empty()) {
+        float m[12];
+        std::copy(rotate_mat, rotate_mat + 9, m);
+        m[9]  = avgx - (rotate_mat[0] * avgx + rotate_mat[1] * avgy + rotate_mat[2] * avgz);
+        m[10] = avgy - (rotate_mat[3] * avgx + rotate_mat[4] * avgy + rotate_mat[5] * avgz);
+        m[11] = avgz - (rotate_mat[6] * avgx + rotate_mat[7] * avgy + rotate_mat[8] * avgz);
+        morph.transform(m);
+    }
 }
 
 void Protein::do_shift(float* shift_mat) {
@@ -448,6 +1003,10 @@ void Protein::do_shift(float* shift_mat) {
             atom.z += shift_mat[2];
         }
     }
+    if (!morph.empty()) {
+        float m[12] = {1, 0, 0, 0, 1, 0, 0, 0, 1, shift_mat[0], shift_mat[1], shift_mat[2]};
+        morph.transform(m);
+    }
 }
 
 
@@ -459,4 +1018,20 @@ void Protein::do_scale(float scale) {
             atom.z *= scale;
         }
     }
+    if (!morph.empty()) {
+        float m[12] = {scale, 0, 0, 0, scale, 0, 0, 0, scale, 0, 0, 0};
+        morph.transform(m);
+    }
+}
+
+void Protein::do_affine(const float (&m)[12]) {
+    for (auto& [chainID, chain_atoms] : screen_atoms) {
+        for (Atom& atom : chain_atoms) {
+            float x = atom.x, y = atom.y, z = atom.z;
+            atom.x = m[0] * x + m[1] * y + m[2] * z + m[9];
+            atom.y = m[3] * x + m[4] * y + m[5] * z + m[10];
+            atom.z = m[6] * x + m[7] * y + m[8] * z + m[11];
+        }
+    }
+    if (!morph.empty()) morph.transform(m);
 }
\ No newline at end of file
@@ -9,6 +9,8 @@
 #include <cmath>
 #include <limits>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include <gemmi/mmread.hpp>
 #include <gemmi/model.hpp>
@@ -17,6 +19,15 @@
 #include "Atom.hpp"
 #include "StructureMaker.hpp"
 #include "SSPredictor.hpp"
+#include "Superposer.hpp"
+#include "SurfaceBuilder.hpp"
+#include "ContactMap.hpp"
+#include "Selection.hpp"
+#include "FullAtoms.hpp"
+#include "Morph.hpp"
+#include "NormalModes.hpp"
+#include "Sasa.hpp"
+#include "Interface.hpp"
 
 struct BoundingBox {
     float min_x = std::numeric_limits<float>::max();
@@ -53,7 +64,12 @@ public:
     ~Protein();
 
     std::map<std::string, std::vector<Atom>>& get_atoms();
-    std::map<std::string, int> get_residue_count();
+    // the cartoon's points, or with it off get_atoms() itself, whose chains
+    // hold the trace in their first get_chain_length() points
+    std::map<std::string, std::vector<Atom>>& get_render_atoms(float px_per_unit);
+    // untransformed CA positions with residue numbers and sequence, chain order as get_atoms()
+    CATrace get_ca_trace();
+    const std::map<std::string, int>& get_residue_count();
     std::map<std::string, int> get_chain_length();
     int get_chain_length(std::string chainID);
     int get_length();
@@ -63,37 +79,95 @@ public:
     float get_scaled_max_z();
     BoundingBox& get_bounding_box();
     void set_scale(float scale_);
-    std::string get_file_name() { return in_file; }
-    std::string get_title() { return protein_title; }
-    std::string get_pdb_id() { return pdb_id; }
+    const std::string& get_file_name() { return in_file; }
+    const std::string& get_title() { return protein_title; }
+    const std::string& get_pdb_id() { return pdb_id; }
+    bool get_show_structure() { return show_structure; }
+    void set_show_structure(bool on);
 
     void load_data(float * vectorpointers, bool yesUT);
+
+    // molecular surface in the Angstrom frame, built in the background after
+    // load_data; nullptr until it is ready
+    const SurfaceMesh* get_surface();
+    // current map from the Angstrom frame onto screen_atoms, x' = m[0..8] * x + m[9..11];
+    // places the surface mesh and the full atoms
+    bool get_surface_transform(float (&m)[12]);
+    // heavy atoms in the Angstrom frame, bonds built on first use
+    const FullAtoms& get_full_atoms();
+    // relative SASA per residue into Atom::exposure: the first call starts it
+    // in the background and marks every residue pending (negative), a call
+    // after it finished fills it in. Kept until the structure is reloaded.
+    void compute_exposure();
+    // residues near another chain into Atom::interface, computed on the
+    // first call and kept until the structure is reloaded
+    void compute_interface();
+    // CA contacts, built on first use and kept for the life of the structure
+    ContactMap& get_contact_map();
+    // per-residue columns for the selection engine, rows in get_atoms() order
+    const AtomTable& get_atom_table();
+    // returns the number of residues the command selected
+    size_t apply_selection(const SelectionCommand& command);
     
+    // Pair residues with `other`, which must currently sit in the same frame,
+    // and morph the trace and cartoon toward its conformation. Unpaired
+    // residues follow their paired neighbours. false without a correspondence.
+    bool set_morph_target(Protein& other);
+    // move the control points to fraction t of the way to the target
+    void set_morph_frame(float t);
+    bool is_morphing() const { return !morph.empty(); }
+    // back to the rest frame of the morph, then drop it
+    void stop_morph();
+
+    // lowest elastic network modes of the CA trace, computed in the background
+    // after the first request; nullptr until they are ready
+    void request_modes(int n_modes);
+    const NormalModes* get_modes();
+    // swing the trace and cartoon along mode m, passing the rest pose at t = 0.5
+    bool animate_mode(int m);
+
     void set_rotate(int x_rotate, int y_rotate, int z_rotate);
     void set_shift(float shift_x, float shift_y, float shift_z);
     void do_naive_rotation(float* rotate_mat);
     void do_rotation(float* rotate_mat);
     void do_shift(float* shift_mat);
     void do_scale(float sclae);
+    // x' = m[0..8] * x + m[9..11]
+    void do_affine(const float (&m)[12]);
     float cx, cy, cz, scale;
 
 private:
-    void count_seqres(const std::string& file);
-    bool is_ss_in_file(const std::string& in_file);
-    void load_ss_info(const std::string& in_file, 
+    void count_seqres(const gemmi::Structure& st);
+    void load_ss_info(const gemmi::Structure& st,
                       const std::string& target_chains,
                       std::vector<std::tuple<std::string, int, std::string, int, char>>& ss_info);
-    void load_init_atoms(const std::string& in_file, 
-                             const std::string& target_chains,
-                             const std::vector<std::tuple<std::string, int, std::string, int, char>>& ss_info, float * vectorpointers, bool yesUT);
-    void load_init_atoms(const std::string& in_file, 
-                             const std::string& target_chains, float * vectorpointers, bool yesUT);
+    void load_init_atoms(gemmi::Structure& st,
+                         const std::string& target_chains,
+                         const std::vector<std::tuple<std::string, int, std::string, int, char>>& ss_info);
+    void add_full_atoms(const gemmi::Residue& res, uint16_t chain_row, int residue);
+    // secondary structure from the file, or predicted once where it has none
+    void ensure_ss();
+    void build_cartoons();
+    void compute_occlusion();
+    void start_surface_build();
+    void stop_surface_build();
+    void stop_modes();
+    void stop_exposure();
+    // per residue in get_atoms() order, into the trace and its loaded copy
+    void set_exposure(const std::vector<float>& rel);
+    // morph from control points + start_disp to + end_disp, xyz per trace
+    // residue in screen_atoms order; the cartoon is rebuilt at both ends
+    bool set_morph_path(const std::vector<float>& start_disp, const std::vector<float>& end_disp, float rest);
     
     void pred_ss_info(std::map<std::string, std::vector<Atom>>& init_atoms);
 
     std::map<std::string, std::vector<Atom>> init_atoms;
+    std::map<std::string, std::vector<int>> residue_numbers;
+    std::map<std::string, std::string> sequences;
     std::map<std::string, std::vector<Atom>> screen_atoms;
-    
+    std::map<std::string, std::vector<Atom>> render_atoms;
+    std::map<std::string, Cartoon> cartoons;
+
     std::map<std::string, int> chain_res_count;
 
     std::string in_file;
@@ -101,10 +175,48 @@ private:
     std::string protein_title;
     std::string pdb_id;
     bool show_structure, predict_structure;
+    bool ss_assigned = false;
 
     BoundingBox bounding_box;
 
     StructureMaker structureMaker;
     SSPredictor ssPredictor;
+
+    SurfaceBuilder surfaceBuilder;
+    SurfaceMesh surface;
+    std::thread surface_thread;
+    std::atomic<bool> surface_ready{false};
+    std::atomic<bool> surface_cancel{false};
+    // four spread-out CA atoms pin the mesh to screen_atoms, which only ever
+    // see affine transforms; during a morph they are read at its rest frame,
+    // which follows the view while the trace itself bends
+    std::pair<std::string, int> surface_anchor[4];
+    float anchor_origin[3];
+    float anchor_inv[9];
+    bool anchors_valid = false;
+
+    // start and end of every control point, in screen_atoms order
+    Morph morph;
+    float morph_rest = 0.0f;        // frame that matches the loaded structure
+
+    NormalModes modes;
+    std::thread modes_thread;
+    std::atomic<bool> modes_ready{false};
+    std::atomic<bool> modes_cancel{false};
+
+    FullAtoms full_atoms;
+    bool full_bonds_built = false;
+
+    std::vector<float> exposure;        // per residue in get_atoms() order, from exposure_thread
+    std::thread exposure_thread;
+    std::atomic<bool> exposure_done{false};
+    bool exposure_ready = false;        // copied into the atoms
+    bool interface_ready = false;
+
+    ContactMap contact_map;
+    bool contacts_built = false;
+
+    AtomTable atom_table;
+    bool atom_table_ready = false;
 };
 
@@ -1,4 +1,6 @@
 #include "SSPredictor.hpp"
+#include "simd.h"
+#include "Parallel.hpp"
 #include <algorithm>
 
 std::vector<char> SSPredictor::compute_breaks(const std::vector<Atom>& A) {
@@ -13,37 +15,110 @@ std::vector<char> SSPredictor::compute_breaks(const std::vector<Atom>& A) {
     return br;
 }
 
+std::vector<int> SSPredictor::break_prefix(const std::vector<char>& is_break) {
+    std::vector<int> prefix(is_break.size() + 1, 0);
+    for (size_t k = 0; k < is_break.size(); ++k) {
+        prefix[k+1] = prefix[k] + (is_break[k] ? 1 : 0);
+    }
+    return prefix;
+}
+
+void SSPredictor::compute_features(const std::vector<float>& X, const std::vector<float>& Y, const std::vector<float>& Z,
+                                   std::vector<float>& d13, std::vector<float>& d14,
+                                   std::vector<float>& tx, std::vector<float>& ty)
+{
+    const size_t m = X.size() - 3;   // windows i .. i+3
+    d13.resize(m); d14.resize(m); tx.resize(m); ty.resize(m);
+
+    // operations mirror dist()/torsion_xy() one-to-one so lanes round exactly like the scalar path
+    const simd_float vscale = simdf32_set(scale);
+    const simd_float veps = simdf32_set(1e-8f);
+    size_t i = 0;
+    for (; i + VECSIZE_FLOAT <= m; i += VECSIZE_FLOAT) {
+        simd_float ax = simdf32_loadu(&X[i]),   ay = simdf32_loadu(&Y[i]),   az = simdf32_loadu(&Z[i]);
+        simd_float bx = simdf32_loadu(&X[i+1]), by = simdf32_loadu(&Y[i+1]), bz = simdf32_loadu(&Z[i+1]);
+        simd_float cx = simdf32_loadu(&X[i+2]), cy = simdf32_loadu(&Y[i+2]), cz = simdf32_loadu(&Z[i+2]);
+        simd_float dx = simdf32_loadu(&X[i+3]), dy = simdf32_loadu(&Y[i+3]), dz = simdf32_loadu(&Z[i+3]);
+
+        simd_float ex = simdf32_sub(ax, cx), ey = simdf32_sub(ay, cy), ez = simdf32_sub(az, cz);
+        simd_float s13 = simdf32_add(simdf32_add(simdf32_mul(ex, ex), simdf32_mul(ey, ey)), simdf32_mul(ez, ez));
+        simdf32_storeu(&d13[i], simdf32_mul(simdf32_sqrt(s13), vscale));
+
+        ex = simdf32_sub(ax, dx); ey = simdf32_sub(ay, dy); ez = simdf32_sub(az, dz);
+        simd_float s14 = simdf32_add(simdf32_add(simdf32_mul(ex, ex), simdf32_mul(ey, ey)), simdf32_mul(ez, ez));
+        simdf32_storeu(&d14[i], simdf32_mul(simdf32_sqrt(s14), vscale));
+
+        simd_float b1x = simdf32_sub(bx, ax), b1y = simdf32_sub(by, ay), b1z = simdf32_sub(bz, az);
+        simd_float b2x = simdf32_sub(cx, bx), b2y = simdf32_sub(cy, by), b2z = simdf32_sub(cz, bz);
+        simd_float b3x = simdf32_sub(dx, cx), b3y = simdf32_sub(dy, cy), b3z = simdf32_sub(dz, cz);
+
+        simd_float n1x = simdf32_sub(simdf32_mul(b1y, b2z), simdf32_mul(b1z, b2y));
+        simd_float n1y = simdf32_sub(simdf32_mul(b1z, b2x), simdf32_mul(b1x, b2z));
+        simd_float n1z = simdf32_sub(simdf32_mul(b1x, b2y), simdf32_mul(b1y, b2x));
+        simd_float n2x = simdf32_sub(simdf32_mul(b2y, b3z), simdf32_mul(b2z, b3y));
+        simd_float n2y = simdf32_sub(simdf32_mul(b2z, b3x), simdf32_mul(b2x, b3z));
+        simd_float n2z = simdf32_sub(simdf32_mul(b2x, b3y), simdf32_mul(b2y, b3x));
+
+        simd_float nn = simdf32_sqrt(simdf32_add(simdf32_add(simdf32_mul(b2x, b2x), simdf32_mul(b2y, b2y)), simdf32_mul(b2z, b2z)));
+        simd_float keep = simdf32_gt(nn, veps);
+        b2x = simdf32_or(simdf32_and(keep, simdf32_div(b2x, nn)), simdf32_andnot(keep, b2x));
+        b2y = simdf32_or(simdf32_and(keep, simdf32_div(b2y, nn)), simdf32_andnot(keep, b2y));
+        b2z = simdf32_or(simdf32_and(keep, simdf32_div(b2z, nn)), simdf32_andnot(keep, b2z));
+
+        simd_float m1x = simdf32_sub(simdf32_mul(n1y, b2z), simdf32_mul(n1z, b2y));
+        simd_float m1y = simdf32_sub(simdf32_mul(n1z, b2x), simdf32_mul(n1x, b2z));
+        simd_float m1z = simdf32_sub(simdf32_mul(n1x, b2y), simdf32_mul(n1y, b2x));
+
+        simdf32_storeu(&tx[i], simdf32_add(simdf32_add(simdf32_mul(n1x, n2x), simdf32_mul(n1y, n2y)), simdf32_mul(n1z, n2z)));
+        simdf32_storeu(&ty[i], simdf32_add(simdf32_add(simdf32_mul(m1x, n2x), simdf32_mul(m1y, n2y)), simdf32_mul(m1z, n2z)));
+    }
+
+    // tail
+    for (; i < m; ++i) {
+        float p[4][3];
+        for (int k = 0; k < 4; ++k) { p[k][0] = X[i+k]; p[k][1] = Y[i+k]; p[k][2] = Z[i+k]; }
+        float ex = p[0][0] - p[2][0], ey = p[0][1] - p[2][1], ez = p[0][2] - p[2][2];
+        d13[i] = std::sqrt(ex*ex + ey*ey + ez*ez) * scale;
+        ex = p[0][0] - p[3][0]; ey = p[0][1] - p[3][1]; ez = p[0][2] - p[3][2];
+        d14[i] = std::sqrt(ex*ex + ey*ey + ez*ez) * scale;
+        torsion_xy(p[0], p[1], p[2], p[3], tx[i], ty[i]);
+    }
+}
+
 void SSPredictor::vote(const std::vector<Atom>& A,
-                       const std::vector<char>& is_break,
+                       const std::vector<int>& brk_prefix,
                        std::vector<int>& h_score,
                        std::vector<int>& e_score)
 {
     const size_t n = A.size();
     if (n < 4) return;
 
-    auto same_segment = [&](size_t i, size_t j) -> bool {
-        if (i > j) std::swap(i, j);
-        for (size_t k = i; k < j; ++k) if (is_break[k]) return false;
-        return true;
-    };
+    std::vector<float> X(n), Y(n), Z(n);
+    for (size_t k = 0; k < n; ++k) { X[k] = A[k].x; Y[k] = A[k].y; Z[k] = A[k].z; }
+
+    std::vector<float> d13v, d14v, txv, tyv;
+    compute_features(X, Y, Z, d13v, d14v, txv, tyv);
 
     for (size_t i = 0; i + 3 < n; ++i) {
-        if (!same_segment(i, i+3)) continue;
+        if (brk_prefix[i+3] != brk_prefix[i]) continue;
 
-        float d13 = dist(A[i], A[i+2]) * scale;
-        float d14 = dist(A[i], A[i+3]) * scale;
-        float tau = torsion_deg(A[i], A[i+1], A[i+2], A[i+3]);
-        float at = std::fabs(tau);
+        float d13 = d13v[i];
+        float d14 = d14v[i];
 
         int h = 0, e = 0;
 
         if (d13 >= d13_helix_min && d13 <= d13_helix_max) h++;
         if (d14 >= d14_helix_min && d14 <= d14_helix_max) h++;
-        if (at >= tors_helix_abs_min && at <= tors_helix_abs_max) h++;
 
         if (d13 >= d13_beta_min) e++;
         if (d14 >= d14_beta_min) e++;
-        if (at >= tors_beta_abs_min) e++;
+
+        // the torsion vote only matters when the distances split 1:1
+        if (h == 1 || e == 1) {
+            float at = std::fabs(torsion_deg(txv[i], tyv[i]));
+            if (at >= tors_helix_abs_min && at <= tors_helix_abs_max) h++;
+            if (at >= tors_beta_abs_min) e++;
+        }
 
         if (h >= 2) {
             h_score[i+1] += 1;
@@ -85,7 +160,7 @@ void SSPredictor::squash_short_segments(std::vector<char>& lab, char target, int
     }
 }
 
-void SSPredictor::smooth_labels(const std::vector<char>& is_break,
+void SSPredictor::smooth_labels(const std::vector<int>& brk_prefix,
                                 std::vector<char>& lab)
 {
     const size_t n = lab.size();
@@ -93,8 +168,7 @@ void SSPredictor::smooth_labels(const std::vector<char>& is_break,
 
     auto not_across_break = [&](size_t a, size_t b) {
         if (a > b) std::swap(a, b);
-        for (size_t k = a; k < b; ++k) if (is_break[k]) return false;
-        return true;
+        return brk_prefix[b] == brk_prefix[a];
     };
 
     // remove island (size <=smooth_island)
@@ -131,15 +205,15 @@ void SSPredictor::run_chain(std::vector<Atom>& chain_atoms) {
     if (n == 0) return;
 
     // break position
-    std::vector<char> is_break = compute_breaks(chain_atoms);
+    std::vector<int> brk_prefix = break_prefix(compute_breaks(chain_atoms));
 
     // vote
     std::vector<int> h_score(n, 0), e_score(n, 0);
-    vote(chain_atoms, is_break, h_score, e_score);
+    vote(chain_atoms, brk_prefix, h_score, e_score);
 
     // label -> smoothing
     std::vector<char> lab = label_from_scores(h_score, e_score);
-    smooth_labels(is_break, lab);
+    smooth_labels(brk_prefix, lab);
 
     // result
     for (size_t i = 0; i < n; ++i) {
@@ -149,8 +223,10 @@ void SSPredictor::run_chain(std::vector<Atom>& chain_atoms) {
 
 void SSPredictor::run(std::map<std::string, std::vector<Atom>>& atoms) {
     std:: cout << "  predict secondary structure\n";    
-    for (auto& chain : atoms) {
-        auto& chain_atoms = chain.second;
-        run_chain(chain_atoms);
-    }
+    std::vector<std::vector<Atom>*> chains;
+    chains.reserve(atoms.size());
+    for (auto& chain : atoms) chains.push_back(&chain.second);
+
+    // chains vary a lot in length, parallel_for hands them out one at a time
+    parallel_for(chains.size(), [&](size_t c) { run_chain(*chains[c]); });
 }
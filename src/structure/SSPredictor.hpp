@@ -26,6 +26,7 @@ public:
 
     int   smooth_island = 1;
 
+    // chains are independent and predicted in parallel
     void run(std::map<std::string, std::vector<Atom>>& atoms);
 
     void run_chain(std::vector<Atom>& chain_atoms);
@@ -57,9 +58,12 @@ private:
         if (n > 1e-8f) { v[0]/=n; v[1]/=n; v[2]/=n; }
     }
 
-    static float torsion_deg(const Atom& a, const Atom& b, const Atom& c, const Atom& d) {
-        float b1[3], b2[3], b3[3];
-        sub(b, a, b1); sub(c, b, b2); sub(d, c, b3);
+    // dihedral a-b-c-d as atan2(y, x) components; same arithmetic as the SIMD kernel
+    static inline void torsion_xy(const float a[3], const float b[3], const float c[3], const float d[3],
+                                  float& x, float& y) {
+        float b1[3] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] };
+        float b2[3] = { c[0]-b[0], c[1]-b[1], c[2]-b[2] };
+        float b3[3] = { d[0]-c[0], d[1]-c[1], d[2]-c[2] };
 
         float n1[3], n2[3];
         cross(b1, b2, n1);
@@ -71,19 +75,28 @@ private:
         float m1[3];
         cross(n1, b2n, m1);
 
-        float x = dot(n1, n2);
-        float y = dot(m1, n2);
+        x = dot(n1, n2);
+        y = dot(m1, n2);
+    }
 
-        float angle = std::atan2(y, x) * 180.0f / 3.14159265358979323846f;
-        return angle;
+    static inline float torsion_deg(float x, float y) {
+        return std::atan2(y, x) * 180.0f / 3.14159265358979323846f;
     }
 
+    // per-window features over SoA coordinates: d13, d14 and torsion components
+    void compute_features(const std::vector<float>& X, const std::vector<float>& Y, const std::vector<float>& Z,
+                          std::vector<float>& d13, std::vector<float>& d14,
+                          std::vector<float>& tx, std::vector<float>& ty);
+
     // break mask: if nearest residue is far, break. true
     std::vector<char> compute_breaks(const std::vector<Atom>& A);
 
+    // prefix[k] = number of breaks in [0, k); [i, j) is unbroken iff prefix[j] == prefix[i]
+    static std::vector<int> break_prefix(const std::vector<char>& is_break);
+
     // vote based on the distance/torsion
     void vote(const std::vector<Atom>& A,
-              const std::vector<char>& is_break,
+              const std::vector<int>& brk_prefix,
               std::vector<int>& h_score,
               std::vector<int>& e_score);
 
@@ -92,7 +105,7 @@ private:
                                         const std::vector<int>& e_score);
 
     // smoothing (remove island, min len filter)
-    void smooth_labels(const std::vector<char>& is_break,
+    void smooth_labels(const std::vector<int>& brk_prefix,
                        std::vector<char>& lab);
 
     // sequenctial region length check
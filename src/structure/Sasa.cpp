@@ -0,0 +1,105 @@
+#include "Sasa.hpp"
+#include "CellList.hpp"
+#include "Parallel.hpp"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+float SasaCalculator::vdw_radius(char element) {
+    switch (element) {
+        case 'C': return 1.70f;
+        case 'N': return 1.55f;
+        case 'O': return 1.52f;
+        case 'S': return 1.80f;
+        case 'P': return 1.80f;
+        default:  return 1.80f;
+    }
+}
+
+float SasaCalculator::max_residue_area(char aa) {
+    // Tien et al. 2013, theoretical
+    switch (aa) {
+        case 'A': return 129.0f; case 'R': return 274.0f; case 'N': return 195.0f;
+        case 'D': return 193.0f; case 'C': return 167.0f; case 'E': return 223.0f;
+        case 'Q': return 225.0f; case 'G': return 104.0f; case 'H': return 224.0f;
+        case 'I': return 197.0f; case 'L': return 201.0f; case 'K': return 236.0f;
+        case 'M': return 224.0f; case 'F': return 240.0f; case 'P': return 159.0f;
+        case 'S': return 155.0f; case 'T': return 172.0f; case 'W': return 285.0f;
+        case 'Y': return 263.0f; case 'V': return 174.0f;
+        default:  return 200.0f;
+    }
+}
+
+std::vector<float> SasaCalculator::compute(const std::vector<float>& x, const std::vector<float>& y,
+                                           const std::vector<float>& z, const std::vector<float>& radius) const {
+    const size_t n = x.size();
+    std::vector<float> area(n, 0.0f);
+    if (n == 0) return area;
+
+    // Fibonacci sphere, a whole number of vectors so no lane is padding
+    const int np = (std::max(n_points, (int)VECSIZE_FLOAT) + VECSIZE_FLOAT - 1) / VECSIZE_FLOAT * VECSIZE_FLOAT;
+    std::vector<float> ux(np), uy(np), uz(np);
+    const float golden = 2.39996323f;
+    for (int k = 0; k < np; k++) {
+        float h = 1.0f - (2.0f * k + 1.0f) / np;
+        float r = std::sqrt(1.0f - h * h);
+        ux[k] = r * std::cos(golden * k); uy[k] = r * std::sin(golden * k); uz[k] = h;
+    }
+
+    std::vector<float> R(n);
+    float max_r = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        R[i] = radius[i] + probe_radius;
+        max_r = std::max(max_r, R[i]);
+    }
+    CellList grid;
+    grid.build(x.data(), y.data(), z.data(), n, 2.0f * max_r);
+
+    const size_t block = 256;
+    parallel_for((n + block - 1) / block, [&](size_t b) {
+        struct Neighbour { float d2, dx, dy, dz, r2; };
+        std::vector<Neighbour> near;
+        float lanes[VECSIZE_FLOAT];
+        for (size_t i = b * block; i < std::min(n, (b + 1) * block); i++) {
+            // neighbours whose sphere reaches this one, nearest first so a
+            // buried point is settled early
+            near.clear();
+            grid.for_near(x[i], y[i], z[i], [&](int j) {
+                if (j == (int)i) return;
+                float dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+                float d2 = dx * dx + dy * dy + dz * dz;
+                float reach = R[i] + R[j];
+                if (d2 < reach * reach) near.push_back({d2, dx, dy, dz, R[j] * R[j]});
+            });
+            std::sort(near.begin(), near.end(), [](const Neighbour& a, const Neighbour& c) { return a.d2 < c.d2; });
+
+            // min over neighbours of |p - c_j|^2 - R_j^2, the point is open while it stays >= 0
+            int open = 0;
+            simd_float ri = simdf32_set(R[i]);
+            for (int k = 0; k < np; k += VECSIZE_FLOAT) {
+                simd_float px = simdf32_mul(ri, simdf32_loadu(&ux[k]));
+                simd_float py = simdf32_mul(ri, simdf32_loadu(&uy[k]));
+                simd_float pz = simdf32_mul(ri, simdf32_loadu(&uz[k]));
+                simd_float clearance = simdf32_set(1.0f);
+                bool buried = false;
+                for (size_t s = 0; s < near.size() && !buried; s++) {
+                    simd_float ex = simdf32_sub(px, simdf32_set(near[s].dx));
+                    simd_float ey = simdf32_sub(py, simdf32_set(near[s].dy));
+                    simd_float ez = simdf32_sub(pz, simdf32_set(near[s].dz));
+                    simd_float d = simdf32_add(simdf32_add(simdf32_mul(ex, ex), simdf32_mul(ey, ey)), simdf32_mul(ez, ez));
+                    clearance = simdf32_min(clearance, simdf32_sub(d, simdf32_set(near[s].r2)));
+                    if (s % 8 == 7) {
+                        simdf32_storeu(lanes, clearance);
+                        buried = std::all_of(lanes, lanes + VECSIZE_FLOAT, [](float c) { return c < 0.0f; });
+                    }
+                }
+                if (buried) continue;
+                simdf32_storeu(lanes, clearance);
+                for (int l = 0; l < (int)VECSIZE_FLOAT; l++) open += lanes[l] >= 0.0f;
+            }
+            area[i] = 4.0f * (float)M_PI * R[i] * R[i] * open / np;
+        }
+    });
+    return area;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Shrake-Rupley solvent accessible surface area: every atom's sphere (van der
+// Waals radius + probe) is sampled with one fixed point set, and a point is
+// accessible when no neighbouring sphere covers it. Neighbours come from a
+// cell list; the points of one atom are tested a SIMD vector at a time.
+class SasaCalculator {
+public:
+    // accessible area per atom in A^2
+    std::vector<float> compute(const std::vector<float>& x, const std::vector<float>& y,
+                               const std::vector<float>& z, const std::vector<float>& radius) const;
+
+    // van der Waals radius for the element codes of FullAtoms
+    static float vdw_radius(char element);
+    // area of residue aa fully exposed in a Gly-X-Gly peptide, for relative SASA
+    static float max_residue_area(char aa);
+
+    float probe_radius = 1.4f;
+    int n_points = 96;              // per atom, rounded up to whole SIMD vectors
+};
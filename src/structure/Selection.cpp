@@ -0,0 +1,319 @@
+#include "Selection.hpp"
+#include "CellList.hpp"
+#include "Parallel.hpp"
+#include "Superposer.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <sstream>
+#include <stdexcept>
+
+// --- Bitset ---
+
+Bitset::Bitset(size_t n_, bool value) : n(n_), w((n_ + 63) / 64, value ? ~uint64_t(0) : 0) {
+    trim();
+}
+
+size_t Bitset::count() const {
+    size_t c = 0;
+    for (uint64_t word : w) c += std::bitset<64>(word).count();
+    return c;
+}
+
+Bitset& Bitset::operator&=(const Bitset& o) {
+    for (size_t k = 0; k < w.size(); k++) w[k] &= o.w[k];
+    return *this;
+}
+
+Bitset& Bitset::operator|=(const Bitset& o) {
+    for (size_t k = 0; k < w.size(); k++) w[k] |= o.w[k];
+    return *this;
+}
+
+void Bitset::flip() {
+    for (uint64_t& word : w) word = ~word;
+    trim();
+}
+
+void Bitset::trim() {
+    if (n % 64 && !w.empty()) w.back() &= (uint64_t(1) << (n % 64)) - 1;
+}
+
+// --- Parsing ---
+
+static std::string lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+static std::vector<std::string> split_list(const std::string& s) {
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty()) out.push_back(item);
+    return out;
+}
+
+static bool is_keyword(const std::string& t) {
+    static const char* words[] = {"and", "or", "not", "within", "of", "all", "none",
+                                  "chain", "resi", "resn", "ss", "interface", "(", ")"};
+    std::string l = lower(t);
+    for (const char* w : words) if (l == w) return true;
+    return false;
+}
+
+Selection::Selection(const std::string& expr) : text(expr) {
+    std::string cur;
+    for (char c : expr) {
+        if (std::isspace((unsigned char)c) || c == '(' || c == ')') {
+            if (!cur.empty()) tokens.push_back(cur);
+            cur.clear();
+            if (c == '(' || c == ')') tokens.push_back(std::string(1, c));
+        } else {
+            cur += c;
+        }
+    }
+    if (!cur.empty()) tokens.push_back(cur);
+    if (tokens.empty()) throw std::runtime_error("empty selection");
+
+    parse_or();
+    if (pos < tokens.size()) throw std::runtime_error("unexpected '" + tokens[pos] + "'");
+    tokens.clear();
+}
+
+const std::string& Selection::peek() const {
+    static const std::string end;
+    return pos < tokens.size() ? tokens[pos] : end;
+}
+
+std::string Selection::next() {
+    if (pos >= tokens.size()) throw std::runtime_error("selection ends too early");
+    return tokens[pos++];
+}
+
+void Selection::parse_or() {
+    parse_and();
+    while (lower(peek()) == "or") {
+        next();
+        parse_and();
+        program.push_back({Op::OR});
+    }
+}
+
+void Selection::parse_and() {
+    parse_unary();
+    while (lower(peek()) == "and") {
+        next();
+        parse_unary();
+        program.push_back({Op::AND});
+    }
+}
+
+void Selection::parse_unary() {
+    std::string t = lower(peek());
+    if (t == "not") {
+        next();
+        parse_unary();
+        program.push_back({Op::NOT});
+    } else if (t == "within") {
+        next();
+        std::string r = next();
+        Instr in{Op::WITHIN};
+        try { in.radius = std::stof(r); } catch (...) { throw std::runtime_error("bad distance '" + r + "'"); }
+        if (lower(next()) != "of") throw std::runtime_error("expected 'of' after within " + r);
+        parse_unary();
+        program.push_back(in);
+    } else {
+        parse_primary();
+    }
+}
+
+void Selection::parse_primary() {
+    std::string tok = next();
+    std::string t = lower(tok);
+    if (t == "(") {
+        parse_or();
+        if (next() != ")") throw std::runtime_error("missing ')'");
+        return;
+    }
+    if (t == "all") { program.push_back({Op::ALL}); return; }
+    if (t == "none") { program.push_back({Op::NONE}); return; }
+    if (t == "interface") { program.push_back({Op::INTERFACE}); return; }
+
+    if (t != "chain" && t != "resi" && t != "resn" && t != "ss")
+        throw std::runtime_error("unknown selector '" + tok + "'");
+    std::string arg = next();
+    if (is_keyword(arg)) throw std::runtime_error("missing value after '" + tok + "'");
+    std::vector<std::string> items = split_list(arg);
+
+    Instr in{Op::ALL};
+    if (t == "chain") {
+        in.op = Op::CHAIN;
+        in.names = items;
+    } else if (t == "resi") {
+        in.op = Op::RESI;
+        for (const std::string& item : items) {
+            // a-b, where either bound may be negative
+            size_t dash = item.find('-', 1);
+            try {
+                int lo = std::stoi(item.substr(0, dash));
+                int hi = (dash == std::string::npos) ? lo : std::stoi(item.substr(dash + 1));
+                in.ranges.push_back({std::min(lo, hi), std::max(lo, hi)});
+            } catch (...) {
+                throw std::runtime_error("bad residue range '" + item + "'");
+            }
+        }
+    } else if (t == "resn") {
+        in.op = Op::RESN;
+        for (std::string item : items) {
+            std::transform(item.begin(), item.end(), item.begin(), ::toupper);
+            char code = (item.size() == 1) ? item[0] : Superposer::one_letter(item);
+            if (code == 'X' && item != "X") throw std::runtime_error("unknown residue '" + item + "'");
+            in.codes.push_back(code);
+        }
+    } else {
+        in.op = Op::SS;
+        for (const std::string& item : items) {
+            std::string l = lower(item);
+            if (l == "helix" || l == "h") in.codes.push_back('H');
+            else if (l == "sheet" || l == "strand" || l == "s") in.codes.push_back('S');
+            else if (l == "coil" || l == "loop" || l == "x") in.codes.push_back('x');
+            else throw std::runtime_error("unknown secondary structure '" + item + "'");
+        }
+    }
+    program.push_back(in);
+}
+
+// --- Evaluation ---
+
+// Fill a bitset from a per-atom predicate, whole words per task so threads
+// never share one.
+template <typename F>
+static Bitset scan(size_t n, F&& pred) {
+    Bitset out(n);
+    std::vector<uint64_t>& w = out.words();
+    const size_t words_per_task = 1024;
+    parallel_for((w.size() + words_per_task - 1) / words_per_task, [&](size_t t) {
+        size_t w_end = std::min(w.size(), (t + 1) * words_per_task);
+        for (size_t k = t * words_per_task; k < w_end; k++) {
+            uint64_t word = 0;
+            size_t base = k * 64, end = std::min(n, base + 64);
+            for (size_t i = base; i < end; i++)
+                if (pred(i)) word |= uint64_t(1) << (i - base);
+            w[k] = word;
+        }
+    });
+    return out;
+}
+
+Bitset Selection::evaluate(const AtomTable& table) const {
+    const size_t n = table.size();
+    std::vector<Bitset> stack;
+
+    for (const Instr& in : program) {
+        switch (in.op) {
+            case Op::ALL:  stack.emplace_back(n, true); break;
+            case Op::NONE: stack.emplace_back(n, false); break;
+            case Op::CHAIN: {
+                std::vector<char> match(table.chain_names.size(), 0);
+                for (size_t c = 0; c < table.chain_names.size(); c++)
+                    match[c] = std::find(in.names.begin(), in.names.end(), table.chain_names[c]) != in.names.end();
+                stack.push_back(scan(n, [&](size_t i) { return match[table.chain[i]] != 0; }));
+                break;
+            }
+            case Op::RESI:
+                stack.push_back(scan(n, [&](size_t i) {
+                    int r = table.resnum[i];
+                    for (const auto& [lo, hi] : in.ranges) if (r >= lo && r <= hi) return true;
+                    return false;
+                }));
+                break;
+            case Op::RESN:
+                stack.push_back(scan(n, [&](size_t i) {
+                    return std::find(in.codes.begin(), in.codes.end(), table.aa[i]) != in.codes.end();
+                }));
+                break;
+            case Op::SS:
+                stack.push_back(scan(n, [&](size_t i) {
+                    return std::find(in.codes.begin(), in.codes.end(), table.ss[i]) != in.codes.end();
+                }));
+                break;
+            case Op::INTERFACE:
+                stack.push_back(scan(n, [&](size_t i) { return i < table.interface.size() && table.interface[i]; }));
+                break;
+            case Op::NOT:
+                stack.back().flip();
+                break;
+            case Op::AND: case Op::OR: {
+                Bitset rhs = std::move(stack.back());
+                stack.pop_back();
+                if (in.op == Op::AND) stack.back() &= rhs;
+                else stack.back() |= rhs;
+                break;
+            }
+            case Op::WITHIN: {
+                const Bitset& inner = stack.back();
+                std::vector<float> sx, sy, sz;
+                for (size_t i = 0; i < n; i++)
+                    if (inner.test(i)) { sx.push_back(table.x[i]); sy.push_back(table.y[i]); sz.push_back(table.z[i]); }
+
+                CellList grid;
+                // cells no smaller than the radius keep the 27-cell lookup exact;
+                // a floor keeps a tiny radius from making billions of cells
+                grid.build(sx.data(), sy.data(), sz.data(), sx.size(), std::max(in.radius, 4.0f));
+                const float r2 = in.radius * in.radius;
+                Bitset near = scan(n, [&](size_t i) {
+                    if (inner.test(i)) return true;
+                    return grid.any_near(table.x[i], table.y[i], table.z[i], [&](int j) {
+                        float dx = sx[j] - table.x[i], dy = sy[j] - table.y[i], dz = sz[j] - table.z[i];
+                        return dx * dx + dy * dy + dz * dz <= r2;
+                    });
+                });
+                stack.back() = std::move(near);
+                break;
+            }
+        }
+    }
+    return stack.empty() ? Bitset(n) : std::move(stack.back());
+}
+
+// --- Commands ---
+
+static int parse_color(const std::string& s) {
+    static const std::pair<const char*, int> named[] = {
+        {"red", 0xE04040}, {"green", 0x40C060}, {"blue", 0x4080E0}, {"yellow", 0xE0D040},
+        {"orange", 0xF09030}, {"purple", 0xA060D0}, {"cyan", 0x40C8D8}, {"magenta", 0xD050B0},
+        {"white", 0xF0F0F0}, {"grey", 0x909090}, {"gray", 0x909090},
+    };
+    std::string l = lower(s);
+    for (const auto& [name, rgb] : named) if (l == name) return rgb;
+    if (l.size() == 7 && l[0] == '#') {
+        try { return std::stoi(l.substr(1), nullptr, 16); } catch (...) {}
+    }
+    throw std::runtime_error("unknown color '" + s + "'");
+}
+
+SelectionCommand::SelectionCommand(const std::string& command) {
+    std::istringstream iss(command);
+    std::string verb;
+    iss >> verb;
+    verb = lower(verb);
+
+    if (verb == "reset") { action = SelectAction::RESET; return; }
+    if (verb == "hide") action = SelectAction::HIDE;
+    else if (verb == "show") action = SelectAction::SHOW;
+    else if (verb == "highlight") action = SelectAction::HIGHLIGHT;
+    else if (verb == "color" || verb == "colour") {
+        std::string c;
+        iss >> c;
+        action = SelectAction::COLOR;
+        color = parse_color(c);
+    }
+    else throw std::runtime_error("unknown action '" + verb + "' (hide, show, highlight, color, reset)");
+
+    std::string rest;
+    std::getline(iss, rest);
+    selection = Selection(rest);
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One bit per atom, combined a 64-bit word at a time.
+class Bitset {
+public:
+    explicit Bitset(size_t n_ = 0, bool value = false);
+
+    size_t size() const { return n; }
+    size_t count() const;
+    bool test(size_t i) const { return (w[i >> 6] >> (i & 63)) & 1u; }
+    void set(size_t i) { w[i >> 6] |= uint64_t(1) << (i & 63); }
+
+    Bitset& operator&=(const Bitset& o);
+    Bitset& operator|=(const Bitset& o);
+    void flip();
+
+    std::vector<uint64_t>& words() { return w; }
+    const std::vector<uint64_t>& words() const { return w; }
+
+private:
+    void trim();
+
+    size_t n;
+    std::vector<uint64_t> w;
+};
+
+// Columns the selection predicates read, one row per atom.
+struct AtomTable {
+    std::vector<float> x, y, z;
+    std::vector<int> resnum;
+    std::vector<uint16_t> chain;            // index into chain_names
+    std::vector<std::string> chain_names;
+    std::vector<char> ss;                   // 'H', 'S' or 'x'
+    std::vector<char> aa;                   // one-letter residue code
+    std::vector<char> interface;            // 1 : at an inter-chain interface, may be empty
+
+    size_t size() const { return x.size(); }
+};
+
+// Selection expression compiled into a postfix program of predicates and set
+// operations, evaluated to a Bitset over an AtomTable.
+//
+//   chain A,B   resi 10-20,35   resn LYS,K   ss helix,sheet,coil   interface   all   none
+//   within 8 of <term>   not <term>   <a> and <b>   <a> or <b>   ( ... )
+class Selection {
+public:
+    Selection() : Selection("all") {}
+    // throws std::runtime_error naming the offending token
+    explicit Selection(const std::string& expr);
+
+    Bitset evaluate(const AtomTable& table) const;
+    const std::string& get_text() const { return text; }
+
+private:
+    enum class Op { CHAIN, RESI, RESN, SS, INTERFACE, ALL, NONE, WITHIN, NOT, AND, OR };
+    struct Instr {
+        Instr(Op op) : op(op) {}
+        Op op;
+        std::vector<std::string> names;             // CHAIN
+        std::vector<char> codes;                    // RESN, SS
+        std::vector<std::pair<int, int>> ranges;    // RESI
+        float radius = 0.0f;                        // WITHIN
+    };
+
+    void parse_or();
+    void parse_and();
+    void parse_unary();
+    void parse_primary();
+    const std::string& peek() const;
+    std::string next();
+
+    std::string text;
+    std::vector<std::string> tokens;
+    size_t pos = 0;
+    std::vector<Instr> program;
+};
+
+enum class SelectAction { HIDE, SHOW, HIGHLIGHT, COLOR, RESET };
+
+// "<action> <expression>" where action is hide, show, highlight,
+// color <#rrggbb|name> or reset (no expression).
+struct SelectionCommand {
+    explicit SelectionCommand(const std::string& command);
+
+    SelectAction action = SelectAction::RESET;
+    int color = -1;                 // 0xRRGGBB for COLOR
+    Selection selection;
+};
@@ -88,139 +88,254 @@ void StructureMaker::compute_helix_axis(const std::vector<Atom>& helix, float (&
 
 
 
-void StructureMaker::calculate_ss_points(std::map<std::string, std::vector<Atom>>& init_atoms,
-                                         std::map<std::string, std::vector<Atom>>& ss_atoms) {
-    // std::cout << "  apply structure\n";
-    ss_atoms.clear();
-
-    for (auto& [chainID, atoms] : init_atoms) {
-        std::vector<Atom>& output = ss_atoms[chainID];
-        size_t i = 0;
-        while (i < atoms.size()) {
-            char s = atoms[i].structure;
-
-            if (s == 'H') {
-                // helix start: find sequential H
-                size_t start = i;
-                while (i < atoms.size() && atoms[i].structure == 'H') ++i;
-                size_t end = i;
-
-                if (end - start >= 4) {
-                    auto segment = std::vector<Atom>(atoms.begin() + start, atoms.begin() + end);
-
-                    float center[3], axis[3];
-                    compute_helix_axis(segment, center, axis);
-
-                    float dx = segment.back().x - segment.front().x;
-                    float dy = segment.back().y - segment.front().y;
-                    float dz = segment.back().z - segment.front().z;
-                    float length = std::sqrt(dx * dx + dy * dy + dz * dz);
-
-                    const int steps = std::min<int>(circle_steps, (end - start));     
-
-                    float up[3] = {0, 0, 1};
-                    if (std::abs(axis[2]) > 0.99f) { up[0] = 1; up[2] = 0; }
-
-                    float n1[3] = {
-                        axis[1]*up[2] - axis[2]*up[1],
-                        axis[2]*up[0] - axis[0]*up[2],
-                        axis[0]*up[1] - axis[1]*up[0]
-                    };
-                    float n1_norm = std::sqrt(n1[0]*n1[0] + n1[1]*n1[1] + n1[2]*n1[2]);
-                    for (int k = 0; k < 3; ++k) n1[k] /= n1_norm;
-
-                    float n2[3] = {
-                        axis[1]*n1[2] - axis[2]*n1[1],
-                        axis[2]*n1[0] - axis[0]*n1[2],
-                        axis[0]*n1[1] - axis[1]*n1[0]
-                    };
-
-                    for (int s = 0; s <= steps; ++s) {
-                        float t = static_cast<float>(s) / steps;
-                        float base[3] = {
-                            center[0] + axis[0] * (t - 0.5f) * length,
-                            center[1] + axis[1] * (t - 0.5f) * length,
-                            center[2] + axis[2] * (t - 0.5f) * length,
-                        };
-
-                        for (int a = 0; a < circle_steps; ++a) {
-                            float theta = 2 * PI * a / circle_steps;
-                            float dx = std::cos(theta);
-                            float dy = std::sin(theta);
-
-                            float px = base[0] + radius * (dx * n1[0] + dy * n2[0]);
-                            float py = base[1] + radius * (dx * n1[1] + dy * n2[1]);
-                            float pz = base[2] + radius * (dx * n1[2] + dy * n2[2]);
-
-                            output.emplace_back(px, py, pz, 'H');
-                        }
-                    }
-                } else {
-                    // if too short, ignore
-                    i = end;
-                }
-            }
 
-            else if (s == 'S' && i + 1 < atoms.size() && atoms[i + 1].structure == 'S') {
-                const Atom& p1 = atoms[i];
-                const Atom& p2 = atoms[i + 1];
+static inline float point_dist(const Atom& a, const Atom& b) {
+    float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+static inline void cross3(const float a[3], const float b[3], float out[3]) {
+    out[0] = a[1]*b[2] - a[2]*b[1];
+    out[1] = a[2]*b[0] - a[0]*b[2];
+    out[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+static inline bool normalize3(float v[3]) {
+    float n = std::sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+    if (n < 1e-6f) return false;
+    v[0] /= n; v[1] /= n; v[2] /= n;
+    return true;
+}
 
-                float dx = p2.x - p1.x;
-                float dy = p2.y - p1.y;
-                float dz = p2.z - p1.z;
-                float len = std::sqrt(dx * dx + dy * dy + dz * dz);
-                if (len == 0) { i++; continue; }
+// vector perpendicular to `axis`, used when the geometry gives no direction
+static void any_perpendicular(const float axis[3], float out[3]) {
+    float up[3] = {0.0f, 0.0f, 1.0f};
+    if (std::abs(axis[2]) > 0.99f) { up[0] = 1.0f; up[2] = 0.0f; }
+    cross3(axis, up, out);
+    normalize3(out);
+}
 
-                float axis[3] = { dx / len, dy / len, dz / len };  // direction vector
-                float up[3] = { 0.0f, 0.0f, 1.0f };
-                if (std::abs(axis[2]) > 0.99f) {
-                    up[0] = 1.0f; up[2] = 0.0f;  // if almost similar to z-axis, replace
+void StructureMaker::build_cartoon(std::vector<Atom>& controls, float unit, Cartoon& cartoon) {
+    const int n = static_cast<int>(controls.size());
+    cartoon = Cartoon();
+    cartoon.trace_len = n;
+
+    int coil_start = 0;
+    auto flush_trace = [&](int end) {
+        if (end > coil_start)
+            cartoon.primitives.push_back({'x', coil_start, end - coil_start + 1});
+    };
+
+    int i = 0;
+    while (i < n) {
+        char s = controls[i].structure;
+        int j = i;
+        while (j < n && controls[j].structure == s) ++j;
+        int len = j - i;
+
+        if (s == 'H' && len >= 4) {
+            // helix: spiral around the principal axis, trace resumes at its last residue
+            flush_trace(i);
+            std::vector<Atom> segment(controls.begin() + i, controls.begin() + j);
+
+            float center[3], axis[3];
+            compute_helix_axis(segment, center, axis);
+
+            const Atom& first = segment.front();
+            const Atom& last = segment.back();
+            float d[3] = {last.x - first.x, last.y - first.y, last.z - first.z};
+            if (d[0]*axis[0] + d[1]*axis[1] + d[2]*axis[2] < 0.0f) {
+                axis[0] = -axis[0]; axis[1] = -axis[1]; axis[2] = -axis[2];
+            }
+
+            float v0[3] = {first.x - center[0], first.y - center[1], first.z - center[2]};
+            float v1[3] = {last.x - center[0], last.y - center[1], last.z - center[2]};
+            float t0 = v0[0]*axis[0] + v0[1]*axis[1] + v0[2]*axis[2];
+            float t1 = v1[0]*axis[0] + v1[1]*axis[1] + v1[2]*axis[2];
+
+            // n1 points from the axis to the first CA so the spiral starts on it
+            float n1[3] = {v0[0] - axis[0]*t0, v0[1] - axis[1]*t0, v0[2] - axis[2]*t0};
+            if (!normalize3(n1)) any_perpendicular(axis, n1);
+            float n2[3];
+            cross3(axis, n1, n2);
+
+            float r = radius * unit;
+            float a[3] = {center[0] + axis[0]*t0, center[1] + axis[1]*t0, center[2] + axis[2]*t0};
+            int base = static_cast<int>(controls.size());
+            controls.emplace_back(a[0], a[1], a[2], 'H');
+            controls.emplace_back(center[0] + axis[0]*t1, center[1] + axis[1]*t1, center[2] + axis[2]*t1, 'H');
+            controls.emplace_back(a[0] + r*n1[0], a[1] + r*n1[1], a[2] + r*n1[2], 'H');
+            controls.emplace_back(a[0] + r*n2[0], a[1] + r*n2[1], a[2] + r*n2[2], 'H');
+            float occlusion = 0.0f;
+            for (const Atom& ca : segment) occlusion += ca.occlusion;
+            for (int k = 0; k < 4; ++k) controls[base + k].occlusion = occlusion / len;
+
+            CartoonPrimitive prim{'H', base, len};
+            prim.turns = (len - 1) * 100.0f / 360.0f;   // 100 degrees per residue
+            prim.residue = i;
+            cartoon.primitives.push_back(prim);
+            coil_start = j - 1;
+        }
+        else if (s == 'S' && len >= 2) {
+            // strand: the trace is the ribbon center, edges are extra rows
+            std::vector<float> side(3 * len);
+            float prev[3] = {0.0f, 0.0f, 0.0f};
+            for (int k = 0; k < len; ++k) {
+                int c = i + k;
+                int lo = std::max(c - 1, i), hi = std::min(c + 1, j - 1);
+                float t[3] = {controls[hi].x - controls[lo].x,
+                              controls[hi].y - controls[lo].y,
+                              controls[hi].z - controls[lo].z};
+                normalize3(t);
+
+                // pleat direction from the chain's local curvature
+                int pl = std::max(c - 1, 0), ph = std::min(c + 1, n - 1);
+                float b[3] = {controls[pl].x + controls[ph].x - 2.0f * controls[c].x,
+                              controls[pl].y + controls[ph].y - 2.0f * controls[c].y,
+                              controls[pl].z + controls[ph].z - 2.0f * controls[c].z};
+                float* out = &side[3 * k];
+                cross3(t, b, out);
+                if (!normalize3(out)) {
+                    if (k > 0) { out[0] = prev[0]; out[1] = prev[1]; out[2] = prev[2]; }
+                    else any_perpendicular(t, out);
+                }
+                // pleats alternate, keep the ribbon from twisting
+                if (k > 0 && out[0]*prev[0] + out[1]*prev[1] + out[2]*prev[2] < 0.0f) {
+                    out[0] = -out[0]; out[1] = -out[1]; out[2] = -out[2];
                 }
+                prev[0] = out[0]; prev[1] = out[1]; prev[2] = out[2];
+            }
 
-                // n1: vector perpendicular to axis
-                float n1[3] = {
-                    axis[1]*up[2] - axis[2]*up[1],
-                    axis[2]*up[0] - axis[0]*up[2],
-                    axis[0]*up[1] - axis[1]*up[0]
-                };
-                float n1_norm = std::sqrt(n1[0]*n1[0] + n1[1]*n1[1] + n1[2]*n1[2]);
-                for (int j = 0; j < 3; ++j) n1[j] /= n1_norm;
-
-                // ribbon width vector, move to direction n1
-                int line_steps = std::max<int>(2, static_cast<int>(len / 0.05f));
-
-                for (int step = -width; step <= width; ++step) {
-                    float offset[3] = {
-                        n1[0] * step * 0.05f,
-                        n1[1] * step * 0.05f,
-                        n1[2] * step * 0.05f
-                    };
-
-                    float x1 = p1.x + offset[0];
-                    float y1 = p1.y + offset[1];
-                    float z1 = p1.z + offset[2];
-
-                    float x2 = p2.x + offset[0];
-                    float y2 = p2.y + offset[1];
-                    float z2 = p2.z + offset[2];
-
-                    for (int t = 0; t <= line_steps; ++t) {
-                        float f = static_cast<float>(t) / line_steps;
-                        float x = x1 + f * (x2 - x1);
-                        float y = y1 + f * (y2 - y1);
-                        float z = z1 + f * (z2 - z1);
-
-                        output.emplace_back(x, y, z, 'S');
-                    }
+            int base = static_cast<int>(controls.size());
+            const float rows[4] = {1.0f, -1.0f, 0.5f, -0.5f};
+            for (float f : rows) {
+                float off = f * sheet_half_width * unit;
+                for (int k = 0; k < len; ++k) {
+                    const Atom& ca = controls[i + k];
+                    float x = ca.x + side[3*k] * off;
+                    float y = ca.y + side[3*k + 1] * off;
+                    float z = ca.z + side[3*k + 2] * off;
+                    float occlusion = ca.occlusion;
+                    controls.emplace_back(x, y, z, 'S');
+                    controls.back().occlusion = occlusion;
                 }
-                i++;  // sheet: pair
             }
+            cartoon.primitives.push_back({'S', base, len});
+            cartoon.primitives.back().residue = i;
+        }
+        i = j;
+    }
+    flush_trace(n - 1);
+    if (cartoon.primitives.empty() && n > 0)
+        cartoon.primitives.push_back({'x', 0, n});
+}
+
+void StructureMaker::add_spline(const std::vector<Atom>& controls, int first, int count, int lo, int hi,
+                                int residue, float px_per_unit, char structure, std::vector<CartoonVertex>& out) {
+    // control `first` belongs to trace residue `residue`, the rest follow in order
+    if (count == 1) {
+        out.push_back({{first, first, first, first}, {1.0f, 0.0f, 0.0f, 0.0f},
+                       structure ? structure : controls[first].structure, true, residue});
+        return;
+    }
+
+    bool new_stroke = true;
+    for (int k = first; k + 1 < first + count; ++k) {
+        int p0 = std::max(k - 1, lo), p1 = k, p2 = k + 1, p3 = std::min(k + 2, hi);
+        float len_px = point_dist(controls[p1], controls[p2]) * px_per_unit;
+        int samples = std::clamp(static_cast<int>(std::ceil(len_px / px_per_sample)), 1, max_span_samples);
+
+        for (int s = 0; s < samples; ++s) {
+            // Catmull-Rom basis
+            float t = static_cast<float>(s) / samples;
+            float t2 = t * t, t3 = t2 * t;
+            CartoonVertex v;
+            v.idx[0] = p0; v.idx[1] = p1; v.idx[2] = p2; v.idx[3] = p3;
+            v.w[0] = 0.5f * (-t3 + 2.0f * t2 - t);
+            v.w[1] = 0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f);
+            v.w[2] = 0.5f * (-3.0f * t3 + 4.0f * t2 + t);
+            v.w[3] = 0.5f * (t3 - t2);
+            v.structure = structure ? structure : controls[t < 0.5f ? p1 : p2].structure;
+            v.new_stroke = new_stroke;
+            v.residue = residue + (t < 0.5f ? p1 : p2) - first;
+            new_stroke = false;
+            out.push_back(v);
+        }
+    }
+    int last = first + count - 1;
+    out.push_back({{last, last, last, last}, {1.0f, 0.0f, 0.0f, 0.0f},
+                   structure ? structure : controls[last].structure, false, residue + count - 1});
+}
 
-            else {
-                // no structure, just add
-                output.push_back(atoms[i]);
-                ++i;
+void StructureMaker::add_helix(const std::vector<Atom>& controls, const CartoonPrimitive& prim,
+                               float px_per_unit, std::vector<CartoonVertex>& out) {
+    int a = prim.first, b = a + 1, n1 = a + 2, n2 = a + 3;
+    float circ_px = 2.0f * PI * point_dist(controls[a], controls[n1]) * px_per_unit;
+    int per_turn = std::clamp(static_cast<int>(std::ceil(circ_px / px_per_sample)), 4, 24);
+    int total = std::max(2, static_cast<int>(std::ceil(prim.turns * per_turn)));
+
+    for (int s = 0; s <= total; ++s) {
+        // A + t(B-A) + cos(theta)(N1-A) + sin(theta)(N2-A)
+        float t = static_cast<float>(s) / total;
+        float theta = 2.0f * PI * prim.turns * t;
+        float c = std::cos(theta), sn = std::sin(theta);
+        int residue = prim.residue + static_cast<int>(t * (prim.count - 1) + 0.5f);
+        out.push_back({{a, b, n1, n2}, {1.0f - t - c - sn, t, c, sn}, 'H', s == 0, residue});
+    }
+}
+
+void StructureMaker::tessellate(const std::vector<Atom>& controls, float px_per_unit, Cartoon& cartoon) {
+    if (cartoon.lod > 0.0f &&
+        px_per_unit < cartoon.lod * lod_tolerance &&
+        px_per_unit > cartoon.lod / lod_tolerance) return;
+
+    cartoon.lod = px_per_unit;
+    cartoon.vertices.clear();
+    for (const CartoonPrimitive& prim : cartoon.primitives) {
+        switch (prim.type) {
+            case 'x':
+                add_spline(controls, prim.first, prim.count, 0, cartoon.trace_len - 1,
+                           prim.first, px_per_unit, 0, cartoon.vertices);
+                break;
+            case 'H':
+                add_helix(controls, prim, px_per_unit, cartoon.vertices);
+                break;
+            case 'S': {
+                // edges once the ribbon is a few pixels wide, inner rows when wider
+                float width_px = point_dist(controls[prim.first], controls[prim.first + prim.count]) * px_per_unit;
+                int rows = width_px < 3.0f ? 0 : (width_px < 8.0f ? 2 : 4);
+                for (int r = 0; r < rows; ++r) {
+                    int row = prim.first + r * prim.count;
+                    add_spline(controls, row, prim.count, row, row + prim.count - 1,
+                               prim.residue, px_per_unit, 'S', cartoon.vertices);
+                }
+                break;
             }
         }
     }
 }
+
+void StructureMaker::evaluate(const std::vector<Atom>& controls, const Cartoon& cartoon, std::vector<Atom>& out) {
+    out.resize(cartoon.vertices.size());
+    for (size_t i = 0; i < cartoon.vertices.size(); ++i) {
+        const CartoonVertex& v = cartoon.vertices[i];
+        float x = 0.0f, y = 0.0f, z = 0.0f, occlusion = 0.0f;
+        for (int k = 0; k < 4; ++k) {
+            const Atom& c = controls[v.idx[k]];
+            x += v.w[k] * c.x;
+            y += v.w[k] * c.y;
+            z += v.w[k] * c.z;
+            occlusion += v.w[k] * c.occlusion;
+        }
+        out[i] = Atom(x, y, z, v.structure);
+        out[i].new_stroke = v.new_stroke;
+        out[i].occlusion = std::clamp(occlusion, 0.0f, 1.0f);
+        const Atom& r = controls[v.residue];
+        out[i].hidden = r.hidden;
+        out[i].highlight = r.highlight;
+        out[i].color = r.color;
+        out[i].exposure = r.exposure;
+        out[i].interface = r.interface;
+        out[i].residue = v.residue;
+    }
+}
@@ -3,24 +3,66 @@
 #include <cmath>
 #include <vector>
 #include <cstdlib>
+#include <algorithm>
 
 #ifndef MY_CLASS_HPP
 #define MY_CLASS_HPP
 
+// One parametric piece of the cartoon. Indices refer to the chain's control
+// points: [0, trace_len) are the CA trace, extras are appended after it.
+struct CartoonPrimitive {
+    char type;      // 'x' : trace spline, 'H' : helix spiral, 'S' : strand ribbon
+    int first;      // first control point (trace residue for 'x', A/B/N1/N2 block for 'H', edge rows for 'S')
+    int count;      // residues covered
+    float turns = 0.0f;
+    int residue = -1;   // first trace residue covered ('H', 'S'; 'x' uses first)
+};
+
+// Tessellated point expressed as an affine combination of control points, so
+// it stays valid under the rotate/shift/scale applied to the control points.
+struct CartoonVertex {
+    int idx[4];
+    float w[4];
+    char structure;
+    bool new_stroke;
+    int residue;        // trace residue the vertex takes its display attributes from
+};
+
+struct Cartoon {
+    int trace_len = 0;
+    std::vector<CartoonPrimitive> primitives;
+    std::vector<CartoonVertex> vertices;
+    float lod = 0.0f;   // pixels per unit the vertices were tessellated for
+};
+
 class StructureMaker {
 public:
-    StructureMaker(); 
+    StructureMaker();
     ~StructureMaker();
 
-    void calculate_ss_points(std::map<std::string, std::vector<Atom>>& init_atoms,
-                           std::map<std::string, std::vector<Atom>>& ss_atoms);
+    // Append cartoon control points to `controls` (which must hold the CA trace)
+    // and describe the primitives built on them. `unit` converts Angstrom to
+    // the coordinate space of `controls`.
+    void build_cartoon(std::vector<Atom>& controls, float unit, Cartoon& cartoon);
+    // Re-sample the primitives for the given projected size; no-op while the
+    // cached tessellation is still within tolerance.
+    void tessellate(const std::vector<Atom>& controls, float px_per_unit, Cartoon& cartoon);
+    void evaluate(const std::vector<Atom>& controls, const Cartoon& cartoon, std::vector<Atom>& out);
+
     void compute_helix_axis(const std::vector<Atom>& helix, float (&center)[3], float (&axis)[3]);
     std::vector<std::vector<Atom>> extract_helix_segments(const Atom* atoms, int num_atoms);
 private:
-    float radius = 2.5f;
-    int circle_steps = 8; 
-    int width = 4;
+    void add_spline(const std::vector<Atom>& controls, int first, int count, int lo, int hi,
+                    int residue, float px_per_unit, char structure, std::vector<CartoonVertex>& out);
+    void add_helix(const std::vector<Atom>& controls, const CartoonPrimitive& prim,
+                   float px_per_unit, std::vector<CartoonVertex>& out);
+
+    float radius = 2.3f;            // CA helix radius
+    float sheet_half_width = 1.0f;
+    float px_per_sample = 3.0f;     // target screen distance between samples
+    float lod_tolerance = 1.25f;    // retessellate when scale drifts by more than this factor
+    int max_span_samples = 16;
 };
 
 
-#endif
\ No newline at end of file
+#endif
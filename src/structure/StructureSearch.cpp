@@ -0,0 +1,401 @@
+#include "StructureSearch.hpp"
+#include "Parallel.hpp"
+#include "simd.h"
+
+#include <gemmi/mmread.hpp>
+#include <gemmi/model.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static const char INDEX_MAGIC[8] = {'P', 'D', 'B', 'T', 'C', 'A', 'I', '1'};
+
+static std::string index_dir() {
+    const char* home = getenv("HOME");
+    return home ? (std::string(home) + "/.cache/pdbterm/ca_index") : "/tmp/pdbterm_cache/ca_index";
+}
+
+static uint64_t fnv1a(const std::string& s) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : s) { h ^= c; h *= 1099511628211ull; }
+    return h;
+}
+
+static bool is_structure_file(const fs::path& p) {
+    std::string name = p.filename().string();
+    if (name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0) return false;
+    return name.find(".pdb") != std::string::npos || name.find(".cif") != std::string::npos ||
+           name.find(".ent") != std::string::npos;
+}
+
+StructureSearch::StructureSearch(const std::string& dir_) {
+    std::error_code ec;
+    fs::path canon = fs::weakly_canonical(dir_, ec);
+    dir = ec ? dir_ : canon.string();
+
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)fnv1a(dir));
+    index_path = index_dir() + "/" + hex + ".idx";
+}
+
+// --- CA extraction ---
+
+bool StructureSearch::read_ca_trace(const std::string& path, CATrace& trace) {
+    try {
+        gemmi::Structure st = gemmi::read_structure_file(path);
+        st.remove_empty_chains();
+        st.merge_chain_parts();
+        if (st.models.empty()) return false;
+
+        for (gemmi::Chain& chain : st.first_model().chains) {
+            std::string cid = chain.name.empty() ? "?" : chain.name;
+            for (gemmi::Residue& res : chain.residues) {
+                const gemmi::Atom* ca = res.get_ca();
+                if (!ca) continue;
+                int resn = res.seqid.num.has_value() ? (int)res.seqid.num : 0;
+                trace.push_back((float)ca->pos.x, (float)ca->pos.y, (float)ca->pos.z,
+                                resn, cid, Superposer::one_letter(res.name));
+            }
+        }
+        return trace.size() > 0;
+    } catch (...) {
+        return false;
+    }
+}
+
+// --- On-disk index ---
+
+template <typename T>
+static void write_pod(std::ofstream& out, const T& v) {
+    out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+// Every read is checked against the bytes left in the file, so a truncated or
+// corrupt index fails cleanly instead of asking for a huge allocation.
+template <typename T>
+static bool read_pod(std::ifstream& in, uint64_t& left, T& v) {
+    if (left < sizeof(T)) return false;
+    left -= sizeof(T);
+    return (bool)in.read(reinterpret_cast<char*>(&v), sizeof(T));
+}
+
+static void write_string(std::ofstream& out, const std::string& s) {
+    write_pod(out, (uint32_t)s.size());
+    out.write(s.data(), s.size());
+}
+
+static bool read_string(std::ifstream& in, uint64_t& left, std::string& s) {
+    uint32_t len;
+    if (!read_pod(in, left, len) || len > left) return false;
+    left -= len;
+    s.resize(len);
+    return len == 0 || (bool)in.read(&s[0], len);
+}
+
+template <typename T>
+static void write_array(std::ofstream& out, const std::vector<T>& v) {
+    out.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+}
+
+template <typename T>
+static bool read_array(std::ifstream& in, uint64_t& left, std::vector<T>& v, uint64_t n) {
+    if (n > left / sizeof(T)) return false;
+    left -= n * sizeof(T);
+    v.resize(n);
+    return n == 0 || (bool)in.read(reinterpret_cast<char*>(v.data()), n * sizeof(T));
+}
+
+// path length, mtime, size, atom count and run count: the least an entry takes
+static const uint64_t MIN_ENTRY_BYTES = 4 + 8 + 8 + 8 + 4;
+// chain id length and run length
+static const uint64_t MIN_RUN_BYTES = 4 + 4;
+
+bool StructureSearch::load_index() {
+    entries.clear();
+    std::ifstream in(index_path, std::ios::binary);
+    if (!in.is_open()) return false;
+
+    std::error_code ec;
+    uintmax_t file_size = fs::file_size(index_path, ec);
+    if (ec) return false;
+    uint64_t left = file_size;
+
+    auto parse = [&]() -> bool {
+        char magic[8];
+        if (left < 8 || !in.read(magic, 8) || !std::equal(magic, magic + 8, INDEX_MAGIC)) return false;
+        left -= 8;
+        uint64_t count;
+        if (!read_pod(in, left, count) || count > left / MIN_ENTRY_BYTES) return false;
+
+        for (uint64_t e = 0; e < count; e++) {
+            Entry entry;
+            uint64_t n;
+            if (!read_string(in, left, entry.path) || !read_pod(in, left, entry.mtime) ||
+                !read_pod(in, left, entry.size) || !read_pod(in, left, n)) return false;
+
+            CATrace& t = entry.trace;
+            if (!read_array(in, left, t.x, n) || !read_array(in, left, t.y, n) ||
+                !read_array(in, left, t.z, n) || !read_array(in, left, t.resnum, n)) return false;
+            if (n > left) return false;
+            left -= n;
+            t.seq.resize(n);
+            if (n > 0 && !in.read(&t.seq[0], n)) return false;
+
+            // chain ids are stored run-length encoded
+            uint32_t runs;
+            if (!read_pod(in, left, runs) || runs > left / MIN_RUN_BYTES) return false;
+            t.chain.reserve(n);
+            for (uint32_t r = 0; r < runs; r++) {
+                std::string cid;
+                uint32_t len;
+                if (!read_string(in, left, cid) || !read_pod(in, left, len) ||
+                    len > n - t.chain.size()) return false;
+                t.chain.insert(t.chain.end(), len, cid);
+            }
+            if (t.chain.size() != n) return false;
+            entries.push_back(std::move(entry));
+        }
+        return true;
+    };
+
+    // anything unexpected means the cache is rebuilt from the structure files
+    bool ok = false;
+    try {
+        ok = parse();
+    } catch (const std::exception&) {
+        ok = false;
+    }
+    if (!ok) entries.clear();
+    return ok;
+}
+
+void StructureSearch::save_index() {
+    std::error_code ec;
+    fs::create_directories(index_dir(), ec);
+    // per-process name, so two instances indexing the same directory never
+    // write into each other's file before the rename
+    std::string tmp = index_path + "." + std::to_string(getpid()) + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out.is_open()) return;
+
+        out.write(INDEX_MAGIC, 8);
+        write_pod(out, (uint64_t)entries.size());
+        for (const Entry& entry : entries) {
+            const CATrace& t = entry.trace;
+            write_string(out, entry.path);
+            write_pod(out, entry.mtime);
+            write_pod(out, entry.size);
+            write_pod(out, (uint64_t)t.size());
+            write_array(out, t.x);
+            write_array(out, t.y);
+            write_array(out, t.z);
+            write_array(out, t.resnum);
+            out.write(t.seq.data(), t.seq.size());
+
+            std::vector<std::pair<std::string, uint32_t>> runs;
+            for (const std::string& cid : t.chain) {
+                if (runs.empty() || runs.back().first != cid) runs.push_back({cid, 0});
+                runs.back().second++;
+            }
+            write_pod(out, (uint32_t)runs.size());
+            for (const auto& [cid, len] : runs) {
+                write_string(out, cid);
+                write_pod(out, len);
+            }
+        }
+    }
+    fs::rename(tmp, index_path, ec);
+}
+
+void StructureSearch::update_index() {
+    load_index();
+    std::map<std::string, size_t> cached;
+    for (size_t i = 0; i < entries.size(); i++) cached[entries[i].path] = i;
+
+    std::vector<Entry> current;
+    std::vector<size_t> to_parse;
+    std::error_code ec;
+    for (const auto& de : fs::directory_iterator(dir, ec)) {
+        if (!de.is_regular_file() || !is_structure_file(de.path())) continue;
+
+        Entry entry;
+        entry.path = de.path().string();
+        entry.mtime = (int64_t)de.last_write_time().time_since_epoch().count();
+        entry.size = (uint64_t)de.file_size();
+
+        auto it = cached.find(entry.path);
+        if (it != cached.end() && entries[it->second].mtime == entry.mtime &&
+            entries[it->second].size == entry.size) {
+            entry.trace = std::move(entries[it->second].trace);
+        } else {
+            to_parse.push_back(current.size());
+        }
+        current.push_back(std::move(entry));
+    }
+
+    // unreadable files keep an empty trace so they are not retried until they change
+    parallel_for(to_parse.size(), [&](size_t k) {
+        Entry& entry = current[to_parse[k]];
+        read_ca_trace(entry.path, entry.trace);
+    });
+
+    bool changed = !to_parse.empty() || current.size() != entries.size();
+    std::sort(current.begin(), current.end(),
+              [](const Entry& a, const Entry& b) { return a.path < b.path; });
+    entries = std::move(current);
+    if (changed) save_index();
+
+    std::cout << "  search index: " << entries.size() << " structures ("
+              << to_parse.size() << " parsed)\n";
+}
+
+// --- TM-score ---
+
+// transforms the target by `sp`, stores squared distances to the query and
+// returns the TM sum over all pairs
+static float tm_kernel(const float* qx, const float* qy, const float* qz,
+                       const float* tx, const float* ty, const float* tz, size_t n,
+                       const Superposition& sp, float d0sq, float* d2) {
+    const float* R = sp.rot;
+    const float* S = sp.shift;
+    simd_float r0 = simdf32_set(R[0]), r1 = simdf32_set(R[1]), r2 = simdf32_set(R[2]);
+    simd_float r3 = simdf32_set(R[3]), r4 = simdf32_set(R[4]), r5 = simdf32_set(R[5]);
+    simd_float r6 = simdf32_set(R[6]), r7 = simdf32_set(R[7]), r8 = simdf32_set(R[8]);
+    simd_float s0 = simdf32_set(S[0]), s1 = simdf32_set(S[1]), s2 = simdf32_set(S[2]);
+    simd_float one = simdf32_set(1.0f), vd0 = simdf32_set(d0sq);
+    simd_float acc = simdf32_setzero();
+
+    size_t i = 0;
+    for (; i + VECSIZE_FLOAT <= n; i += VECSIZE_FLOAT) {
+        simd_float x = simdf32_loadu(tx + i), y = simdf32_loadu(ty + i), z = simdf32_loadu(tz + i);
+        simd_float mx = simdf32_add(simdf32_add(simdf32_add(simdf32_mul(r0, x), simdf32_mul(r1, y)), simdf32_mul(r2, z)), s0);
+        simd_float my = simdf32_add(simdf32_add(simdf32_add(simdf32_mul(r3, x), simdf32_mul(r4, y)), simdf32_mul(r5, z)), s1);
+        simd_float mz = simdf32_add(simdf32_add(simdf32_add(simdf32_mul(r6, x), simdf32_mul(r7, y)), simdf32_mul(r8, z)), s2);
+        simd_float dx = simdf32_sub(mx, simdf32_loadu(qx + i));
+        simd_float dy = simdf32_sub(my, simdf32_loadu(qy + i));
+        simd_float dz = simdf32_sub(mz, simdf32_loadu(qz + i));
+        simd_float dd = simdf32_add(simdf32_add(simdf32_mul(dx, dx), simdf32_mul(dy, dy)), simdf32_mul(dz, dz));
+        simdf32_storeu(d2 + i, dd);
+        acc = simdf32_add(acc, simdf32_div(one, simdf32_add(one, simdf32_div(dd, vd0))));
+    }
+    float sum = simdf32_hadd(acc);
+    for (; i < n; i++) {
+        float x = tx[i], y = ty[i], z = tz[i];
+        float dx = R[0]*x + R[1]*y + R[2]*z + S[0] - qx[i];
+        float dy = R[3]*x + R[4]*y + R[5]*z + S[1] - qy[i];
+        float dz = R[6]*x + R[7]*y + R[8]*z + S[2] - qz[i];
+        d2[i] = dx*dx + dy*dy + dz*dz;
+        sum += 1.0f / (1.0f + d2[i] / d0sq);
+    }
+    return sum;
+}
+
+float StructureSearch::tm_score(const CATrace& query, const CATrace& target, Superposer& superposer,
+                                Superposition& fit, int& aligned, float& rmsd) {
+    fit = Superposition();
+    aligned = 0;
+    rmsd = 0.0f;
+
+    std::vector<int> qi, ti;
+    superposer.match_residues(query, target, qi, ti);
+    const size_t n = qi.size();
+    if (n < 3 || query.size() == 0) return 0.0f;
+
+    std::vector<float> qx(n), qy(n), qz(n), tx(n), ty(n), tz(n), d2(n);
+    for (size_t k = 0; k < n; k++) {
+        qx[k] = query.x[qi[k]];  qy[k] = query.y[qi[k]];  qz[k] = query.z[qi[k]];
+        tx[k] = target.x[ti[k]]; ty[k] = target.y[ti[k]]; tz[k] = target.z[ti[k]];
+    }
+
+    float L = (float)query.size();
+    float d0 = (L > 21.0f) ? 1.24f * std::cbrt(L - 15.0f) - 1.8f : 0.5f;
+    float d0sq = d0 * d0;
+    float d_search = std::clamp(d0, 4.5f, 8.0f);
+
+    std::vector<float> sx, sy, sz, ux, uy, uz;
+    auto fit_subset = [&](const std::vector<size_t>& sel) {
+        sx.clear(); sy.clear(); sz.clear(); ux.clear(); uy.clear(); uz.clear();
+        for (size_t k : sel) {
+            sx.push_back(qx[k]); sy.push_back(qy[k]); sz.push_back(qz[k]);
+            ux.push_back(tx[k]); uy.push_back(ty[k]); uz.push_back(tz[k]);
+        }
+        return Superposer::kabsch(sx.data(), sy.data(), sz.data(), ux.data(), uy.data(), uz.data(), sel.size());
+    };
+
+    // seeds: the whole alignment, then halves and quarters at a few offsets
+    float best = -1.0f;
+    std::vector<size_t> sel;
+    for (size_t len : {n, n / 2, n / 4}) {
+        if (len < 4 && len != n) continue;
+        size_t span = n - len;
+        size_t seeds = std::min<size_t>(span / std::max<size_t>(1, len / 2) + 1, 8);
+        for (size_t s = 0; s < seeds; s++) {
+            size_t start = (seeds > 1) ? span * s / (seeds - 1) : 0;
+            sel.clear();
+            for (size_t k = start; k < start + len; k++) sel.push_back(k);
+            Superposition sp = fit_subset(sel);
+
+            // extend to every pair within d_search and refit until it settles
+            for (int iter = 0; iter < 5; iter++) {
+                float score = tm_kernel(qx.data(), qy.data(), qz.data(),
+                                        tx.data(), ty.data(), tz.data(), n, sp, d0sq, d2.data());
+                if (score > best) {
+                    best = score;
+                    fit = sp;
+                    aligned = sp.aligned;
+                    rmsd = sp.rmsd;
+                }
+
+                std::vector<size_t> next;
+                for (size_t k = 0; k < n; k++)
+                    if (d2[k] < d_search * d_search) next.push_back(k);
+                if (next.size() < 3 || next == sel) break;
+                sel.swap(next);
+                sp = fit_subset(sel);
+            }
+        }
+    }
+    return std::max(0.0f, best) / L;
+}
+
+std::vector<SearchHit> StructureSearch::search(const CATrace& query, const std::string& query_path,
+                                               size_t max_hits) {
+    update_index();
+
+    std::error_code ec;
+    fs::path qcanon = fs::weakly_canonical(query_path, ec);
+
+    std::vector<SearchHit> hits(entries.size());
+    std::vector<char> keep(entries.size(), 0);
+    parallel_for(entries.size(), [&](size_t i) {
+        const Entry& entry = entries[i];
+        if (entry.trace.size() < 3) return;
+        std::error_code ec2;
+        if (!query_path.empty() && fs::weakly_canonical(entry.path, ec2) == qcanon) return;
+
+        Superposer superposer;
+        SearchHit& hit = hits[i];
+        hit.path = entry.path;
+        hit.tm = tm_score(query, entry.trace, superposer, hit.fit, hit.aligned, hit.rmsd);
+        keep[i] = 1;
+    });
+
+    std::vector<SearchHit> ranked;
+    for (size_t i = 0; i < hits.size(); i++)
+        if (keep[i]) ranked.push_back(std::move(hits[i]));
+    std::sort(ranked.begin(), ranked.end(),
+              [](const SearchHit& a, const SearchHit& b) { return a.tm > b.tm; });
+    if (ranked.size() > max_hits) ranked.resize(max_hits);
+    return ranked;
+}
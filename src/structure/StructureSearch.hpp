@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Superposer.hpp"
+
+struct SearchHit {
+    std::string path;
+    float tm = 0.0f;            // normalized by query length
+    float rmsd = 0.0f;
+    int aligned = 0;
+    Superposition fit;          // moves the hit onto the query
+};
+
+// Ranks every structure file in a directory by TM-score against a query.
+// CA traces are kept in an on-disk index (~/.cache/pdbterm/ca_index) keyed by
+// path, mtime and size, so only new or changed files are parsed again.
+class StructureSearch {
+public:
+    explicit StructureSearch(const std::string& dir_);
+
+    std::vector<SearchHit> search(const CATrace& query, const std::string& query_path,
+                                  size_t max_hits = 50);
+
+    // best TM-score over a few seed superpositions on the paired residues
+    static float tm_score(const CATrace& query, const CATrace& target, Superposer& superposer,
+                          Superposition& fit, int& aligned, float& rmsd);
+
+    static bool read_ca_trace(const std::string& path, CATrace& trace);
+
+private:
+    struct Entry {
+        std::string path;
+        int64_t mtime = 0;
+        uint64_t size = 0;
+        CATrace trace;
+    };
+
+    void update_index();
+    bool load_index();
+    void save_index();
+
+    std::string dir;
+    std::string index_path;
+    std::vector<Entry> entries;
+};
@@ -0,0 +1,251 @@
+#include "Superposer.hpp"
+#include "Parallel.hpp"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <utility>
+
+char Superposer::one_letter(const std::string& resname) {
+    static const std::map<std::string, char> codes = {
+        {"ALA", 'A'}, {"ARG", 'R'}, {"ASN", 'N'}, {"ASP", 'D'}, {"CYS", 'C'},
+        {"GLN", 'Q'}, {"GLU", 'E'}, {"GLY", 'G'}, {"HIS", 'H'}, {"ILE", 'I'},
+        {"LEU", 'L'}, {"LYS", 'K'}, {"MET", 'M'}, {"PHE", 'F'}, {"PRO", 'P'},
+        {"SER", 'S'}, {"THR", 'T'}, {"TRP", 'W'}, {"TYR", 'Y'}, {"VAL", 'V'},
+        {"MSE", 'M'}, {"SEC", 'U'}, {"PYL", 'O'},
+    };
+    auto it = codes.find(resname);
+    return it != codes.end() ? it->second : 'X';
+}
+
+// --- Residue correspondence ---
+
+void Superposer::align_sequences(const std::string& a, const std::string& b,
+                                 std::vector<int>& a_idx, std::vector<int>& b_idx) {
+    // Needleman-Wunsch, linear gaps
+    const int match = 2, mismatch = -1, gap = -2;
+    const size_t n = a.size(), m = b.size();
+    std::vector<int> prev(m + 1), cur(m + 1);
+    std::vector<uint8_t> trace((n + 1) * (m + 1), 0);   // 0 diag, 1 up (gap in b), 2 left (gap in a)
+
+    for (size_t j = 0; j <= m; ++j) { prev[j] = (int)j * gap; trace[j] = 2; }
+    for (size_t i = 1; i <= n; ++i) {
+        cur[0] = (int)i * gap;
+        trace[i * (m + 1)] = 1;
+        for (size_t j = 1; j <= m; ++j) {
+            bool same = a[i-1] == b[j-1] && a[i-1] != 'X';
+            int diag = prev[j-1] + (same ? match : mismatch);
+            int up = prev[j] + gap;
+            int left = cur[j-1] + gap;
+            int best = diag;
+            uint8_t dir = 0;
+            if (up > best) { best = up; dir = 1; }
+            if (left > best) { best = left; dir = 2; }
+            cur[j] = best;
+            trace[i * (m + 1) + j] = dir;
+        }
+        std::swap(prev, cur);
+    }
+
+    size_t i = n, j = m;
+    while (i > 0 && j > 0) {
+        uint8_t dir = trace[i * (m + 1) + j];
+        if (dir == 0) {
+            a_idx.push_back((int)i - 1);
+            b_idx.push_back((int)j - 1);
+            --i; --j;
+        }
+        else if (dir == 1) --i;
+        else --j;
+    }
+    std::reverse(a_idx.begin(), a_idx.end());
+    std::reverse(b_idx.begin(), b_idx.end());
+}
+
+void Superposer::match_residues(const CATrace& ref, const CATrace& mob,
+                                std::vector<int>& ref_idx, std::vector<int>& mob_idx) {
+    ref_idx.clear();
+    mob_idx.clear();
+
+    std::map<std::pair<std::string, int>, int> by_number;
+    for (size_t i = 0; i < ref.size(); ++i)
+        by_number.emplace(std::make_pair(ref.chain[i], ref.resnum[i]), (int)i);
+    for (size_t i = 0; i < mob.size(); ++i) {
+        auto it = by_number.find({mob.chain[i], mob.resnum[i]});
+        if (it == by_number.end()) continue;
+        ref_idx.push_back(it->second);
+        mob_idx.push_back((int)i);
+    }
+
+    size_t shorter = std::min(ref.size(), mob.size());
+    if (ref_idx.size() >= std::max<size_t>(3, shorter / 2)) return;
+
+    ref_idx.clear();
+    mob_idx.clear();
+    if ((ref.size() + 1) * (mob.size() + 1) <= max_align_cells) {
+        align_sequences(ref.seq, mob.seq, ref_idx, mob_idx);
+    } else {
+        // too large to align, pair by position
+        for (size_t i = 0; i < shorter; ++i) { ref_idx.push_back((int)i); mob_idx.push_back((int)i); }
+    }
+}
+
+// --- Kabsch (Horn's quaternion form) ---
+
+static float simd_sum(const float* a, size_t n) {
+    simd_float acc = simdf32_setzero();
+    size_t i = 0;
+    for (; i + VECSIZE_FLOAT <= n; i += VECSIZE_FLOAT)
+        acc = simdf32_add(acc, simdf32_loadu(a + i));
+    float s = simdf32_hadd(acc);
+    for (; i < n; ++i) s += a[i];
+    return s;
+}
+
+// sum over i of (a[i] - ca) * (b[i] - cb)
+static float simd_centered_dot(const float* a, float ca, const float* b, float cb, size_t n) {
+    simd_float acc = simdf32_setzero();
+    simd_float va = simdf32_set(ca), vb = simdf32_set(cb);
+    size_t i = 0;
+    for (; i + VECSIZE_FLOAT <= n; i += VECSIZE_FLOAT) {
+        simd_float da = simdf32_sub(simdf32_loadu(a + i), va);
+        simd_float db = simdf32_sub(simdf32_loadu(b + i), vb);
+        acc = simdf32_add(acc, simdf32_mul(da, db));
+    }
+    float s = simdf32_hadd(acc);
+    for (; i < n; ++i) s += (a[i] - ca) * (b[i] - cb);
+    return s;
+}
+
+// eigenvector of the largest eigenvalue of a symmetric 4x4 matrix (cyclic Jacobi)
+static double max_eigen4(double A[4][4], double v_out[4]) {
+    double V[4][4] = {{1,0,0,0},{0,1,0,0},{0,0,1,0},{0,0,0,1}};
+    for (int sweep = 0; sweep < 50; ++sweep) {
+        double off = 0.0;
+        for (int p = 0; p < 4; ++p)
+            for (int q = p + 1; q < 4; ++q) off += A[p][q] * A[p][q];
+        if (off < 1e-20) break;
+
+        for (int p = 0; p < 4; ++p) {
+            for (int q = p + 1; q < 4; ++q) {
+                if (std::fabs(A[p][q]) < 1e-30) continue;
+                double theta = (A[q][q] - A[p][p]) / (2.0 * A[p][q]);
+                double t = (theta >= 0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                double c = 1.0 / std::sqrt(t * t + 1.0), s = t * c;
+                for (int k = 0; k < 4; ++k) {
+                    double akp = A[k][p], akq = A[k][q];
+                    A[k][p] = c * akp - s * akq;
+                    A[k][q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < 4; ++k) {
+                    double apk = A[p][k], aqk = A[q][k];
+                    A[p][k] = c * apk - s * aqk;
+                    A[q][k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < 4; ++k) {
+                    double vkp = V[k][p], vkq = V[k][q];
+                    V[k][p] = c * vkp - s * vkq;
+                    V[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+    int best = 0;
+    for (int k = 1; k < 4; ++k) if (A[k][k] > A[best][best]) best = k;
+    for (int k = 0; k < 4; ++k) v_out[k] = V[k][best];
+    return A[best][best];
+}
+
+Superposition Superposer::kabsch(const float* rx, const float* ry, const float* rz,
+                                 const float* mx, const float* my, const float* mz, size_t n) {
+    Superposition sp;
+    sp.aligned = (int)n;
+    if (n == 0) return sp;
+
+    float inv = 1.0f / n;
+    float rc[3] = {simd_sum(rx, n) * inv, simd_sum(ry, n) * inv, simd_sum(rz, n) * inv};
+    float mc[3] = {simd_sum(mx, n) * inv, simd_sum(my, n) * inv, simd_sum(mz, n) * inv};
+
+    const float* M[3] = {mx, my, mz};
+    const float* R[3] = {rx, ry, rz};
+    double S[3][3];
+    double norm = 0.0;
+    for (int a = 0; a < 3; ++a) {
+        for (int b = 0; b < 3; ++b)
+            S[a][b] = simd_centered_dot(M[a], mc[a], R[b], rc[b], n);
+        norm += simd_centered_dot(M[a], mc[a], M[a], mc[a], n);
+        norm += simd_centered_dot(R[a], rc[a], R[a], rc[a], n);
+    }
+
+    double N[4][4] = {
+        {S[0][0] + S[1][1] + S[2][2], S[1][2] - S[2][1], S[2][0] - S[0][2], S[0][1] - S[1][0]},
+        {S[1][2] - S[2][1], S[0][0] - S[1][1] - S[2][2], S[0][1] + S[1][0], S[2][0] + S[0][2]},
+        {S[2][0] - S[0][2], S[0][1] + S[1][0], -S[0][0] + S[1][1] - S[2][2], S[1][2] + S[2][1]},
+        {S[0][1] - S[1][0], S[2][0] + S[0][2], S[1][2] + S[2][1], -S[0][0] - S[1][1] + S[2][2]},
+    };
+    double q[4];
+    double lambda = max_eigen4(N, q);
+
+    double q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    double rot[9] = {
+        q0*q0 + q1*q1 - q2*q2 - q3*q3, 2*(q1*q2 - q0*q3),             2*(q1*q3 + q0*q2),
+        2*(q1*q2 + q0*q3),             q0*q0 - q1*q1 + q2*q2 - q3*q3, 2*(q2*q3 - q0*q1),
+        2*(q1*q3 - q0*q2),             2*(q2*q3 + q0*q1),             q0*q0 - q1*q1 - q2*q2 + q3*q3,
+    };
+    for (int k = 0; k < 9; ++k) sp.rot[k] = (float)rot[k];
+    for (int r = 0; r < 3; ++r) {
+        sp.shift[r] = rc[r] - (sp.rot[3*r] * mc[0] + sp.rot[3*r + 1] * mc[1] + sp.rot[3*r + 2] * mc[2]);
+    }
+    sp.rmsd = (float)std::sqrt(std::max(0.0, (norm - 2.0 * lambda) / n));
+    return sp;
+}
+
+// --- Pairwise fit with outlier trimming ---
+
+Superposition Superposer::fit(const CATrace& ref, const CATrace& mob) {
+    std::vector<int> ri, mi;
+    match_residues(ref, mob, ri, mi);
+    if (ri.size() < 3) return Superposition();
+
+    std::vector<float> rx, ry, rz, mx, my, mz;
+    auto gather = [&](const std::vector<int>& r_sel, const std::vector<int>& m_sel) {
+        rx.clear(); ry.clear(); rz.clear(); mx.clear(); my.clear(); mz.clear();
+        for (size_t k = 0; k < r_sel.size(); ++k) {
+            rx.push_back(ref.x[r_sel[k]]); ry.push_back(ref.y[r_sel[k]]); rz.push_back(ref.z[r_sel[k]]);
+            mx.push_back(mob.x[m_sel[k]]); my.push_back(mob.y[m_sel[k]]); mz.push_back(mob.z[m_sel[k]]);
+        }
+    };
+
+    gather(ri, mi);
+    Superposition sp = kabsch(rx.data(), ry.data(), rz.data(), mx.data(), my.data(), mz.data(), rx.size());
+
+    // refit on the pairs that already agree, so flexible loops don't drag the core
+    size_t min_keep = std::max<size_t>(3, ri.size() * 3 / 10);
+    for (int round = 0; round < refine_rounds; ++round) {
+        std::vector<int> r_keep, m_keep;
+        float cut2 = refine_cutoff * refine_cutoff;
+        for (size_t k = 0; k < ri.size(); ++k) {
+            float x = mob.x[mi[k]], y = mob.y[mi[k]], z = mob.z[mi[k]];
+            float tx = sp.rot[0]*x + sp.rot[1]*y + sp.rot[2]*z + sp.shift[0] - ref.x[ri[k]];
+            float ty = sp.rot[3]*x + sp.rot[4]*y + sp.rot[5]*z + sp.shift[1] - ref.y[ri[k]];
+            float tz = sp.rot[6]*x + sp.rot[7]*y + sp.rot[8]*z + sp.shift[2] - ref.z[ri[k]];
+            if (tx*tx + ty*ty + tz*tz < cut2) { r_keep.push_back(ri[k]); m_keep.push_back(mi[k]); }
+        }
+        if (r_keep.size() < min_keep || r_keep.size() == (size_t)sp.aligned) break;
+        gather(r_keep, m_keep);
+        sp = kabsch(rx.data(), ry.data(), rz.data(), mx.data(), my.data(), mz.data(), rx.size());
+    }
+    return sp;
+}
+
+std::vector<Superposition> Superposer::superpose_all(const std::vector<CATrace>& traces, size_t ref) {
+    std::vector<Superposition> result(traces.size());
+    if (ref >= traces.size()) return result;
+
+    parallel_for(traces.size(), [&](size_t i) {
+        if (i == ref) return;
+        result[i] = fit(traces[ref], traces[i]);
+    });
+    return result;
+}
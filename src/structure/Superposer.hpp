@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// CA coordinates in SoA layout with what is needed to pair residues.
+struct CATrace {
+    std::vector<float> x, y, z;
+    std::vector<int> resnum;
+    std::vector<std::string> chain;
+    std::string seq;            // one-letter codes, 'X' if unknown
+
+    size_t size() const { return x.size(); }
+    void push_back(float x_, float y_, float z_, int resnum_, const std::string& chain_, char aa) {
+        x.push_back(x_); y.push_back(y_); z.push_back(z_);
+        resnum.push_back(resnum_);
+        chain.push_back(chain_);
+        seq.push_back(aa);
+    }
+};
+
+// x' = rot * x + shift moves the mobile structure onto the reference
+struct Superposition {
+    float rot[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+    float shift[3] = {0, 0, 0};
+    float rmsd = 0.0f;
+    int aligned = 0;
+};
+
+class Superposer {
+public:
+    // Pairs residues by (chain, number); falls back to a global sequence
+    // alignment when numbering does not line up.
+    void match_residues(const CATrace& ref, const CATrace& mob,
+                        std::vector<int>& ref_idx, std::vector<int>& mob_idx);
+
+    // Least-squares fit of mob onto ref over paired CA positions.
+    static Superposition kabsch(const float* rx, const float* ry, const float* rz,
+                                const float* mx, const float* my, const float* mz, size_t n);
+
+    // Fit every trace onto traces[ref], pairs run in parallel.
+    std::vector<Superposition> superpose_all(const std::vector<CATrace>& traces, size_t ref = 0);
+
+    static char one_letter(const std::string& resname);
+
+    int refine_rounds = 3;
+    float refine_cutoff = 4.0f;     // Angstrom, pairs beyond this are dropped when refining
+    size_t max_align_cells = 25000000;
+
+private:
+    static void align_sequences(const std::string& a, const std::string& b,
+                                std::vector<int>& a_idx, std::vector<int>& b_idx);
+    Superposition fit(const CATrace& ref, const CATrace& mob);
+};
@@ -0,0 +1,153 @@
+#include "SurfaceBuilder.hpp"
+#include "Parallel.hpp"
+#include "CellList.hpp"
+#include "MarchingTets.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+struct MeshPart {
+    std::vector<float> x, y, z;
+    std::vector<uint32_t> tris;
+};
+
+} // namespace
+
+bool SurfaceBuilder::build(const std::vector<float>& ax, const std::vector<float>& ay, const std::vector<float>& az,
+                           SurfaceMesh& mesh, const std::atomic<bool>* cancel) {
+    const size_t n_atoms = ax.size();
+    if (n_atoms == 0) return false;
+    auto cancelled = [&]() { return cancel && cancel->load(std::memory_order_relaxed); };
+
+    const float sas_r = atom_radius + probe_radius;
+
+    // --- grid ---
+    float lo[3] = {*std::min_element(ax.begin(), ax.end()), *std::min_element(ay.begin(), ay.end()),
+                   *std::min_element(az.begin(), az.end())};
+    float hi[3] = {*std::max_element(ax.begin(), ax.end()), *std::max_element(ay.begin(), ay.end()),
+                   *std::max_element(az.begin(), az.end())};
+    float h = spacing;
+    int dim[3];
+    for (int pass = 0; pass < 2; pass++) {
+        float margin = sas_r + 2.0f * h;
+        for (int a = 0; a < 3; a++) dim[a] = (int)std::ceil((hi[a] - lo[a] + 2.0f * margin) / h) + 1;
+        double cells = (double)dim[0] * dim[1] * dim[2];
+        if (cells <= (double)max_cells) break;
+        h *= (float)std::cbrt(cells / max_cells) * 1.01f;
+    }
+    const float margin = sas_r + 2.0f * h;
+    const float org[3] = {lo[0] - margin, lo[1] - margin, lo[2] - margin};
+    const int nx = dim[0], ny = dim[1], nz = dim[2];
+    const size_t plane = (size_t)nx * ny;
+    auto gidx = [&](int i, int j, int k) { return (size_t)k * plane + (size_t)j * nx + i; };
+
+    CellList atoms;
+    atoms.build(ax.data(), ay.data(), az.data(), n_atoms, sas_r);
+
+    // --- solvent-accessible region ---
+    std::vector<uint8_t> inside(plane * nz, 0);
+    parallel_for(nz, [&](size_t k) {
+        if (cancelled()) return;
+        float pz = org[2] + k * h;
+        for (int j = 0; j < ny; j++) {
+            float py = org[1] + j * h;
+            for (int i = 0; i < nx; i++) {
+                float px = org[0] + i * h;
+                bool in = false;
+                atoms.for_near(px, py, pz, [&](int a) {
+                    float dx = ax[a] - px, dy = ay[a] - py, dz = az[a] - pz;
+                    in |= dx * dx + dy * dy + dz * dz < sas_r * sas_r;
+                });
+                inside[gidx(i, j, (int)k)] = in;
+            }
+        }
+    });
+    if (cancelled()) return false;
+
+    // --- erosion: distance from inside points to the exterior boundary ---
+    std::vector<std::vector<int>> boundary(nz);   // (j * nx + i) per plane
+    parallel_for(nz, [&](size_t k) {
+        for (int j = 0; j < ny; j++)
+            for (int i = 0; i < nx; i++) {
+                if (inside[gidx(i, j, (int)k)]) continue;
+                bool edge = (i > 0 && inside[gidx(i - 1, j, k)]) || (i + 1 < nx && inside[gidx(i + 1, j, k)]) ||
+                            (j > 0 && inside[gidx(i, j - 1, k)]) || (j + 1 < ny && inside[gidx(i, j + 1, k)]) ||
+                            (k > 0 && inside[gidx(i, j, k - 1)]) || (k + 1 < (size_t)nz && inside[gidx(i, j, k + 1)]);
+                if (edge) boundary[k].push_back(j * nx + i);
+            }
+    });
+
+    const float cap = probe_radius + h;
+    const int reach = (int)std::ceil(cap / h);
+    std::vector<float> field(plane * nz, -h);
+    parallel_for(nz, [&](size_t k) {
+        if (cancelled()) return;
+        float* f = &field[k * plane];
+        const uint8_t* in = &inside[k * plane];
+        std::vector<float> d2(plane, cap * cap);
+        for (int kb = std::max<int>(0, (int)k - reach); kb <= std::min(nz - 1, (int)k + reach); kb++) {
+            float dz = (kb - (int)k) * h;
+            for (int b : boundary[kb]) {
+                int bi = b % nx, bj = b / nx;
+                for (int j = std::max(0, bj - reach); j <= std::min(ny - 1, bj + reach); j++) {
+                    float dy = (j - bj) * h;
+                    for (int i = std::max(0, bi - reach); i <= std::min(nx - 1, bi + reach); i++) {
+                        float dx = (i - bi) * h;
+                        float& d = d2[j * nx + i];
+                        d = std::min(d, dx * dx + dy * dy + dz * dz);
+                    }
+                }
+            }
+        }
+        for (size_t p = 0; p < plane; p++)
+            if (in[p]) f[p] = std::sqrt(d2[p]) - probe_radius;
+    });
+    if (cancelled()) return false;
+
+    // --- marching tetrahedra, slabs of cubes in parallel ---
+    const int slab = 4;
+    const int n_slabs = (nz - 1 + slab - 1) / slab;
+    std::vector<MeshPart> parts(n_slabs);
+    parallel_for(n_slabs, [&](size_t s) {
+        if (cancelled()) return;
+        MeshPart& part = parts[s];
+        auto vertex = [&](size_t a, size_t b, float t) -> uint32_t {
+            int ai = a % nx, aj = (a / nx) % ny, ak = a / plane;
+            int bi = b % nx, bj = (b / nx) % ny, bk = b / plane;
+            part.x.push_back(org[0] + (ai + t * (bi - ai)) * h);
+            part.y.push_back(org[1] + (aj + t * (bj - aj)) * h);
+            part.z.push_back(org[2] + (ak + t * (bk - ak)) * h);
+            return (uint32_t)part.x.size() - 1;
+        };
+        march_tetrahedra(nx, ny, (int)s * slab, std::min(nz - 1, ((int)s + 1) * slab),
+                         [&](size_t g) { return field[g]; }, vertex, part.tris);
+    });
+    if (cancelled()) return false;
+
+    // --- merge; vertices on slab borders are duplicated, which is harmless here ---
+    mesh = SurfaceMesh();
+    for (MeshPart& part : parts) {
+        uint32_t base = (uint32_t)mesh.x.size();
+        mesh.x.insert(mesh.x.end(), part.x.begin(), part.x.end());
+        mesh.y.insert(mesh.y.end(), part.y.begin(), part.y.end());
+        mesh.z.insert(mesh.z.end(), part.z.begin(), part.z.end());
+        for (uint32_t v : part.tris) mesh.tris.push_back(base + v);
+        part = MeshPart();
+    }
+
+    mesh.atom.assign(mesh.x.size(), 0);
+    parallel_for((mesh.x.size() + 4095) / 4096, [&](size_t blk) {
+        for (size_t v = blk * 4096; v < std::min(mesh.x.size(), (blk + 1) * 4096); v++) {
+            float best = std::numeric_limits<float>::max();
+            atoms.for_near(mesh.x[v], mesh.y[v], mesh.z[v], [&](int a) {
+                float dx = ax[a] - mesh.x[v], dy = ay[a] - mesh.y[v], dz = az[a] - mesh.z[v];
+                float d = dx * dx + dy * dy + dz * dz;
+                if (d < best) { best = d; mesh.atom[v] = a; }
+            });
+        }
+    });
+    return !cancelled() && !mesh.tris.empty();
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Triangle mesh of a molecular surface, in the frame of the input atoms.
+struct SurfaceMesh {
+    std::vector<float> x, y, z;
+    std::vector<int> atom;          // nearest input atom per vertex, for coloring
+    std::vector<uint32_t> tris;     // three vertex indices per triangle, winding is not consistent
+
+    size_t num_vertices() const { return x.size(); }
+    size_t num_triangles() const { return tris.size() / 3; }
+};
+
+// Solvent-excluded surface on a distance grid: the solvent-accessible region
+// (atom radius + probe) is eroded by the probe radius and the zero level is
+// triangulated with marching cubes, each cube split into six tetrahedra.
+class SurfaceBuilder {
+public:
+    // false when cancelled or when there is nothing to mesh
+    bool build(const std::vector<float>& ax, const std::vector<float>& ay, const std::vector<float>& az,
+               SurfaceMesh& mesh, const std::atomic<bool>* cancel = nullptr);
+
+    float atom_radius = 3.0f;       // CA pseudo-atom standing in for the whole residue
+    float probe_radius = 1.4f;
+    float spacing = 1.0f;           // Angstrom, coarsened so the grid stays under max_cells
+    size_t max_cells = 4000000;
+};
@@ -0,0 +1,69 @@
+#include "FrameArena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+FrameArena::FrameArena(size_t initial) {
+    cap = std::max<size_t>(initial, 4096);
+    block = static_cast<char*>(::operator new(cap));
+}
+
+FrameArena::~FrameArena() {
+    for (char* b : spill) ::operator delete(b);
+    ::operator delete(block);
+}
+
+void FrameArena::reset() {
+    if (!spill.empty()) {
+        // everything this frame took, with room for the next one to grow
+        size_t need = top + spilled;
+        for (char* b : spill) ::operator delete(b);
+        spill.clear();
+        ::operator delete(block);
+        cap = need + need / 2;
+        block = static_cast<char*>(::operator new(cap));
+    }
+    top = 0;
+    spilled = 0;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t align) {
+    uintptr_t base = reinterpret_cast<uintptr_t>(block);
+    size_t at = ((base + top + align - 1) & ~(uintptr_t)(align - 1)) - base;
+    if (at + bytes <= cap) {
+        top = at + bytes;
+        return block + at;
+    }
+    // operator new only aligns for the fundamental types; room for any
+    // stricter alignment is taken from the block itself
+    size_t space = bytes + align;
+    char* b = static_cast<char*>(::operator new(space));
+    spill.push_back(b);
+    spilled += space;
+    void* p = b;
+    return std::align(align, bytes, p, space);
+}
+
+#ifdef PDBTERM_COUNT_ALLOCS
+// per thread: a build running in the background must not show up in the
+// frame that happens to be drawn meanwhile
+static thread_local size_t n_allocs = 0;
+
+void* operator new(size_t n) {
+    n_allocs++;
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+size_t heap_allocations() { return n_allocs; }
+#else
+size_t heap_allocations() { return 0; }
+#endif
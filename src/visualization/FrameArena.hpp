@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for the scratch data of one frame. It is a memory resource,
+// so frame-local containers are std::pmr ones pointing at it and allocate by
+// moving a pointer; nothing is freed until reset() rewinds to the start at
+// the next frame. A frame that outgrows the block spills into blocks of its
+// own, which the next reset trades for one block as large as that frame
+// needed: after the first frames the frame loop stops touching the heap.
+class FrameArena : public std::pmr::memory_resource {
+public:
+    explicit FrameArena(size_t initial = 1 << 20);
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+    ~FrameArena();
+
+    void reset();
+    size_t capacity() const { return cap; }
+    size_t used() const { return top + spilled; }
+
+private:
+    void* do_allocate(size_t bytes, size_t align) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    char* block = nullptr;
+    size_t cap = 0, top = 0;
+    std::vector<char*> spill;       // this frame's extra blocks
+    size_t spilled = 0;             // bytes handed out from them
+};
+
+// Heap allocations the calling thread has made so far. Counted only when
+// built with PDBTERM_COUNT_ALLOCS, which replaces the global operator new; 0
+// otherwise.
+size_t heap_allocations();
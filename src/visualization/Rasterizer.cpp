@@ -0,0 +1,645 @@
+#include "Rasterizer.hpp"
+#include "Parallel.hpp"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <type_traits>
+
+// braille dot of pixel (x, y) within its cell, by y & 3 and x & 1
+static const uint8_t DOT[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+
+// Shading input of a pixel: PALETTE plus the index of a color in shades, or a
+// triangle's weights w0 and w1 as two 15-bit fractions
+static const uint32_t PALETTE = 0x80000000u;
+
+static inline uint32_t pack_weights(float w0, float w1) {
+    return (uint32_t)(std::min(w0, 1.0f) * 32767.0f + 0.5f) | ((uint32_t)(std::min(w1, 1.0f) * 32767.0f + 0.5f) << 15);
+}
+
+void Rasterizer::resize(int width, int height, Target target) {
+    w = std::max(0, width);
+    h = std::max(0, height);
+    tgt = target;
+    pw = (tgt == Target::BRAILLE) ? (w + 1) / 2 : w;
+    ph = (tgt == Target::BRAILLE) ? (h + 3) / 4 : h;
+    tiles_x = (w + TILE - 1) / TILE;
+    tiles_y = (h + TILE - 1) / TILE;
+    rgba.assign((size_t)pw * ph, 0);
+    zbuf.assign((size_t)pw * ph, EMPTY);
+    primbuf.assign((size_t)pw * ph, 0);
+    dot_mask.assign((tgt == Target::BRAILLE) ? (size_t)pw * ph : 0, 0);
+    bins.assign((size_t)tiles_x * tiles_y, {});
+    hz_x = (w + HZ - 1) / HZ;
+    hz.assign((size_t)hz_x * ((h + HZ - 1) / HZ), EMPTY);
+    hz_stale.assign(hz.size(), 0);
+    cmds.clear();
+    flushed = 0;
+    shades.clear();
+    tri.clear();
+}
+
+void Rasterizer::clear() {
+    std::fill(zbuf.begin(), zbuf.end(), EMPTY);
+    std::fill(dot_mask.begin(), dot_mask.end(), 0);
+    std::fill(hz.begin(), hz.end(), EMPTY);
+    std::fill(hz_stale.begin(), hz_stale.end(), 0);
+    cmds.clear();
+    flushed = 0;
+    shades.clear();
+    tri.clear();
+}
+
+RGB Rasterizer::depth_shade(RGB color, float brightness, float occlusion) {
+    // occlusion is precomputed per residue, it darkens below the depth-cue floor
+    brightness = std::clamp(brightness, 0.45f, 1.0f) * occlusion;
+    return {
+        (uint8_t)(color.r * brightness),
+        (uint8_t)(color.g * brightness),
+        (uint8_t)(color.b * brightness),
+    };
+}
+
+uint32_t Rasterizer::id_at(int x, int y) const {
+    if (x < 0 || x >= w || y < 0 || y >= h) return NO_ID;
+    size_t i = (tgt == Target::BRAILLE) ? (size_t)(y >> 2) * pw + (x >> 1) : (size_t)y * w + x;
+    return zbuf[i] != EMPTY ? cmds[primbuf[i]].id : NO_ID;
+}
+
+// --- Recording ---
+
+// A point, line or disc takes one of a few colors, one per halo ring or rim
+// falloff, so they are shaded here once and its pixels only name one.
+void Rasterizer::record(Cmd c) {
+    if (c.bx1 < 0 || c.by1 < 0 || c.bx0 >= w || c.by0 >= h) return;
+    c.shade = (uint32_t)shades.size();
+    switch (c.kind) {
+        case Cmd::POINT:
+            shades.push_back(pack(depth_shade(c.color, c.brightness, c.occlusion)));
+            break;
+        case Cmd::LINE:
+            for (int t = 0; t <= c.thick; t++)
+                shades.push_back(pack(depth_shade(c.color, c.brightness * (1.0f - 0.25f * t), c.occlusion)));
+            break;
+        case Cmd::CIRCLE:
+            for (float f : stamps[c.x1].levels)
+                shades.push_back(pack(depth_shade(c.color, c.brightness * f, c.occlusion)));
+            break;
+        case Cmd::TRIANGLE: break;
+    }
+    cmds.push_back(c);
+}
+
+void Rasterizer::point(int x, int y, float z, RGB color, float brightness, float occlusion, uint32_t id) {
+    record({Cmd::POINT, x, y, x, y, z, z, 0, color, brightness, occlusion, id, x, y, x, y, z});
+}
+
+void Rasterizer::line(int x0, int y0, float z0, int x1, int y1, float z1, int thick,
+                      RGB color, float brightness, float occlusion, uint32_t id) {
+    thick = std::clamp(thick, 0, MAX_THICK);
+    // the halo and the end caps reach thick pixels past the center line
+    record({Cmd::LINE, x0, y0, x1, y1, z0, z1, thick, color, brightness, occlusion, id,
+            std::min(x0, x1) - thick, std::min(y0, y1) - thick, std::max(x0, x1) + thick, std::max(y0, y1) + thick,
+            std::min(z0, z1)});
+}
+
+void Rasterizer::circle(int cx, int cy, float z, int radius, RGB color, float brightness, float occlusion,
+                        uint32_t id) {
+    if (radius < 0) return;
+    stamp(radius);      // built here, tiles only read it
+    record({Cmd::CIRCLE, cx, cy, radius, 0, z, z, 0, color, brightness, occlusion, id,
+            cx - radius, cy - radius, cx + radius, cy + radius, z});
+}
+
+void Rasterizer::triangle(const RasterVertex& v0, const RasterVertex& v1, const RasterVertex& v2, uint32_t id) {
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (fabsf(area) < 1e-6f) return;
+    size_t n = cmds.size();
+    record({Cmd::TRIANGLE, (int)tri.size(), 0, 0, 0, 0.0f, 0.0f, 0, {0, 0, 0}, 0.0f, 0.0f, id,
+            (int)floorf(std::min({v0.x, v1.x, v2.x})), (int)floorf(std::min({v0.y, v1.y, v2.y})),
+            (int)ceilf(std::max({v0.x, v1.x, v2.x})), (int)ceilf(std::max({v0.y, v1.y, v2.y})),
+            std::min({v0.z, v1.z, v2.z})});
+    if (cmds.size() > n) { tri.push_back(v0); tri.push_back(v1); tri.push_back(v2); }
+}
+
+// --- Binning ---
+
+// Adds command c to every tile its box touches. Lines crossing several
+// tiles both ways skip the tiles their band misses.
+void Rasterizer::bin(uint32_t c) {
+    const Cmd& cmd = cmds[c];
+    int x0 = std::max(cmd.bx0, 0), y0 = std::max(cmd.by0, 0);
+    int x1 = std::min(cmd.bx1, w - 1), y1 = std::min(cmd.by1, h - 1);
+    if (x0 > x1 || y0 > y1) return;
+    int tx0 = x0 / TILE, tx1 = x1 / TILE, ty0 = y0 / TILE, ty1 = y1 / TILE;
+
+    bool band = cmd.kind == Cmd::LINE && tx0 != tx1 && ty0 != ty1;
+    // line through (x0, y0) and (x1, y1): a * x + b * y = d, and its half width
+    float a = (float)(cmd.y1 - cmd.y0), b = (float)(cmd.x0 - cmd.x1);
+    float d = a * cmd.x0 + b * cmd.y0;
+    float reach = (cmd.thick + 2.0f) * (fabsf(a) + fabsf(b));   // halo plus rounding
+
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            if (band) {
+                // distance of the tile corners from the line, in units of |a| + |b|
+                float lo = 1e30f, hi = -1e30f;
+                for (int k = 0; k < 4; k++) {
+                    float px = (float)(tx * TILE + ((k & 1) ? TILE - 1 : 0));
+                    float py = (float)(ty * TILE + ((k & 2) ? TILE - 1 : 0));
+                    float s = a * px + b * py - d;
+                    lo = std::min(lo, s); hi = std::max(hi, s);
+                }
+                if (lo > reach || hi < -reach) continue;
+            }
+            bins[(size_t)ty * tiles_x + tx].push_back(c);
+        }
+    }
+}
+
+void Rasterizer::flush(bool tiled) {
+    last_stats = Stats();
+    last_stats.primitives = cmds.size() - flushed;
+    if (cmds.size() == flushed) return;
+
+    if (tgt == Target::BRAILLE) draw<Target::BRAILLE>(tiled);
+    else                        draw<Target::PIXELS>(tiled);
+    flushed = cmds.size();
+}
+
+template <Rasterizer::Target T>
+void Rasterizer::draw(bool tiled) {
+    passes.clear();
+    if (!tiled || bins.size() <= 1) {
+        passes.push_back({0, 0, w - 1, h - 1});
+        for (uint32_t k = (uint32_t)flushed; k < (uint32_t)cmds.size(); k++) run<T>(k, passes[0]);
+        last_stats.covered = shade<T>(passes[0]);
+    } else {
+        for (auto& b : bins) b.clear();
+        for (uint32_t i = (uint32_t)flushed; i < (uint32_t)cmds.size(); i++) bin(i);
+
+        busy.clear();
+        for (uint32_t t = 0; t < (uint32_t)bins.size(); t++)
+            if (!bins[t].empty()) busy.push_back(t);
+        passes.resize(busy.size(), {0, 0, 0, 0});
+        tile_covered.assign(busy.size(), 0);
+        parallel_for(busy.size(), [&](size_t k) {
+            uint32_t t = busy[k];
+            int tx = (int)(t % tiles_x), ty = (int)(t / tiles_x);
+            Clip& clip = passes[k];
+            clip = {tx * TILE, ty * TILE, std::min(w, (tx + 1) * TILE) - 1, std::min(h, (ty + 1) * TILE) - 1};
+            for (uint32_t c : bins[t]) run<T>(c, clip);
+            // every primitive of the tile is in, so each pixel is shaded once
+            tile_covered[k] = shade<T>(clip);
+        });
+        for (size_t n : tile_covered) last_stats.covered += n;
+    }
+    for (const Clip& p : passes) {
+        last_stats.drawn += p.drawn;
+        last_stats.culled += p.culled;
+        last_stats.written += p.written;
+    }
+}
+
+// --- Block depths ---
+
+bool Rasterizer::occluded(const Cmd& c, const Clip& clip) {
+    int x0 = std::max(c.bx0, clip.x0), x1 = std::min(c.bx1, clip.x1);
+    int y0 = std::max(c.by0, clip.y0), y1 = std::min(c.by1, clip.y1);
+    if (x0 > x1 || y0 > y1) return false;
+    // interpolated depths may round a hair below the nearest vertex
+    const float near = c.near - 0.001f;
+    for (int by = y0 / HZ; by <= y1 / HZ; by++) {
+        for (int bx = x0 / HZ; bx <= x1 / HZ; bx++) {
+            size_t b = (size_t)by * hz_x + bx;
+            if (hz_stale[b]) {
+                hz[b] = block_far(bx, by);
+                hz_stale[b] = 0;
+            }
+            // the per-pixel test, against the farthest pixel of the block
+            if (!(near > hz[b] + 0.01f)) return false;
+        }
+    }
+    return true;
+}
+
+float Rasterizer::block_far(int bx, int by) const {
+    float far = -EMPTY;
+    if (tgt == Target::BRAILLE) {
+        // a cell still missing dots takes any primitive over it
+        const int cw = HZ / 2, ch = HZ / 4;
+        for (int y = by * ch; y < std::min(ph, (by + 1) * ch); y++)
+            for (int x = bx * cw; x < std::min(pw, (bx + 1) * cw); x++) {
+                size_t i = (size_t)y * pw + x;
+                far = std::max(far, dot_mask[i] == 0xFF ? zbuf[i] : EMPTY);
+            }
+        return far;
+    }
+    for (int y = by * HZ; y < std::min(h, (by + 1) * HZ); y++) {
+        const float* zp = &zbuf[(size_t)y * w];
+        for (int x = bx * HZ; x < std::min(w, (bx + 1) * HZ); x++) far = std::max(far, zp[x]);
+    }
+    return far;
+}
+
+void Rasterizer::touch(const Cmd& c, const Clip& clip) {
+    int x0 = std::max(c.bx0, clip.x0), x1 = std::min(c.bx1, clip.x1);
+    int y0 = std::max(c.by0, clip.y0), y1 = std::min(c.by1, clip.y1);
+    if (x0 > x1 || y0 > y1) return;
+    for (int by = y0 / HZ; by <= y1 / HZ; by++)
+        std::fill(&hz_stale[(size_t)by * hz_x + x0 / HZ], &hz_stale[(size_t)by * hz_x + x1 / HZ] + 1, 1);
+}
+
+// --- Rasterization, limited to one clip rectangle ---
+
+template <Rasterizer::Target T>
+void Rasterizer::run(uint32_t k, Clip& clip) {
+    const Cmd& c = cmds[k];
+    // a point costs no more than its own test
+    if (c.kind != Cmd::POINT && occluded(c, clip)) { clip.culled++; return; }
+    clip.drawn++;
+    switch (c.kind) {
+        case Cmd::POINT:    plot<T>(clip, c.x0, c.y0, c.z0, {k, PALETTE | c.shade}); break;
+        case Cmd::LINE:     run_line<T>(k, clip); break;
+        case Cmd::CIRCLE:   run_circle<T>(k, clip); break;
+        case Cmd::TRIANGLE: run_triangle<T>(k, clip); break;
+    }
+    touch(c, clip);
+}
+
+template <Rasterizer::Target T>
+void Rasterizer::plot(Clip& clip, int x, int y, float z, Frag f) {
+    if (x < clip.x0 || x > clip.x1 || y < clip.y0 || y > clip.y1) return;
+    if constexpr (T == Target::BRAILLE) {
+        clip.written += dot_span(y, x, x, f, [z](int) { return z; });
+    } else {
+        size_t i = (size_t)y * w + x;
+        if (z > zbuf[i] + 0.01f) return;      // never true over EMPTY
+
+        zbuf[i] = z;
+        primbuf[i] = f.prim;
+        rgba[i] = f.in;
+        clip.written++;
+    }
+}
+
+// Integer DDA: the minor coordinate of step i is round(i * minor / steps),
+// taken in closed form, so a tile starting mid-line lands on the same
+// pixels. Each run of steps sharing a minor coordinate becomes 2 thick + 1
+// spans across the line, one color per halo ring, and the ends
+// get the halo along the line as caps. No pixel is written twice by one line.
+template <Rasterizer::Target T>
+void Rasterizer::run_line(uint32_t k, Clip& clip) {
+    const Cmd& c = cmds[k];
+    int dx = c.x1 - c.x0;
+    int dy = c.y1 - c.y0;
+    int steps = std::max(abs(dx), abs(dy));
+
+    const int thick = c.thick;
+    uint32_t ring[MAX_THICK + 1];
+    for (int t = 0; t <= thick; t++) ring[t] = PALETTE | (c.shade + t);
+    if (steps == 0) { plot<T>(clip, c.x0, c.y0, c.z0, {k, ring[0]}); return; }
+    float zInc = (c.z1 - c.z0) / steps;
+
+    // the major axis moves one pixel per step, so the steps that can reach
+    // the clip rectangle follow from it directly
+    bool x_major = abs(dx) >= abs(dy);
+    int major0 = x_major ? c.x0 : c.y0, minor0 = x_major ? c.y0 : c.x0;
+    int dir = (x_major ? dx : dy) > 0 ? 1 : -1;
+    int side = (x_major ? dy : dx) >= 0 ? 1 : -1;
+    int64_t minor = x_major ? abs(dy) : abs(dx);
+    int lo = (x_major ? clip.x0 : clip.y0) - thick, hi = (x_major ? clip.x1 : clip.y1) + thick;
+    int first = 0, last = steps;
+    if (dir > 0) { first = std::max(first, lo - major0); last = std::min(last, hi - major0); }
+    else         { first = std::max(first, major0 - hi); last = std::min(last, major0 - lo); }
+
+    const int64_t two_steps = 2 * (int64_t)steps;
+    size_t written = 0;
+    for (int i = first; i <= last;) {
+        int64_t q = (2 * (int64_t)i * minor + steps) / two_steps;
+        // last step still rounding to q
+        int end = minor ? (int)std::min<int64_t>(last, (two_steps * q + steps - 1) / (2 * minor)) : last;
+        int m = minor0 + side * (int)q;
+        if (x_major) {
+            // one span per halo row, depth along it from the step index
+            int x_a = std::max(clip.x0, std::min(c.x0 + dir * i, c.x0 + dir * end));
+            int x_b = std::min(clip.x1, std::max(c.x0 + dir * i, c.x0 + dir * end));
+            for (int y = std::max(clip.y0, m - thick); y <= std::min(clip.y1, m + thick); y++) {
+                const uint32_t fade = ring[abs(y - m)];
+                if constexpr (T == Target::BRAILLE) {
+                    written += dot_span(y, x_a, x_b, {k, fade},
+                                        [&](int x) { return c.z0 + zInc * (float)((x - c.x0) * dir); });
+                    continue;
+                }
+                float* zp = &zbuf[(size_t)y * w];
+                uint32_t* pp = &primbuf[(size_t)y * w];
+                uint32_t* ip = &rgba[(size_t)y * w];
+                for (int x = x_a; x <= x_b; x++) {
+                    float z = c.z0 + zInc * (float)((x - c.x0) * dir);
+                    if (z > zp[x] + 0.01f) continue;
+                    zp[x] = z;
+                    pp[x] = k;
+                    ip[x] = fade;
+                    written++;
+                }
+            }
+        } else {
+            // one span per step, across the line at that step's depth
+            int x_a = std::max(clip.x0, m - thick), x_b = std::min(clip.x1, m + thick);
+            for (int step = i; step <= end; step++) {
+                int y = c.y0 + dir * step;
+                if (y < clip.y0 || y > clip.y1) continue;
+                float z = c.z0 + zInc * (float)step;
+                if constexpr (T == Target::BRAILLE) {
+                    for (int x = x_a; x <= x_b; x++)
+                        written += dot_span(y, x, x, {k, ring[abs(x - m)]}, [z](int) { return z; });
+                    continue;
+                }
+                float* zp = &zbuf[(size_t)y * w];
+                uint32_t* pp = &primbuf[(size_t)y * w];
+                uint32_t* ip = &rgba[(size_t)y * w];
+                for (int x = x_a; x <= x_b; x++) {
+                    if (z > zp[x] + 0.01f) continue;
+                    zp[x] = z;
+                    pp[x] = k;
+                    ip[x] = ring[abs(x - m)];
+                    written++;
+                }
+            }
+        }
+        i = end + 1;
+    }
+    clip.written += written;
+
+    for (int t = 1; t <= thick; t++) {
+        int sx = x_major ? dir * t : 0, sy = x_major ? 0 : dir * t;
+        plot<T>(clip, c.x0 - sx, c.y0 - sy, c.z0, {k, ring[t]});
+        plot<T>(clip, c.x1 + sx, c.y1 + sy, c.z0 + zInc * steps, {k, ring[t]});
+    }
+}
+
+const Rasterizer::Stamp& Rasterizer::stamp(int radius) {
+    if (radius >= (int)stamps.size()) stamps.resize(radius + 1);
+    Stamp& s = stamps[radius];
+    if (!s.rows.empty()) return s;
+
+    const int size = 2 * radius + 1;
+    s.rows.resize(size);
+    s.level.assign((size_t)size * size, 0);
+    s.levels.assign(1, 1.0f);
+    for (int dy = -radius; dy <= radius; dy++) {
+        Stamp::Row& row = s.rows[dy + radius];
+        row = {radius + 1, -radius - 1, radius + 1, -radius - 1};
+        for (int dx = -radius; dx <= radius; dx++) {
+            float dist = sqrtf((float)(dx * dx + dy * dy));
+            if (dist > radius) continue;
+            float edge = 1.0f - std::max(0.0f, (dist - radius + 1.5f) / 1.5f);
+            size_t l = std::find(s.levels.begin(), s.levels.end(), edge) - s.levels.begin();
+            if (l == s.levels.size()) s.levels.push_back(edge);
+            s.level[(size_t)(dy + radius) * size + dx + radius] = (uint16_t)l;
+            row.lo = std::min(row.lo, dx); row.hi = std::max(row.hi, dx);
+            if (edge == 1.0f) { row.inner_lo = std::min(row.inner_lo, dx); row.inner_hi = std::max(row.inner_hi, dx); }
+        }
+    }
+    return s;
+}
+
+int Rasterizer::fill_span(size_t i, int n, float z, Frag f) {
+    float* zp = &zbuf[i];
+    uint32_t* pp = &primbuf[i];
+    uint32_t* ip = &rgba[i];
+    int k = 0, kept = 0;
+    const simd_float zv = simdf32_set(z);
+    const simd_float eps = simdf32_set(0.01f);
+    const simd_int pv = simdi32_set((int)f.prim);
+    const simd_int iv = simdi32_set((int)f.in);
+    for (; k + (int)VECSIZE_FLOAT <= n; k += VECSIZE_FLOAT) {
+        simd_float old = simdf32_loadu(zp + k);
+        // lanes keeping the old pixel, the negation of the scalar test below
+        simd_int keep = simdf_f2icast(simdf32_gt(zv, simdf32_add(old, eps)));
+        simdf32_storeu(zp + k, simdi_i2fcast(simdi8_blend(simdf_f2icast(zv), simdf_f2icast(old), keep)));
+        simd_int* pq = (simd_int*)(pp + k);
+        simdi_storeu(pq, simdi8_blend(pv, simdi_loadu(pq), keep));
+        simd_int* iq = (simd_int*)(ip + k);
+        simdi_storeu(iq, simdi8_blend(iv, simdi_loadu(iq), keep));
+        kept += __builtin_popcount((unsigned)simdi8_movemask(keep)) / 4;
+    }
+    for (; k < n; k++) {
+        if (z > zp[k] + 0.01f) { kept++; continue; }
+        zp[k] = z;
+        pp[k] = f.prim;
+        ip[k] = f.in;
+    }
+    return n - kept;
+}
+
+// A cell row is written once per span: the dots the span covers are or-ed
+// in, and the nearer of its depths goes through the depth test.
+template <class Depth>
+int Rasterizer::dot_span(int y, int x0, int x1, Frag f, Depth z_at) {
+    // a clipped line span can come out empty; it must not reach the last cell
+    if (x0 > x1) return 0;
+    const uint8_t left = DOT[y & 3][0], right = DOT[y & 3][1];
+    const size_t row = (size_t)(y >> 2) * pw;
+    uint8_t* mp = &dot_mask[row];
+    float* zp = &zbuf[row];
+    uint32_t* pp = &primbuf[row];
+    uint32_t* ip = &rgba[row];
+    int written = 0;
+    for (int cx = x0 >> 1; cx <= x1 >> 1; cx++) {
+        int a = std::max(x0, 2 * cx), b = std::min(x1, 2 * cx + 1);
+        mp[cx] |= (a == 2 * cx ? left : 0) | (b == 2 * cx + 1 ? right : 0);
+        float z = std::min(z_at(a), z_at(b));
+        if (z > zp[cx] + 0.01f) continue;
+        // only ever nearer, or the tolerance would creep from dot to dot
+        zp[cx] = std::min(zp[cx], z);
+        pp[cx] = f.prim;
+        ip[cx] = f.in;
+        written++;
+    }
+    return written;
+}
+
+// A stamp row is three spans: the rims, with the falloff of each cell, and
+// the inside, one fragment for the whole span.
+template <Rasterizer::Target T>
+void Rasterizer::run_circle(uint32_t k, Clip& clip) {
+    const Cmd& c = cmds[k];
+    int radius = c.x1;
+    const Stamp& s = stamps[radius];
+    const int size = 2 * radius + 1;
+    int dy0 = std::max(-radius, clip.y0 - c.y0), dy1 = std::min(radius, clip.y1 - c.y0);
+    for (int dy = dy0; dy <= dy1; dy++) {
+        const Stamp::Row& row = s.rows[dy + radius];
+        int a = std::max(row.lo, clip.x0 - c.x0), b = std::min(row.hi, clip.x1 - c.x0);
+        if (a > b) continue;
+        int ia = std::max(a, row.inner_lo), ib = std::min(b, row.inner_hi);
+        if (ia > ib) { ia = b + 1; ib = b; }   // rim only
+        const uint16_t* level = &s.level[(size_t)(dy + radius) * size + radius];
+        int y = c.y0 + dy;
+        for (int dx = a; dx < ia; dx++) plot<T>(clip, c.x0 + dx, y, c.z0, {k, PALETTE | (c.shade + level[dx])});
+        if (ia <= ib) {
+            if constexpr (T == Target::BRAILLE)
+                clip.written += dot_span(y, c.x0 + ia, c.x0 + ib, {k, PALETTE | c.shade}, [&](int) { return c.z0; });
+            else
+                clip.written += fill_span((size_t)y * w + c.x0 + ia, ib - ia + 1, c.z0, {k, PALETTE | c.shade});
+        }
+        for (int dx = ib + 1; dx <= b; dx++) plot<T>(clip, c.x0 + dx, y, c.z0, {k, PALETTE | (c.shade + level[dx])});
+    }
+}
+
+template <Rasterizer::Target T>
+void Rasterizer::run_triangle(uint32_t k, Clip& clip) {
+    const Cmd& c = cmds[k];
+    const RasterVertex& v0 = tri[c.x0];
+    const RasterVertex& v1 = tri[c.x0 + 1];
+    const RasterVertex& v2 = tri[c.x0 + 2];
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    float inv_area = 1.0f / area;
+
+    int x_min = std::max(clip.x0, (int)floorf(std::min({v0.x, v1.x, v2.x})));
+    int x_max = std::min(clip.x1, (int)ceilf(std::max({v0.x, v1.x, v2.x})));
+    int y_min = std::max(clip.y0, (int)floorf(std::min({v0.y, v1.y, v2.y})));
+    int y_max = std::min(clip.y1, (int)ceilf(std::max({v0.y, v1.y, v2.y})));
+
+    for (int y = y_min; y <= y_max; y++) {
+        float py = y + 0.5f;
+        for (int x = x_min; x <= x_max; x++) {
+            float px = x + 0.5f;
+            // barycentric weights, positive inside for either winding
+            float w0 = ((v1.x - px) * (v2.y - py) - (v1.y - py) * (v2.x - px)) * inv_area;
+            float w1 = ((v2.x - px) * (v0.y - py) - (v2.y - py) * (v0.x - px)) * inv_area;
+            float w2 = 1.0f - w0 - w1;
+            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+            // the weights are the shading inputs; the Gouraud color waits for shade()
+            plot<T>(clip, x, y, w0 * v0.z + w1 * v1.z + w2 * v2.z, {k, pack_weights(w0, w1)});
+        }
+    }
+}
+
+// --- Shading ---
+
+// color of a triangle pixel with corners v[0..2], from its packed weights
+static inline uint32_t shade_triangle(const RasterVertex* v, uint32_t in) {
+    float a = (float)(in & 0x7FFF) * (1.0f / 32767.0f);
+    float b = (float)((in >> 15) & 0x7FFF) * (1.0f / 32767.0f);
+    float w2 = std::max(0.0f, 1.0f - a - b);
+    RGB color = {(uint8_t)(a * v[0].color.r + b * v[1].color.r + w2 * v[2].color.r),
+                 (uint8_t)(a * v[0].color.g + b * v[1].color.g + w2 * v[2].color.g),
+                 (uint8_t)(a * v[0].color.b + b * v[1].color.b + w2 * v[2].color.b)};
+    float brightness = a * v[0].brightness + b * v[1].brightness + w2 * v[2].brightness;
+    float occlusion = a * v[0].occlusion + b * v[1].occlusion + w2 * v[2].occlusion;
+    return Rasterizer::pack(Rasterizer::depth_shade(color, brightness, occlusion));
+}
+
+// The color plane holds the shading inputs of the pixels this flush wrote
+// and is overwritten with their colors; pixels whose primitive came before
+// this flush already hold one. A palette entry is a load, a triangle is
+// interpolated. Empty vectors are skipped whole; within the others held and
+// empty pixels come mixed at primitive edges, so the palette load is
+// unconditional (its index clamped) and the word kept or replaced by a mask.
+template <Rasterizer::Target T>
+size_t Rasterizer::shade(const Clip& clip) {
+    int x0 = clip.x0, x1 = clip.x1, y0 = clip.y0, y1 = clip.y1;
+    if constexpr (T == Target::BRAILLE) { x0 >>= 1; x1 >>= 1; y0 >>= 2; y1 >>= 2; }
+    const simd_float far = simdf32_set(std::numeric_limits<float>::max());
+    const int all_empty = (int)((1ull << (4 * VECSIZE_FLOAT)) - 1);
+    const uint32_t first = (uint32_t)flushed;
+    const uint32_t none = 0;
+    const uint32_t* palette = shades.empty() ? &none : shades.data();
+    const uint32_t top = shades.empty() ? 0 : (uint32_t)shades.size() - 1;
+    uint32_t last_prim = NO_ID;
+    const RasterVertex* v = nullptr;
+    size_t covered = 0;
+    // after a clear every pixel held was written by this flush
+    auto pass = [&](auto after_clear) {
+        for (int y = y0; y <= y1; y++) {
+            const size_t row = (size_t)y * pw;
+            const float* zp = &zbuf[row];
+            const uint32_t* pp = &primbuf[row];
+            uint32_t* cp = &rgba[row];
+            for (int x = x0; x <= x1;) {
+                int end = x1 + 1;
+                if (x + (int)VECSIZE_FLOAT <= end) {
+                    if (simdi8_movemask(simdf_f2icast(simdf32_gt(simdf32_loadu(zp + x), far))) == all_empty) {
+                        x += VECSIZE_FLOAT;
+                        continue;
+                    }
+                    end = x + VECSIZE_FLOAT;
+                }
+                for (; x < end; x++) {
+                    const uint32_t held = zp[x] != EMPTY;
+                    uint32_t fresh = held;
+                    if constexpr (!decltype(after_clear)::value) fresh = held & (pp[x] >= first);
+                    const uint32_t in = cp[x];
+                    covered += held;
+                    const uint32_t listed = 0u - (fresh & (in >> 31));
+                    const uint32_t color = palette[std::min(in & ~PALETTE, top)];
+                    cp[x] = (color & listed) | (in & ~listed);
+                    if (fresh & ~in >> 31) {
+                        if (pp[x] != last_prim) {
+                            last_prim = pp[x];
+                            v = &tri[cmds[last_prim].x0];
+                        }
+                        cp[x] = shade_triangle(v, in);
+                    }
+                }
+            }
+        }
+    };
+    if (first == 0) pass(std::true_type());
+    else            pass(std::false_type());
+    return covered;
+}
+
+// --- Resolve ---
+
+// Colors are summed as two planes of 16-bit fields, red and blue in one,
+// green and alpha in the other: a block of at most MAX_SSAA^2 pixels adds up
+// to no more than 16 x 255, so a field never carries into its neighbour and
+// whole rows add with 32-bit lanes. Rows are summed in vectors, the columns
+// of a block and the division are left to one scalar pass per output pixel.
+void Rasterizer::resolve(int factor, RGB background, std::vector<uint32_t>& out) const {
+    const int f = std::clamp(factor, 1, MAX_SSAA);
+    const int ow = w / f, oh = h / f;
+    out.resize((size_t)ow * oh);
+    if (tgt != Target::PIXELS || ow == 0 || oh == 0) return;
+    const uint32_t bg = pack(background);
+    const uint32_t n = (uint32_t)(f * f);
+    const uint32_t recip = (65536 + n - 1) / n;     // rounds exactly for sums of n bytes
+
+    parallel_for((size_t)oh, [&](size_t oy) {
+        const int span = ow * f;
+        std::vector<uint32_t> lo(span, 0), hi(span, 0);
+        const simd_int mask = simdi32_set(0x00FF00FF);
+        const simd_int bgv = simdi32_set((int)bg);
+        const simd_float far = simdf32_set(std::numeric_limits<float>::max());
+        for (int r = 0; r < f; r++) {
+            const size_t row = ((size_t)oy * f + r) * w;
+            const uint32_t* cp = &rgba[row];
+            const float* zp = &zbuf[row];
+            int x = 0;
+            for (; x + (int)VECSIZE_INT <= span; x += VECSIZE_INT) {
+                simd_int empty = simdf_f2icast(simdf32_gt(simdf32_loadu(zp + x), far));
+                simd_int c = simdi8_blend(simdi_loadu((const simd_int*)(cp + x)), bgv, empty);
+                simd_int* lq = (simd_int*)(lo.data() + x);
+                simd_int* hq = (simd_int*)(hi.data() + x);
+                simdi_storeu(lq, simdi32_add(simdi_loadu(lq), simdi_and(c, mask)));
+                simdi_storeu(hq, simdi32_add(simdi_loadu(hq), simdi_and(simdi32_srli(c, 8), mask)));
+            }
+            for (; x < span; x++) {
+                uint32_t c = (zp[x] != EMPTY) ? cp[x] : bg;
+                lo[x] += c & 0x00FF00FFu;
+                hi[x] += (c >> 8) & 0x00FF00FFu;
+            }
+        }
+        uint32_t* op = &out[(size_t)oy * ow];
+        for (int ox = 0; ox < ow; ox++) {
+            uint32_t sl = 0, sh = 0;
+            for (int k = ox * f; k < ox * f + f; k++) { sl += lo[k]; sh += hi[k]; }
+            auto avg = [&](uint32_t s) { return (((s & 0xFFFF) + n / 2) * recip) >> 16; };
+            op[ox] = avg(sl) | (avg(sh) << 8) | (avg(sl >> 16) << 16) | (avg(sh >> 16) << 24);
+        }
+    });
+}
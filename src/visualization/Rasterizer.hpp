@@ -0,0 +1,196 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+struct RGB {
+    uint8_t r, g, b;
+};
+
+// Screen-space triangle corner for draw_triangle.
+struct RasterVertex {
+    float x, y, z;
+    RGB color;
+    float brightness;
+    float occlusion;
+};
+
+// Depth-tested framebuffer fed with recorded primitives. Nothing is drawn
+// until flush: primitives are binned into TILE x TILE screen tiles and the
+// tiles are rasterized in parallel, each replaying its primitives in the
+// order they were recorded and writing only its own pixels. Every pixel thus
+// sees the same sequence of writes as in one pass over the whole screen, so
+// the result does not depend on the number of threads.
+//
+// Shading is deferred. The framebuffer is three planes: float depths, with
+// EMPTY (+inf) where nothing was drawn, the index of the primitive that won
+// the depth test, and a 32-bit word that rasterization fills with its
+// shading input: a triangle's barycentric weights, or for the other
+// primitives which of the few colors it was given when recorded, one per
+// halo ring or rim falloff. Once a tile's primitives are all drawn, a
+// shading pass replaces the input with the packed color, once per visible
+// pixel, however often it was overdrawn. That is 12 bytes a pixel, and the
+// depth test alone tells an empty pixel, so clearing only refills the
+// depth plane. Primitives are kept until the next clear, so the id the
+// caller gave the one under a pixel (views use it for the residue drawn) is
+// a lookup through its index.
+//
+// The BRAILLE target keeps the planes per 2x4 braille cell instead, plus a
+// plane of dot masks. Any pixel drawn sets its dot, as it would have filled
+// its pixel whatever its depth; the cell keeps the depth and primitive of the
+// nearest dot, which is what the terminal shows for it.
+//
+// Over the depth plane sits a coarse level holding the farthest depth of
+// each HZ x HZ block. A primitive whose nearest depth lies behind every
+// block its box covers cannot pass the depth test anywhere, so it is
+// skipped whole; views draw front to back to make the most of this. Blocks
+// are refreshed lazily after a primitive touches them.
+class Rasterizer {
+public:
+    static const int TILE = 64;
+    static const int HZ = 8;            // divides TILE, so a tile owns its blocks and cells
+    static const int MAX_THICK = 4;     // the halo has faded out by then
+    static const int MAX_SSAA = 4;      // keeps a block's channel sum within 16 bits
+    static constexpr float EMPTY = std::numeric_limits<float>::infinity();
+    static constexpr uint32_t NO_ID = 0xFFFFFFFFu;
+
+    enum class Target : uint8_t {
+        PIXELS,     // planes per pixel
+        BRAILLE,    // planes per braille cell, plus its dots
+    };
+
+    void resize(int width, int height, Target target = Target::PIXELS);
+    void clear();
+    int width() const { return w; }
+    int height() const { return h; }
+    Target target() const { return tgt; }
+    // size of the planes: pixels, or braille cells rounded up
+    int plane_width() const { return pw; }
+    int plane_height() const { return ph; }
+    // colors are valid where the depth is not EMPTY, once flushed
+    const std::vector<uint32_t>& colors() const { return rgba; }
+    const std::vector<float>& depths() const { return zbuf; }
+    // BRAILLE: the braille pattern of each cell, U+2800 plus the mask
+    const std::vector<uint8_t>& dots() const { return dot_mask; }
+    // PIXELS: the frame shrunk by factor in each direction, every pixel the
+    // mean of its factor x factor block, empty pixels counting as background;
+    // packed like colors()
+    void resolve(int factor, RGB background, std::vector<uint32_t>& out) const;
+    // id of what is drawn at pixel (x, y), NO_ID for nothing or off screen
+    uint32_t id_at(int x, int y) const;
+
+    // r, g, b, 255 in memory order on little-endian, the layout of RGBA
+    static uint32_t pack(RGB c) {
+        return (uint32_t)c.r | ((uint32_t)c.g << 8) | ((uint32_t)c.b << 16) | 0xFF000000u;
+    }
+    static RGB unpack(uint32_t c) { return {(uint8_t)c, (uint8_t)(c >> 8), (uint8_t)(c >> 16)}; }
+
+    void point(int x, int y, float z, RGB color, float brightness, float occlusion = 1.0f, uint32_t id = NO_ID);
+    // thick : pixels of fading halo on each side of the center line
+    void line(int x0, int y0, float z0, int x1, int y1, float z1, int thick,
+              RGB color, float brightness, float occlusion = 1.0f, uint32_t id = NO_ID);
+    void circle(int cx, int cy, float z, int radius, RGB color, float brightness, float occlusion = 1.0f,
+                uint32_t id = NO_ID);
+    void triangle(const RasterVertex& v0, const RasterVertex& v1, const RasterVertex& v2, uint32_t id = NO_ID);
+
+    // draw and shade everything recorded since the last flush; tiled = false
+    // runs the same primitives in one pass on this thread, the reference for
+    // the tiled path
+    void flush(bool tiled = true);
+
+    static RGB depth_shade(RGB color, float brightness, float occlusion = 1.0f);
+
+    // Work of the last flush. Primitives count once per tile they land in.
+    struct Stats {
+        size_t primitives = 0;  // recorded since the flush before
+        size_t drawn = 0;       // rasterized in a tile
+        size_t culled = 0;      // skipped in a tile by the block depths
+        size_t written = 0;     // pixels (cells) that passed the depth test
+        size_t covered = 0;     // pixels (cells) holding something afterwards
+        float overdraw() const { return covered ? (float)written / covered : 0.0f; }
+    };
+    const Stats& stats() const { return last_stats; }
+
+private:
+    struct Cmd {
+        enum Kind : uint8_t { POINT, LINE, CIRCLE, TRIANGLE } kind;
+        int x0, y0, x1, y1;     // line ends; circle center and radius in x1; triangle: x0 indexes tri
+        float z0, z1;
+        int thick;
+        RGB color;
+        float brightness, occlusion;
+        uint32_t id;
+        int bx0, by0, bx1, by1; // every pixel it can write, unclipped
+        float near;             // no pixel of it is nearer
+        uint32_t shade = 0;     // its first color in shades, set by record
+    };
+    // What a depth write stores besides the depth: the primitive, by index
+    // into cmds, and its shading input at that pixel
+    struct Frag {
+        uint32_t prim;
+        uint32_t in;            // triangle: 15-bit weights w0, w1; else PALETTE and an index into shades
+    };
+    // Inclusive rectangle a pass may write, with that pass's counters
+    struct Clip {
+        int x0, y0, x1, y1;
+        size_t drawn = 0, culled = 0, written = 0;
+    };
+
+    // Disc of one radius: per row the covered dx span and the inner span
+    // where the rim falloff is still 1, plus the falloff of every cell, as
+    // an index into the distinct falloffs
+    struct Stamp {
+        struct Row { int lo, hi, inner_lo, inner_hi; };   // empty when lo > hi
+        std::vector<Row> rows;                             // dy = -radius .. radius
+        std::vector<uint16_t> level;                       // (2 radius + 1)^2, row-major
+        std::vector<float> levels;                         // levels[0] = 1, the inside
+    };
+    const Stamp& stamp(int radius);
+
+    void record(Cmd c);
+    void bin(uint32_t c);
+    // the rasterization below is compiled once per target, flush picks one
+    template <Target T> void draw(bool tiled);
+    template <Target T> void run(uint32_t k, Clip& clip);
+    template <Target T> void plot(Clip& clip, int x, int y, float z, Frag f);
+    template <Target T> void run_line(uint32_t k, Clip& clip);
+    template <Target T> void run_circle(uint32_t k, Clip& clip);
+    template <Target T> void run_triangle(uint32_t k, Clip& clip);
+    // depth-tests n pixels from index i at one depth and fragment, returns the pixels written
+    int fill_span(size_t i, int n, float z, Frag f);
+    // BRAILLE: dots x0 .. x1 of pixel row y, depth z_at(x); returns the cells written
+    template <class Depth>
+    int dot_span(int y, int x0, int x1, Frag f, Depth z_at);
+    // the deferred pass: colors of the pixels (cells) in clip that hold
+    // something; returns how many do
+    template <Target T> size_t shade(const Clip& clip);
+    // farthest depth in block (bx, by); a cell counts only once all its dots are set
+    float block_far(int bx, int by) const;
+    // true if c cannot pass the depth test anywhere in clip
+    bool occluded(const Cmd& c, const Clip& clip);
+    // marks the blocks c may have written in clip for a refresh
+    void touch(const Cmd& c, const Clip& clip);
+
+    int w = 0, h = 0;
+    Target tgt = Target::PIXELS;
+    int pw = 0, ph = 0;
+    int tiles_x = 0, tiles_y = 0;
+    std::vector<uint32_t> rgba;                 // Frag::in until shade() puts the color there
+    std::vector<float> zbuf;
+    std::vector<uint32_t> primbuf;              // Frag::prim of the nearest write
+    std::vector<uint8_t> dot_mask;              // BRAILLE only
+    std::vector<Cmd> cmds;                      // kept until clear, for id_at
+    size_t flushed = 0;                         // cmds drawn by an earlier flush
+    std::vector<uint32_t> shades;               // the colors of cmds, see Cmd::shade
+    std::vector<RasterVertex> tri;
+    std::vector<Stamp> stamps;                  // by radius, built on first use
+    std::vector<std::vector<uint32_t>> bins;    // per tile, indices into cmds in recorded order
+    std::vector<uint32_t> busy;                 // flush: tiles with work, and per such tile
+    std::vector<Clip> passes;                   // its pass
+    std::vector<size_t> tile_covered;           // and its covered pixels
+    int hz_x = 0;                               // blocks per row
+    std::vector<float> hz;                      // farthest depth per block
+    std::vector<uint8_t> hz_stale;              // written since its depth was taken
+    Stats last_stats;
+};
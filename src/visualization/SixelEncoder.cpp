@@ -1,7 +1,6 @@
 #include "SixelEncoder.hpp"
 #include <cmath>
 #include <algorithm>
-#include <unordered_set>
 
 std::string SixelEncoder::build_palette() {
     std::string pal;
@@ -41,16 +40,17 @@ int SixelEncoder::nearest_palette_color(uint8_t r, uint8_t g, uint8_t b) {
 void SixelEncoder::encode_band(std::string& out,
                                 const std::vector<int>& palette_pixels,
                                 int width, int height, int band_y) {
-    std::unordered_set<int> active_colors;
+    bool active[256] = {};
     for (int row = band_y; row < std::min(band_y + 6, height); row++) {
         for (int x = 0; x < width; x++) {
             int c = palette_pixels[row * width + x];
-            if (c >= 0) active_colors.insert(c);
+            if (c >= 0) active[c] = true;
         }
     }
 
     bool first_color = true;
-    for (int color : active_colors) {
+    for (int color = 0; color < 256; color++) {
+        if (!active[color]) continue;
         if (!first_color) {
             out += '$';
         }
@@ -100,10 +100,11 @@ void SixelEncoder::encode_band(std::string& out,
     out += '-';
 }
 
-std::string SixelEncoder::encode(const std::vector<RGBA>& pixels,
-                                  int width, int height,
-                                  uint8_t bg_r, uint8_t bg_g, uint8_t bg_b) {
-    std::vector<int> palette_pixels(width * height, -1);
+void SixelEncoder::encode(std::string& out, const std::vector<RGBA>& pixels,
+                          int width, int height,
+                          uint8_t bg_r, uint8_t bg_g, uint8_t bg_b) {
+    if (palette.empty()) palette = build_palette();
+    palette_pixels.assign((size_t)width * height, -1);
     for (int i = 0; i < width * height; i++) {
         const RGBA& px = pixels[i];
         if (px.a < 16) continue;
@@ -115,17 +116,14 @@ std::string SixelEncoder::encode(const std::vector<RGBA>& pixels,
         palette_pixels[i] = nearest_palette_color(r, g, b);
     }
 
-    std::string out;
-    out.reserve(width * height);
+    out.reserve(out.size() + (size_t)width * height);
 
     out += "\033P0;1;q";
-    out += build_palette();
+    out += palette;
 
     for (int band_y = 0; band_y < height; band_y += 6) {
         encode_band(out, palette_pixels, width, height, band_y);
     }
 
     out += "\033\\";
-
-    return out;
 }
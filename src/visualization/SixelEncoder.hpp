@@ -4,11 +4,14 @@
 #include <string>
 #include <cstdint>
 
+// Keeps its palette and index buffer between frames, so encoding a frame
+// of the same size allocates nothing beyond what out has already.
 class SixelEncoder {
 public:
-    static std::string encode(const std::vector<RGBA>& pixels,
-                              int width, int height,
-                              uint8_t bg_r = 0, uint8_t bg_g = 0, uint8_t bg_b = 0);
+    // appends the DCS sequence of the image to out
+    void encode(std::string& out, const std::vector<RGBA>& pixels,
+                int width, int height,
+                uint8_t bg_r = 0, uint8_t bg_g = 0, uint8_t bg_b = 0);
 
 private:
     static std::string build_palette();
@@ -16,4 +19,7 @@ private:
     static void encode_band(std::string& out,
                             const std::vector<int>& palette_pixels,
                             int width, int height, int band_y);
+
+    std::string palette;
+    std::vector<int> palette_pixels;
 };
@@ -1,5 +1,6 @@
 #include "UnicodeScreen.hpp"
 #include "lodepng.h"
+#include "Parallel.hpp"
 #include <termios.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
@@ -11,6 +12,7 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <type_traits>
 #include <cstdlib>
 #include <ctime>
 #include <signal.h>
@@ -41,6 +43,7 @@ void UnicodeScreen::enter_raw_mode() {
 
 void UnicodeScreen::exit_raw_mode() {
     if (!raw_mode_active) return;
+    set_hover_labels(false);
     write(STDOUT_FILENO, "\033[?25h", 6);
     write(STDOUT_FILENO, "\033[?1049l", 8);
     write(STDOUT_FILENO, "\033[0m", 4);
@@ -59,7 +62,10 @@ void UnicodeScreen::query_terminal_size() {
         }
     }
     // Bottom info panel: 1 blank + 2 info lines per protein + 1 for sidebar info
-    info_rows = 1 + (int)data.size() + (sidebar_info.empty() ? 0 : 1);
+    info_rows = 1 + (int)data.size() + (sidebar_info.empty() ? 0 : 1) +
+                (view_mode == ViewMode::CONTACT_MAP ? 1 : 0) +
+                ((hover_labels && view_mode != ViewMode::CONTACT_MAP) ? 1 : 0) +
+                ((prompt_active || !prompt_status.empty()) ? 1 : 0);
 
     if (use_sixel) {
         // Pixel-level resolution via Sixel
@@ -247,18 +253,23 @@ static std::string json_extract_number(const std::string& json, const std::strin
     return json.substr(start, pos - start);
 }
 
-static std::string title_case(const std::string& s) {
-    std::string r = s;
+// s in title case, appended to out
+static void append_title_case(std::string& out, const std::string& s) {
     bool cap = true;
-    for (size_t i = 0; i < r.size(); i++) {
-        if (cap && std::isalpha((unsigned char)r[i])) {
-            r[i] = std::toupper((unsigned char)r[i]);
+    for (char ch : s) {
+        if (std::isalpha((unsigned char)ch)) {
+            ch = cap ? std::toupper((unsigned char)ch) : std::tolower((unsigned char)ch);
             cap = false;
-        } else if (!cap && std::isalpha((unsigned char)r[i])) {
-            r[i] = std::tolower((unsigned char)r[i]);
         }
-        if (r[i] == ' ' || r[i] == '-' || r[i] == ':' || r[i] == '.') cap = true;
+        if (ch == ' ' || ch == '-' || ch == ':' || ch == '.') cap = true;
+        out += ch;
     }
+}
+
+static std::string title_case(const std::string& s) {
+    std::string r;
+    r.reserve(s.size());
+    append_title_case(r, s);
     return r;
 }
 
@@ -443,6 +454,52 @@ RGB UnicodeScreen::get_ss_color(char ss_type) {
     }
 }
 
+RGB UnicodeScreen::get_exposure_color(float exposure) {
+    // still being computed in the background
+    if (exposure < 0.0f) return {110, 110, 110};
+    // buried blue, through white, to exposed orange
+    const RGB buried = {60, 90, 200}, middle = {225, 225, 225}, exposed = {235, 120, 40};
+    float t = std::clamp(exposure, 0.0f, 1.0f) * 2.0f;
+    const RGB& a = (t < 1.0f) ? buried : middle;
+    const RGB& b = (t < 1.0f) ? middle : exposed;
+    if (t >= 1.0f) t -= 1.0f;
+    return {(uint8_t)(a.r + t * (b.r - a.r)), (uint8_t)(a.g + t * (b.g - a.g)), (uint8_t)(a.b + t * (b.b - a.b))};
+}
+
+RGB UnicodeScreen::get_interface_color(bool interface, int chain_idx, int total_chains) {
+    // interface residues in their chain color, the rest recede
+    return interface ? get_chain_color(chain_idx, total_chains) : RGB{80, 80, 80};
+}
+
+template <ColorScheme S>
+RGB UnicodeScreen::scheme_color(int idx, int total, int chain_idx, int total_chains,
+                                char ss_type, float exposure, bool interface) {
+    if constexpr (S == ColorScheme::RAINBOW)   return get_color_for_point(idx, total);
+    if constexpr (S == ColorScheme::CHAIN)     return get_chain_color(chain_idx, total_chains);
+    if constexpr (S == ColorScheme::STRUCTURE) return get_ss_color(ss_type);
+    if constexpr (S == ColorScheme::EXPOSURE)  return get_exposure_color(exposure);
+    if constexpr (S == ColorScheme::INTERFACE) return get_interface_color(interface, chain_idx, total_chains);
+}
+
+// Calls kernel(scheme, sixel) with both as std::integral_constant, so each
+// combination is compiled as its own loop without the per-atom switch on
+// the scheme or the per-primitive Sixel checks
+template <class Kernel>
+static void dispatch_kernel(ColorScheme scheme, bool sixel, Kernel&& kernel) {
+    auto backend = [&](auto s) {
+        if (sixel) kernel(s, std::true_type());
+        else       kernel(s, std::false_type());
+    };
+    switch (scheme) {
+        case ColorScheme::RAINBOW:   backend(std::integral_constant<ColorScheme, ColorScheme::RAINBOW>()); break;
+        case ColorScheme::CHAIN:     backend(std::integral_constant<ColorScheme, ColorScheme::CHAIN>()); break;
+        case ColorScheme::STRUCTURE: backend(std::integral_constant<ColorScheme, ColorScheme::STRUCTURE>()); break;
+        case ColorScheme::EXPOSURE:  backend(std::integral_constant<ColorScheme, ColorScheme::EXPOSURE>()); break;
+        case ColorScheme::INTERFACE: backend(std::integral_constant<ColorScheme, ColorScheme::INTERFACE>()); break;
+        default: break;
+    }
+}
+
 void UnicodeScreen::auto_detect_color_scheme() {
     int total_chains = 0;
     for (auto* p : data)
@@ -455,8 +512,10 @@ const char* UnicodeScreen::color_scheme_name() {
         case ColorScheme::RAINBOW:   return "rainbow";
         case ColorScheme::CHAIN:     return "chain";
         case ColorScheme::STRUCTURE: return "structure";
+        case ColorScheme::EXPOSURE:  return "exposure";
+        case ColorScheme::INTERFACE: return "interface";
+        default: return "?";
     }
-    return "?";
 }
 
 const char* UnicodeScreen::palette_name() {
@@ -491,8 +550,7 @@ std::string UnicodeScreen::download_pdb(const std::string& pdb_id) {
     return tmp_path;
 }
 
-void UnicodeScreen::reload_protein(const std::string& filepath) {
-    // Clean up old data
+void UnicodeScreen::clear_proteins() {
     if (vectorpointer) {
         for (size_t i = 0; i < data.size(); i++) delete[] vectorpointer[i];
         delete[] vectorpointer;
@@ -503,6 +561,14 @@ void UnicodeScreen::reload_protein(const std::string& filepath) {
     pan_x.clear();
     pan_y.clear();
     chainVec.clear();
+    density.close();
+    nma_protein = nullptr;
+    nma_mode = 0;
+    nma_applied = false;
+}
+
+void UnicodeScreen::reload_protein(const std::string& filepath) {
+    clear_proteins();
 
     // Load new protein
     chainVec.push_back("-");
@@ -560,46 +626,44 @@ bool UnicodeScreen::load_specific_pdb(const std::string& pdb_id) {
 
 // --- PNG screenshot ---
 
-bool UnicodeScreen::write_framebuffer_png(const std::string& path) {
-    // Force 1280x720 for headless rendering
+bool UnicodeScreen::write_framebuffer_png(const std::string& path, int width, int height, int ssaa) {
     int saved_bw = buf_width, saved_bh = buf_height;
     int saved_sc = sidebar_cols;
-    buf_width = 1280;
-    buf_height = 720;
+    arena.reset();
+    px_scale = std::clamp(ssaa, 1, Rasterizer::MAX_SSAA);
+    buf_width = width * px_scale;
+    buf_height = height * px_scale;
     sidebar_cols = 0;  // center in full frame for screenshots
-    framebuffer.resize(buf_width * buf_height);
-
-    clear_framebuffer();
+    raster.resize(buf_width, buf_height);
 
     switch (view_mode) {
         case ViewMode::BACKBONE: project_backbone(); break;
         case ViewMode::GRID:     project_grid();     break;
         case ViewMode::SURFACE:  project_surface();  break;
+        case ViewMode::ATOMS:    project_full_atoms(); break;
+        case ViewMode::CONTACT_MAP: project_contact_map(); break;
+        default: break;
     }
-
-    // Convert framebuffer to RGBA
-    std::vector<unsigned char> image(buf_width * buf_height * 4);
-    for (int i = 0; i < buf_width * buf_height; i++) {
-        if (framebuffer[i].active) {
-            image[i * 4 + 0] = framebuffer[i].r;
-            image[i * 4 + 1] = framebuffer[i].g;
-            image[i * 4 + 2] = framebuffer[i].b;
-            image[i * 4 + 3] = 255;
-        } else {
-            image[i * 4 + 0] = bg_color.r;
-            image[i * 4 + 1] = bg_color.g;
-            image[i * 4 + 2] = bg_color.b;
-            image[i * 4 + 3] = 255;
-        }
+    project_density();
+    raster.flush();
+    if (show_stats) {
+        const Rasterizer::Stats& st = raster.stats();
+        std::cout << "Rasterizer: " << st.primitives << " primitives, " << st.drawn << " drawn and "
+                  << st.culled << " culled in tiles, " << st.written << " pixels written over "
+                  << st.covered << " covered (overdraw " << st.overdraw() << "x)" << std::endl;
     }
 
-    unsigned error = lodepng_encode32_file(path.c_str(), image.data(), buf_width, buf_height);
+    // packed colors are RGBA bytes already
+    std::vector<uint32_t> image;
+    raster.resolve(px_scale, bg_color, image);
+    unsigned error = lodepng_encode32_file(path.c_str(), (const unsigned char*)image.data(), width, height);
 
     // Restore
     buf_width = saved_bw;
     buf_height = saved_bh;
     sidebar_cols = saved_sc;
-    framebuffer.resize(buf_width * buf_height);
+    px_scale = 1;
+    raster.resize(buf_width, buf_height, raster_target());
 
     return error == 0;
 }
@@ -615,13 +679,7 @@ UnicodeScreen::UnicodeScreen(const bool& show_structure, const std::string& mode
 
 UnicodeScreen::~UnicodeScreen() {
     exit_raw_mode();
-    if (vectorpointer) {
-        for (size_t i = 0; i < data.size(); i++) delete[] vectorpointer[i];
-        delete[] vectorpointer;
-        vectorpointer = nullptr;
-    }
-    for (Protein* p : data) delete p;
-    data.clear();
+    clear_proteins();
 }
 
 // --- Data setup ---
@@ -690,11 +748,41 @@ void UnicodeScreen::set_utmatrix(const std::string& utmatrix, bool applyUT) {
     delete[] matrixpointer;
 }
 
+void UnicodeScreen::superpose_proteins() {
+    if (search_hit_idx >= 0) {
+        // fit was already computed while ranking
+        Superposition fit = search_hits[search_hit_idx].fit;
+        data[1]->do_naive_rotation(fit.rot);
+        data[1]->do_shift(fit.shift);
+        return;
+    }
+
+    std::vector<CATrace> traces;
+    for (auto* p : data) traces.push_back(p->get_ca_trace());
+
+    Superposer superposer;
+    std::vector<Superposition> fits = superposer.superpose_all(traces, 0);
+    for (size_t i = 1; i < data.size(); i++) {
+        if (fits[i].aligned < 3) {
+            std::cerr << "  align: no residue correspondence for " << data[i]->get_file_name() << std::endl;
+            continue;
+        }
+        data[i]->do_naive_rotation(fits[i].rot);
+        data[i]->do_shift(fits[i].shift);
+        printf("  align: %s -> %s  RMSD %.2f A over %d CA\n",
+               data[i]->get_file_name().c_str(), data[0]->get_file_name().c_str(),
+               fits[i].rmsd, fits[i].aligned);
+    }
+}
+
 void UnicodeScreen::normalize_proteins(const std::string& utmatrix) {
-    const bool hasUT = !utmatrix.empty();
+    const bool aligned = utmatrix.empty() && (align_structures || morph_mode || search_hit_idx >= 0) && data.size() > 1;
+    const bool hasUT = !utmatrix.empty() || aligned;
     for (size_t i = 0; i < data.size(); i++)
         data[i]->load_data(vectorpointer[i], yesUT);
-    if (hasUT) set_utmatrix(utmatrix, true);
+    if (aligned) superpose_proteins();
+    if (aligned && morph_mode) start_morph();
+    else if (hasUT) set_utmatrix(utmatrix, true);
 
     global_bb = BoundingBox();
     for (auto* p : data) { p->set_bounding_box(); global_bb = global_bb + p->get_bounding_box(); }
@@ -717,77 +805,166 @@ void UnicodeScreen::normalize_proteins(const std::string& utmatrix) {
         }
     }
 
+    apply_selections();
+
     query_terminal_size();
-    framebuffer.resize(buf_width * buf_height, {0, 0, 0, 0.0f, false});
+    raster.resize(buf_width, buf_height, raster_target());
 }
 
-// --- Pixel operations ---
+// --- Morph ---
 
-void UnicodeScreen::clear_framebuffer() {
-    std::fill(framebuffer.begin(), framebuffer.end(), Pixel{0, 0, 0, 0.0f, false});
+void UnicodeScreen::start_morph() {
+    if (data.size() != 2) return;
+    if (!data[0]->set_morph_target(*data[1])) {
+        std::cerr << "  morph: no residue correspondence between the two structures" << std::endl;
+        return;
+    }
+    printf("  morph: %s -> %s\n", data[0]->get_file_name().c_str(), data[1]->get_file_name().c_str());
+
+    // the target lives on in the morph, only the first structure is drawn
+    delete data[1];
+    delete[] vectorpointer[1];
+    vectorpointer[1] = nullptr;
+    data.pop_back();
+    pan_x.pop_back();
+    pan_y.pop_back();
+    morph_phase = 0.0f;
 }
 
-RGB UnicodeScreen::depth_shade(RGB color, float brightness) {
-    brightness = std::clamp(brightness, 0.45f, 1.0f);
-    return {
-        (uint8_t)(color.r * brightness),
-        (uint8_t)(color.g * brightness),
-        (uint8_t)(color.b * brightness),
-    };
+// --- Selections ---
+
+bool UnicodeScreen::run_selection(const std::string& command) {
+    try {
+        SelectionCommand cmd(command);
+        size_t hits = 0;
+        for (auto* p : data) hits += p->apply_selection(cmd);
+        if (cmd.action == SelectAction::RESET) selections.clear();
+        else selections.push_back(cmd);
+        prompt_status = command + "  (" + std::to_string(hits) + " residues)";
+        return true;
+    } catch (const std::exception& e) {
+        prompt_status = std::string("selection error: ") + e.what();
+        return false;
+    }
+}
+
+bool UnicodeScreen::load_map(const std::string& path, float sigma) {
+    if (data.empty()) return false;
+    try {
+        density.open(path);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    // only the part of the map around the model is ever read
+    CATrace trace = data[0]->get_ca_trace();
+    if (trace.size() > 0) {
+        const float margin = 8.0f;
+        float lo[3] = {*std::min_element(trace.x.begin(), trace.x.end()) - margin,
+                       *std::min_element(trace.y.begin(), trace.y.end()) - margin,
+                       *std::min_element(trace.z.begin(), trace.z.end()) - margin};
+        float hi[3] = {*std::max_element(trace.x.begin(), trace.x.end()) + margin,
+                       *std::max_element(trace.y.begin(), trace.y.end()) + margin,
+                       *std::max_element(trace.z.begin(), trace.z.end()) + margin};
+        density.set_region(lo, hi);
+    }
+    set_density_sigma(sigma);
+    printf("  map: %s, %zu bricks, %zu meshed at %.2f sigma\n", path.c_str(), density.num_bricks(),
+           density.active_bricks().size(), density_sigma);
+    return true;
 }
 
-void UnicodeScreen::plot_pixel(int x, int y, float z, RGB color, float brightness) {
-    if (x < 0 || x >= buf_width || y < 0 || y >= buf_height) return;
-    int idx = y * buf_width + x;
-    if (framebuffer[idx].active && z > framebuffer[idx].depth + 0.01f) return;
+void UnicodeScreen::set_density_sigma(float sigma) {
+    density_sigma = sigma;
+    density.set_level(density.mean() + sigma * density.rms());
+}
 
-    RGB shaded = depth_shade(color, brightness);
-    framebuffer[idx] = {shaded.r, shaded.g, shaded.b, z, true};
+void UnicodeScreen::apply_selections() {
+    for (const SelectionCommand& cmd : selections)
+        for (auto* p : data) p->apply_selection(cmd);
+}
+
+bool UnicodeScreen::handle_prompt_key(char c) {
+    if (c == '\r' || c == '\n') {
+        prompt_active = false;
+        if (!prompt_text.empty()) return run_selection(prompt_text);
+    } else if (c == 27) {
+        prompt_active = false;
+    } else if (c == 127 || c == 8) {
+        if (!prompt_text.empty()) prompt_text.pop_back();
+    } else if (std::isprint((unsigned char)c)) {
+        prompt_text += c;
+    }
+    return true;
+}
+
+// --- Structure search ---
+
+void UnicodeScreen::run_search(const std::string& query_file, const std::string& dir) {
+    if (data.empty()) return;
+    search_query = query_file;
+    search_query_chains = chainVec.empty() ? "-" : chainVec[0];
+
+    std::cout << "Searching " << dir << "..." << std::endl;
+    StructureSearch search(dir);
+    search_hits = search.search(data[0]->get_ca_trace(), query_file);
+    if (search_hits.empty()) {
+        std::cout << "  no hits" << std::endl;
+        return;
+    }
+
+    for (size_t i = 0; i < search_hits.size() && i < 10; i++) {
+        const SearchHit& hit = search_hits[i];
+        printf("  %2zu  TM %.3f  RMSD %5.2f A  %4d CA  %s\n",
+               i + 1, hit.tm, hit.rmsd, hit.aligned, hit.path.c_str());
+    }
+    show_search_hit(0);
+}
+
+void UnicodeScreen::show_search_hit(int idx) {
+    if (search_hits.empty()) return;
+    idx = std::clamp(idx, 0, (int)search_hits.size() - 1);
+
+    clear_proteins();
+    search_hit_idx = idx;
+    chainVec = {search_query_chains, "-"};
+    try {
+        set_protein(search_query, 0, screen_show_structure);
+        set_protein(search_hits[idx].path, 1, screen_show_structure);
+    } catch (...) {
+        // keep whatever loaded so the viewer still has something to draw
+    }
+    set_tmatrix();
+    normalize_proteins("");
+    structNum = -1;
+}
+
+// --- Pixel operations ---
+
+void UnicodeScreen::clear_framebuffer() {
+    raster.clear();
+}
+
+void UnicodeScreen::plot_pixel(int x, int y, float z, RGB color, float brightness, float occlusion, uint32_t id) {
+    raster.point(x, y, z, color, brightness, occlusion, id);
 }
 
 // --- Drawing primitives ---
 
 void UnicodeScreen::draw_line(int x0, int y0, float z0,
                                int x1, int y1, float z1,
-                               RGB color, float brightness) {
-    int dx = x1 - x0;
-    int dy = y1 - y0;
-    int steps = std::max(abs(dx), abs(dy));
-    if (steps == 0) { plot_pixel(x0, y0, z0, color, brightness); return; }
-
-    float xInc = (float)dx / steps;
-    float yInc = (float)dy / steps;
-    float zInc = (z1 - z0) / steps;
-    float x = (float)x0, y = (float)y0, z = z0;
-
-    int thick = use_sixel ? 2 : 1;
-
-    for (int i = 0; i <= steps; i++) {
-        int ix = (int)(x + 0.5f);
-        int iy = (int)(y + 0.5f);
-        plot_pixel(ix, iy, z, color, brightness);
-        for (int t = 1; t <= thick; t++) {
-            float fade = brightness * (1.0f - 0.25f * t);
-            plot_pixel(ix + t, iy, z, color, fade);
-            plot_pixel(ix - t, iy, z, color, fade);
-            plot_pixel(ix, iy + t, z, color, fade);
-            plot_pixel(ix, iy - t, z, color, fade);
-        }
-        x += xInc; y += yInc; z += zInc;
-    }
+                               RGB color, float brightness, float occlusion, uint32_t id) {
+    raster.line(x0, y0, z0, x1, y1, z1, (use_sixel ? 2 : 1) * px_scale, color, brightness, occlusion, id);
 }
 
 void UnicodeScreen::draw_filled_circle(int cx, int cy, float z, int radius,
-                                        RGB color, float brightness) {
-    for (int dy = -radius; dy <= radius; dy++) {
-        for (int dx = -radius; dx <= radius; dx++) {
-            float dist = sqrtf((float)(dx * dx + dy * dy));
-            if (dist <= radius) {
-                float edge = 1.0f - std::max(0.0f, (dist - radius + 1.5f) / 1.5f);
-                plot_pixel(cx + dx, cy + dy, z, color, brightness * edge);
-            }
-        }
-    }
+                                        RGB color, float brightness, float occlusion, uint32_t id) {
+    raster.circle(cx, cy, z, radius, color, brightness, occlusion, id);
+}
+
+void UnicodeScreen::draw_triangle(const RasterVertex& v0, const RasterVertex& v1, const RasterVertex& v2,
+                                  uint32_t id) {
+    raster.triangle(v0, v1, v2, id);
 }
 
 // --- Color ---
@@ -818,17 +995,33 @@ void UnicodeScreen::auto_rotate_step() {
         if (count == 0) continue;
         cx /= count; cy /= count; cz /= count;
 
-        for (auto& [chainID, chain_atoms] : protein->get_atoms()) {
-            for (Atom& atom : chain_atoms) {
-                float dx = atom.x - cx;
-                float dz = atom.z - cz;
-                atom.x = cx + dx * cosA + dz * sinA;
-                atom.z = cz - dx * sinA + dz * cosA;
-            }
-        }
+        // about the y axis through the centroid
+        float m[12] = {cosA, 0, sinA, 0, 1, 0, -sinA, 0, cosA,
+                       cx - (cosA * cx + sinA * cz), 0, cz - (-sinA * cx + cosA * cz)};
+        protein->do_affine(m);
     }
 }
 
+void UnicodeScreen::morph_step() {
+    if (!morph_playing || std::none_of(data.begin(), data.end(), [](Protein* p) { return p->is_morphing(); }))
+        return;
+    // there and back, eased at both ends
+    morph_phase = fmodf(morph_phase + morph_speed, 2.0f);
+    float t = (morph_phase < 1.0f) ? morph_phase : 2.0f - morph_phase;
+    for (Protein* p : data)
+        if (p->is_morphing()) p->set_morph_frame(t * t * (3.0f - 2.0f * t));
+}
+
+void UnicodeScreen::nma_step() {
+    if (!nma_protein || nma_mode == 0 || nma_applied) return;
+    if (!nma_protein->get_modes()) return;
+    // a structure too small for the mode asked for just stops
+    if (!nma_protein->animate_mode(nma_mode - 1)) nma_mode = 0;
+    nma_applied = true;
+    // start from the rest pose
+    morph_phase = 0.5f;
+}
+
 // --- Projection helpers ---
 
 struct ProjAtom {
@@ -839,19 +1032,79 @@ struct ProjAtom {
     int chain_idx;
     int total_chains;
     char ss_type;
-    int global_idx;
+    bool new_stroke;
+    int global_idx;     // residue, counted on across structures
+    float x3d, y3d, z3d;
+    int protein_idx;
+    float occlusion;
+    bool hidden, highlight;
+    int color_override; // selection 0xRRGGBB, -1 : none
+    float exposure;
+    bool interface;
+    uint32_t pick;      // rasterizer id, see residue_id
 };
 
+// Rasterizer id of a residue: the structure in the top byte, below it the
+// residue's index in the structure's trace
+static uint32_t residue_id(int protein, int residue) {
+    return ((uint32_t)protein << 24) | (uint32_t)residue;
+}
+
+// Selection overrides on top of the color scheme and depth cue
+static void apply_style(const ProjAtom& a, RGB& color, float& brightness) {
+    int c = a.color_override;
+    if (c >= 0) color = {(uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c};
+    if (a.highlight) brightness = 1.0f;
+}
+
+// Indices of key in ascending order, stable, bucketed rather than exact:
+// enough for the rasterizer's occlusion culling, which wants near things first.
+// Allocates from key's resource.
+static std::pmr::vector<uint32_t> front_to_back(const std::pmr::vector<float>& key) {
+    const int BUCKETS = 256;
+    std::pmr::memory_resource* mem = key.get_allocator().resource();
+    std::pmr::vector<uint32_t> order(key.size(), mem);
+    if (key.empty()) return order;
+    auto [lo, hi] = std::minmax_element(key.begin(), key.end());
+    float scale = (*hi > *lo) ? (BUCKETS - 1) / (*hi - *lo) : 0.0f;
+    std::pmr::vector<uint8_t> bucket(key.size(), mem);
+    uint32_t start[BUCKETS + 1] = {};
+    for (size_t i = 0; i < key.size(); i++) {
+        bucket[i] = (uint8_t)((key[i] - *lo) * scale);
+        start[bucket[i] + 1]++;
+    }
+    for (int b = 0; b < BUCKETS; b++) start[b + 1] += start[b];
+    for (size_t i = 0; i < key.size(); i++) order[start[bucket[i]]++] = (uint32_t)i;
+    return order;
+}
+
+
 static void project_atoms(std::vector<Protein*>& data,
                            std::vector<float>& pan_x,
                            float zoom_level, float focal_offset,
                            std::vector<float>& pan_y,
                            int buf_width, int buf_height,
                            int center_x_offset,
-                           std::vector<std::vector<ProjAtom>>& chains_out,
-                           int& global_total) {
+                           std::pmr::vector<std::pmr::vector<ProjAtom>>& chains_out,
+                           int& global_total,
+                           ProjParams* params_out = nullptr,
+                           bool trace_only = false) {
     global_total = 0;
 
+    float fovRads = 1.0f / tanf((FOV / zoom_level) * 0.5f / 180.0f * PI);
+    float half_w = buf_width * 0.5f + center_x_offset;
+    float half_h = buf_height * 0.5f;
+    float scale = std::min(half_w, half_h);
+    // screen pixels per model unit near the focal plane, drives cartoon tessellation
+    float px_per_unit = fovRads * scale / focal_offset;
+
+    std::pmr::vector<std::map<std::string, std::vector<Atom>>*> render(data.size(),
+                                                                        chains_out.get_allocator().resource());
+    for (size_t ii = 0; ii < data.size(); ii++)
+        render[ii] = trace_only ? &data[ii]->get_atoms() : &data[ii]->get_render_atoms(px_per_unit);
+
+    // center and color ramp follow the trace, so neither moves when the
+    // cartoon is tessellated again or toggled
     float cx = 0, cy = 0, cz = 0;
     int count = 0;
     for (auto* p : data) {
@@ -866,117 +1119,122 @@ static void project_atoms(std::vector<Protein*>& data,
         }
     }
     if (count > 0) { cx /= count; cy /= count; cz /= count; }
-
     int total_chains = 0;
-    for (auto* p : data) {
-        for (const auto& [cid, atoms] : p->get_atoms())
-            total_chains++;
-    }
+    for (auto* atoms_map : render) total_chains += (int)atoms_map->size();
+    if (params_out) *params_out = {cx, cy, cz, fovRads, half_w, half_h, scale};
 
-    float fovRads = 1.0f / tanf((FOV / zoom_level) * 0.5f / 180.0f * PI);
-    float half_w = buf_width * 0.5f + center_x_offset;
-    float half_h = buf_height * 0.5f;
-    float scale = std::min(half_w, half_h);
-    int global_idx = 0;
+    int global_base = 0;
     int chain_idx = 0;
 
     for (size_t ii = 0; ii < data.size(); ii++) {
         Protein* target = data[ii];
-        for (const auto& [chainID, chain_atoms] : target->get_atoms()) {
-            int num_atoms = target->get_chain_length(chainID);
-            if (num_atoms == 0) { chain_idx++; continue; }
-
-            std::vector<ProjAtom> chain;
-            for (int i = 0; i < num_atoms; i++) {
-                float* pos = chain_atoms[i].get_position();
-                char ss = chain_atoms[i].get_structure();
-                float x = pos[0] - cx, y = pos[1] - cy;
-                float z = (pos[2] - cz) + focal_offset;
+        float min_z = target->get_scaled_min_z();
+        float max_z = target->get_scaled_max_z();
+        int residue_base = 0;
+        for (const auto& [chainID, chain_atoms] : *render[ii]) {
+            int chain_residues = target->get_chain_length(chainID);
+            // get_atoms() keeps cartoon control points after the trace
+            size_t n = (render[ii] == &target->get_atoms()) ? std::min(chain_atoms.size(), (size_t)chain_residues)
+                                                            : chain_atoms.size();
+            if (n == 0) { chain_idx++; residue_base += chain_residues; continue; }
+
+            // allocated like chains_out, the outer vector hands its resource on
+            std::pmr::vector<ProjAtom>& chain = chains_out.emplace_back();
+            chain.reserve(n);
+            for (size_t ai = 0; ai < n; ai++) {
+                const Atom& atom = chain_atoms[ai];
+                // trace points are their residue, cartoon points say which one
+                int residue = residue_base + (atom.residue >= 0 ? atom.residue : (int)chain.size());
+                float x = atom.x - cx, y = atom.y - cy;
+                float z = (atom.z - cz) + focal_offset;
 
                 float projX = (x / z) * fovRads + pan_x[ii];
                 float projY = (y / z) * fovRads + pan_y[ii];
                 int sx = (int)(half_w + projX * scale);
                 int sy = (int)(half_h - projY * scale);
 
-                float min_z = target->get_scaled_min_z();
-                float max_z = target->get_scaled_max_z();
-                float zn = (max_z > min_z) ? ((pos[2] - min_z) / (max_z - min_z)) : 0.5f;
+                float zn = (max_z > min_z) ? ((atom.z - min_z) / (max_z - min_z)) : 0.5f;
                 zn = std::clamp(zn, 0.0f, 1.0f);
                 float brightness = 1.0f - zn * 0.65f;
 
                 chain.push_back({sx, sy, z, brightness, {0, 0, 0},
-                                 chain_idx, total_chains, ss, global_idx});
-                global_idx++;
+                                 chain_idx, total_chains, atom.structure, atom.new_stroke,
+                                 global_base + residue, atom.x, atom.y, atom.z, (int)ii, atom.occlusion,
+                                 atom.hidden, atom.highlight, atom.color, atom.exposure,
+                                 atom.interface, residue_id((int)ii, residue)});
             }
-            chains_out.push_back(std::move(chain));
             chain_idx++;
+            residue_base += chain_residues;
         }
+        global_base += residue_base;
     }
 }
 
 // --- View: Backbone ---
 
 void UnicodeScreen::project_backbone() {
-    std::vector<std::vector<ProjAtom>> chains;
+    std::pmr::vector<std::pmr::vector<ProjAtom>> chains(&arena);
     int global_total;
     project_atoms(data, pan_x, zoom_level, focal_offset, pan_y,
-                  buf_width, buf_height, sidebar_cols, chains, global_total);
-
-    for (auto& chain : chains) {
-        for (size_t i = 0; i < chain.size(); i++) {
-            auto& a = chain[i];
-            RGB color;
-            switch (color_scheme) {
-                case ColorScheme::RAINBOW:   color = get_color_for_point(a.global_idx, global_total); break;
-                case ColorScheme::CHAIN:     color = get_chain_color(a.chain_idx, a.total_chains); break;
-                case ColorScheme::STRUCTURE: color = get_ss_color(a.ss_type); break;
-            }
-            if (i > 0) {
-                draw_line(chain[i-1].sx, chain[i-1].sy, chain[i-1].z,
-                          a.sx, a.sy, a.z, color, a.brightness);
+                  buf_width, buf_height, sidebar_cols, chains, global_total, &view_cam);
+
+    dispatch_kernel(color_scheme, use_sixel, [&](auto scheme, auto sixel) {
+        const int thick = (sixel ? 2 : 1) * px_scale;
+        const int dot_r = (sixel ? 3 : 1) * px_scale;
+        for (auto& chain : chains) {
+            for (size_t i = 0; i < chain.size(); i++) {
+                auto& a = chain[i];
+                if (a.hidden) continue;
+                RGB color = scheme_color<scheme>(a.global_idx, global_total, a.chain_idx, a.total_chains,
+                                                 a.ss_type, a.exposure, a.interface);
+                float brightness = a.brightness;
+                apply_style(a, color, brightness);
+                if (i > 0 && !a.new_stroke && !chain[i-1].hidden) {
+                    raster.line(chain[i-1].sx, chain[i-1].sy, chain[i-1].z,
+                                a.sx, a.sy, a.z, thick, color, brightness,
+                                (chain[i-1].occlusion + a.occlusion) * 0.5f, a.pick);
+                }
+                if (a.highlight)
+                    raster.circle(a.sx, a.sy, a.z, dot_r, color, brightness, a.occlusion, a.pick);
             }
         }
-    }
+    });
 }
 
 // --- View: Surface Grid (wireframe mesh) ---
 
 void UnicodeScreen::project_grid() {
-    std::vector<std::vector<ProjAtom>> chains;
+    // the mesh joins residues, so it is built on the trace whatever the cartoon
+    // shows; ribbon samples would also multiply the pairs tested for contacts
+    std::pmr::vector<std::pmr::vector<ProjAtom>> chains(&arena);
     int global_total;
     project_atoms(data, pan_x, zoom_level, focal_offset, pan_y,
-                  buf_width, buf_height, sidebar_cols, chains, global_total);
+                  buf_width, buf_height, sidebar_cols, chains, global_total, &view_cam, true);
 
     struct FlatAtom {
         int sx, sy;
         float z, brightness;
         float x3d, y3d, z3d;
         RGB color;
+        float occlusion;
+        bool hidden;
+        uint32_t pick;
     };
-    std::vector<FlatAtom> all_atoms;
-
-    int chain_offset = 0;
-    for (size_t ii = 0; ii < data.size(); ii++) {
-        Protein* target = data[ii];
-        for (const auto& [chainID, chain_atoms] : target->get_atoms()) {
-            int num_atoms = target->get_chain_length(chainID);
-            for (int i = 0; i < num_atoms; i++) {
-                float* pos = chain_atoms[i].get_position();
-                if (chain_offset < (int)chains.size() && i < (int)chains[chain_offset].size()) {
-                    auto& pa = chains[chain_offset][i];
-                    RGB color;
-                    switch (color_scheme) {
-                        case ColorScheme::RAINBOW:   color = get_color_for_point(pa.global_idx, global_total); break;
-                        case ColorScheme::CHAIN:     color = get_chain_color(pa.chain_idx, pa.total_chains); break;
-                        case ColorScheme::STRUCTURE: color = get_ss_color(pa.ss_type); break;
-                    }
-                    all_atoms.push_back({pa.sx, pa.sy, pa.z, pa.brightness,
-                                         pos[0], pos[1], pos[2], color});
-                }
+    std::pmr::vector<FlatAtom> all_atoms(&arena);
+    all_atoms.reserve(global_total);
+
+    dispatch_kernel(color_scheme, use_sixel, [&](auto scheme, auto) {
+        for (auto& chain : chains) {
+            for (auto& pa : chain) {
+                RGB color = scheme_color<scheme>(pa.global_idx, global_total, pa.chain_idx, pa.total_chains,
+                                                 pa.ss_type, pa.exposure, pa.interface);
+                float brightness = pa.brightness;
+                apply_style(pa, color, brightness);
+                all_atoms.push_back({pa.sx, pa.sy, pa.z, brightness,
+                                     pa.x3d, pa.y3d, pa.z3d, color, pa.occlusion, pa.hidden, pa.pick});
             }
-            chain_offset++;
         }
-    }
+    });
 
     float avg_dist = 0;
     int dist_count = 0;
@@ -994,160 +1252,601 @@ void UnicodeScreen::project_grid() {
 
     int n = (int)all_atoms.size();
 
+    // backbone, then contacts, then dots, each front to back
+    std::pmr::vector<std::pair<int, int>> segments(&arena), contacts(&arena);
+    std::pmr::vector<float> key(&arena);
     int flat_idx = 0;
     for (auto& chain : chains) {
         for (size_t i = 1; i < chain.size(); i++) {
             int ai = flat_idx + (int)i - 1;
             int bi = flat_idx + (int)i;
+            if (chain[i].new_stroke || chain[i].hidden || chain[i - 1].hidden) continue;
             if (ai >= 0 && ai < n && bi < n) {
-                RGB color = all_atoms[bi].color;
-                float br = (all_atoms[ai].brightness + all_atoms[bi].brightness) * 0.5f;
-                draw_line(all_atoms[ai].sx, all_atoms[ai].sy, all_atoms[ai].z,
-                          all_atoms[bi].sx, all_atoms[bi].sy, all_atoms[bi].z,
-                          color, br);
+                segments.push_back({ai, bi});
+                key.push_back(std::min(all_atoms[ai].z, all_atoms[bi].z));
             }
         }
         flat_idx += (int)chain.size();
     }
+    const int thick = (use_sixel ? 2 : 1) * px_scale;
+    for (uint32_t s : front_to_back(key)) {
+        auto [ai, bi] = segments[s];
+        RGB color = all_atoms[bi].color;
+        float br = (all_atoms[ai].brightness + all_atoms[bi].brightness) * 0.5f;
+        float ao = (all_atoms[ai].occlusion + all_atoms[bi].occlusion) * 0.5f;
+        raster.line(all_atoms[ai].sx, all_atoms[ai].sy, all_atoms[ai].z,
+                    all_atoms[bi].sx, all_atoms[bi].sy, all_atoms[bi].z,
+                    thick, color, br, ao, all_atoms[bi].pick);
+    }
 
+    key.clear();
     for (int i = 0; i < n; i++) {
         for (int j = i + 3; j < n; j++) {
             float dx = all_atoms[i].x3d - all_atoms[j].x3d;
             float dy = all_atoms[i].y3d - all_atoms[j].y3d;
             float dz = all_atoms[i].z3d - all_atoms[j].z3d;
             float dist = sqrtf(dx*dx + dy*dy + dz*dz);
-            if (dist < threshold) {
-                RGB color = all_atoms[j].color;
-                float br = (all_atoms[i].brightness + all_atoms[j].brightness) * 0.5f;
-                int ddx = all_atoms[j].sx - all_atoms[i].sx;
-                int ddy = all_atoms[j].sy - all_atoms[i].sy;
-                int steps = std::max(abs(ddx), abs(ddy));
-                if (steps == 0) continue;
-                float xInc = (float)ddx / steps;
-                float yInc = (float)ddy / steps;
-                float zInc = (all_atoms[j].z - all_atoms[i].z) / steps;
-                float px = (float)all_atoms[i].sx, py = (float)all_atoms[i].sy;
-                float pz = all_atoms[i].z;
-                for (int s = 0; s <= steps; s++) {
-                    plot_pixel((int)(px + 0.5f), (int)(py + 0.5f), pz, color, br * 0.7f);
-                    px += xInc; py += yInc; pz += zInc;
-                }
+            if (dist < threshold && !all_atoms[i].hidden && !all_atoms[j].hidden) {
+                if (all_atoms[j].sx == all_atoms[i].sx && all_atoms[j].sy == all_atoms[i].sy) continue;
+                contacts.push_back({i, j});
+                key.push_back(std::min(all_atoms[i].z, all_atoms[j].z));
             }
         }
     }
+    for (uint32_t k : front_to_back(key)) {
+        auto [i, j] = contacts[k];
+        RGB color = all_atoms[j].color;
+        float br = (all_atoms[i].brightness + all_atoms[j].brightness) * 0.5f;
+        float ao = (all_atoms[i].occlusion + all_atoms[j].occlusion) * 0.5f;
+        raster.line(all_atoms[i].sx, all_atoms[i].sy, all_atoms[i].z,
+                    all_atoms[j].sx, all_atoms[j].sy, all_atoms[j].z, px_scale - 1, color, br * 0.7f, ao,
+                    all_atoms[j].pick);
+    }
 
-    int dot_r = use_sixel ? 3 : 1;
-    for (int i = 0; i < n; i++)
-        draw_filled_circle(all_atoms[i].sx, all_atoms[i].sy, all_atoms[i].z,
-                           dot_r, all_atoms[i].color, all_atoms[i].brightness);
+    key.resize(n);
+    for (int i = 0; i < n; i++) key[i] = all_atoms[i].z;
+    int dot_r = (use_sixel ? 3 : 1) * px_scale;
+    for (uint32_t i : front_to_back(key))
+        if (!all_atoms[i].hidden)
+            raster.circle(all_atoms[i].sx, all_atoms[i].sy, all_atoms[i].z,
+                          dot_r, all_atoms[i].color, all_atoms[i].brightness, all_atoms[i].occlusion,
+                          all_atoms[i].pick);
 }
 
 // --- View: Surface ---
 
 void UnicodeScreen::project_surface() {
-    std::vector<std::vector<ProjAtom>> chains;
+    std::pmr::vector<std::pmr::vector<ProjAtom>> chains(&arena);
     int global_total;
+    ProjParams cam;
     project_atoms(data, pan_x, zoom_level, focal_offset, pan_y,
-                  buf_width, buf_height, sidebar_cols, chains, global_total);
+                  buf_width, buf_height, sidebar_cols, chains, global_total, &cam);
+    view_cam = cam;
+
+    int total_ca = 0, total_chains = 0;
+    for (auto* p : data) { total_ca += p->get_length(); total_chains += (int)p->get_atoms().size(); }
+
+    // Mesh: only the vertices are re-projected; the surface itself is built
+    // once per structure in the background. Facets of all structures are
+    // drawn together, front to back.
+    std::pmr::vector<char> meshed(data.size(), 0, &arena);
+    std::pmr::vector<RasterVertex> facets(&arena);
+    std::pmr::vector<uint32_t> facet_ids(&arena);
+    std::pmr::vector<float> key(&arena);
+    int ca_base = 0, chain_base = 0;
+    for (size_t ii = 0; ii < data.size(); ii++) {
+        Protein* p = data[ii];
+        const SurfaceMesh* mesh = p->get_surface();
+        float m[12];
+        if (mesh && p->get_surface_transform(m)) {
+            meshed[ii] = 1;
+
+            // per-residue colors, in the same order as the mesh atom indices
+            std::pmr::vector<const Atom*> trace(&arena);
+            std::pmr::vector<RGB> ca_colors(&arena);
+            residue_colors(p, ca_base, total_ca, chain_base, total_chains, ca_colors, trace);
+            std::pmr::vector<float> ca_occlusion(&arena);
+            std::pmr::vector<char> ca_hidden(&arena), ca_highlight(&arena);
+            for (const Atom* a : trace) {
+                ca_occlusion.push_back(a->occlusion);
+                ca_hidden.push_back(a->hidden);
+                ca_highlight.push_back(a->highlight);
+            }
+
+            float min_z = p->get_scaled_min_z();
+            float max_z = p->get_scaled_max_z();
+            size_t nv = mesh->num_vertices();
+            std::pmr::vector<RasterVertex> verts(nv, &arena);
+            std::pmr::vector<float> wx(nv, &arena), wy(nv, &arena), wz(nv, &arena);
+            for (size_t v = 0; v < nv; v++) {
+                float X = m[0] * mesh->x[v] + m[1] * mesh->y[v] + m[2] * mesh->z[v] + m[9];
+                float Y = m[3] * mesh->x[v] + m[4] * mesh->y[v] + m[5] * mesh->z[v] + m[10];
+                float Z = m[6] * mesh->x[v] + m[7] * mesh->y[v] + m[8] * mesh->z[v] + m[11];
+                wx[v] = X; wy[v] = Y; wz[v] = Z;
+
+                float z = (Z - cam.cz) + focal_offset;
+                float projX = ((X - cam.cx) / z) * cam.fovRads + pan_x[ii];
+                float projY = ((Y - cam.cy) / z) * cam.fovRads + pan_y[ii];
+                float zn = (max_z > min_z) ? ((Z - min_z) / (max_z - min_z)) : 0.5f;
+                zn = std::clamp(zn, 0.0f, 1.0f);
+                int a = mesh->atom[v];
+                bool known = a < (int)ca_colors.size();
+                verts[v] = {cam.half_w + projX * cam.scale, cam.half_h - projY * cam.scale, z,
+                            known ? ca_colors[a] : fg_color,
+                            (known && ca_highlight[a]) ? 1.0f : 1.0f - zn * 0.65f,
+                            known ? ca_occlusion[a] : 1.0f};
+                if (known && ca_hidden[a]) verts[v].z = -1.0f;   // culled with its triangles
+            }
+
+            for (size_t t = 0; t < mesh->tris.size(); t += 3) {
+                uint32_t a = mesh->tris[t], b = mesh->tris[t + 1], c = mesh->tris[t + 2];
+                if (verts[a].z <= 0.01f || verts[b].z <= 0.01f || verts[c].z <= 0.01f) continue;
+
+                // facing ratio of the facet, either side, on top of the depth cue
+                float e1x = wx[b] - wx[a], e1y = wy[b] - wy[a], e1z = wz[b] - wz[a];
+                float e2x = wx[c] - wx[a], e2y = wy[c] - wy[a], e2z = wz[c] - wz[a];
+                float nx = e1y * e2z - e1z * e2y, ny = e1z * e2x - e1x * e2z, nz = e1x * e2y - e1y * e2x;
+                float len = sqrtf(nx * nx + ny * ny + nz * nz);
+                float facing = (len > 0.0f) ? fabsf(nz) / len : 1.0f;
+                float light = 0.55f + 0.45f * facing;
+
+                for (uint32_t v : {a, b, c}) {
+                    facets.push_back(verts[v]);
+                    facets.back().brightness *= light;
+                }
+                key.push_back(std::min({verts[a].z, verts[b].z, verts[c].z}));
+                // named after the residue of its first corner
+                int r = mesh->atom[a];
+                facet_ids.push_back(r < (int)ca_colors.size() ? residue_id((int)ii, r) : Rasterizer::NO_ID);
+            }
+        }
+        ca_base += p->get_length();
+        chain_base += (int)p->get_atoms().size();
+    }
+    for (uint32_t t : front_to_back(key))
+        draw_triangle(facets[3 * t], facets[3 * t + 1], facets[3 * t + 2], facet_ids[t]);
 
-    float r_scale = use_sixel ? 4.0f : 1.0f;
+    // Disc stamps until a structure's mesh is ready
+    std::pmr::vector<const ProjAtom*> discs(&arena);
+    key.clear();
     for (auto& chain : chains) {
         for (auto& a : chain) {
-            RGB color;
-            switch (color_scheme) {
-                case ColorScheme::RAINBOW:   color = get_color_for_point(a.global_idx, global_total); break;
-                case ColorScheme::CHAIN:     color = get_chain_color(a.chain_idx, a.total_chains); break;
-                case ColorScheme::STRUCTURE: color = get_ss_color(a.ss_type); break;
-            }
+            if (meshed[a.protein_idx] || a.hidden) continue;
+            discs.push_back(&a);
+            key.push_back(a.z);
+        }
+    }
+    const std::pmr::vector<uint32_t> order = front_to_back(key);
+    dispatch_kernel(color_scheme, use_sixel, [&](auto scheme, auto sixel) {
+        const float r_scale = (sixel ? 4.0f : 1.0f) * px_scale;
+        for (uint32_t d : order) {
+            const ProjAtom& a = *discs[d];
+            RGB color = scheme_color<scheme>(a.global_idx, global_total, a.chain_idx, a.total_chains,
+                                             a.ss_type, a.exposure, a.interface);
+            float brightness = a.brightness;
+            apply_style(a, color, brightness);
             int radius = (int)((3.0f + a.brightness * 3.0f) * r_scale);
-            draw_filled_circle(a.sx, a.sy, a.z, radius, color, a.brightness);
+            raster.circle(a.sx, a.sy, a.z, radius, color, brightness, a.occlusion, a.pick);
         }
+    });
+}
+
+// --- View: All atoms ---
+
+// Atoms per display cell (braille cell, or pixel with Sixel) above which a
+// screen tile is drawn as CA trace instead
+static const float ATOM_DENSITY_BRAILLE = 1.5f;
+static const float ATOM_DENSITY_SIXEL = 0.05f;
+
+static RGB element_color(char element, RGB carbon) {
+    switch (element) {
+        case 'N': return {70, 110, 230};
+        case 'O': return {230, 60, 50};
+        case 'S': return {230, 200, 50};
+        case 'P': return {240, 140, 40};
+        case 'X': return {170, 170, 170};
+        default:  return carbon;
     }
 }
 
+void UnicodeScreen::residue_colors(Protein* p, int ca_base, int total_ca, int chain_base, int total_chains,
+                                   std::pmr::vector<RGB>& colors, std::pmr::vector<const Atom*>& trace) {
+    colors.clear();
+    colors.reserve(p->get_length());
+    trace.clear();
+    dispatch_kernel(color_scheme, use_sixel, [&](auto scheme, auto) {
+        int chain_idx = chain_base;
+        for (auto& [cid, atoms] : p->get_atoms()) {
+            int n = p->get_chain_length(cid);
+            for (int k = 0; k < n; k++) {
+                const Atom& a = atoms[k];
+                colors.push_back(scheme_color<scheme>(ca_base + (int)colors.size(), total_ca, chain_idx, total_chains,
+                                                      a.structure, a.exposure, a.interface));
+                if (a.color >= 0) colors.back() = {(uint8_t)(a.color >> 16), (uint8_t)(a.color >> 8), (uint8_t)a.color};
+                trace.push_back(&a);
+            }
+            chain_idx++;
+        }
+    });
+}
+
+void UnicodeScreen::project_full_atoms() {
+    std::pmr::vector<std::pmr::vector<ProjAtom>> chains(&arena);
+    int global_total;
+    ProjParams cam;
+    project_atoms(data, pan_x, zoom_level, focal_offset, pan_y,
+                  buf_width, buf_height, sidebar_cols, chains, global_total, &cam);
+    view_cam = cam;
+
+    int total_ca = 0, total_chains = 0;
+    for (auto* p : data) { total_ca += p->get_length(); total_chains += (int)p->get_atoms().size(); }
+
+    struct Projected {
+        std::pmr::vector<float> sx, sy, z, brightness;
+        explicit Projected(std::pmr::memory_resource* mem) : sx(mem), sy(mem), z(mem), brightness(mem) {}
+    };
+    auto project = [&](size_t ii, float min_z, float max_z, float X, float Y, float Z,
+                       float& sx, float& sy, float& z, float& brightness) {
+        z = (Z - cam.cz) + focal_offset;
+        sx = cam.half_w + (((X - cam.cx) / z) * cam.fovRads + pan_x[ii]) * cam.scale;
+        sy = cam.half_h - (((Y - cam.cy) / z) * cam.fovRads + pan_y[ii]) * cam.scale;
+        float zn = (max_z > min_z) ? ((Z - min_z) / (max_z - min_z)) : 0.5f;
+        brightness = 1.0f - std::clamp(zn, 0.0f, 1.0f) * 0.65f;
+    };
+
+    // Project every atom and bin it into screen tiles; the histogram decides,
+    // per frame, where atoms are too dense to be worth drawing one by one
+    const int tile = (use_sixel ? 32 : 16) * px_scale;
+    const float cell_px = use_sixel ? 1.0f : 8.0f;
+    const int limit = (int)((use_sixel ? ATOM_DENSITY_SIXEL : ATOM_DENSITY_BRAILLE) * tile * tile / cell_px);
+    const int tiles_x = (buf_width + tile - 1) / tile, tiles_y = (buf_height + tile - 1) / tile;
+    std::pmr::vector<int> hist((size_t)tiles_x * tiles_y, 0, &arena);
+    auto tile_of = [&](float x, float y) -> int {
+        if (!(x >= 0.0f && y >= 0.0f && x < buf_width && y < buf_height)) return -1;
+        return ((int)y / tile) * tiles_x + (int)x / tile;
+    };
+
+    std::pmr::vector<Projected> proj(&arena);
+    proj.reserve(data.size());
+    for (size_t ii = 0; ii < data.size(); ii++) proj.emplace_back(&arena);
+    std::pmr::vector<const FullAtoms*> full(data.size(), nullptr, &arena);
+    for (size_t ii = 0; ii < data.size(); ii++) {
+        Protein* p = data[ii];
+        float m[12];
+        const FullAtoms& atoms = p->get_full_atoms();
+        if (atoms.size() == 0 || !p->get_surface_transform(m)) continue;
+        full[ii] = &atoms;
+
+        float min_z = p->get_scaled_min_z(), max_z = p->get_scaled_max_z();
+        const size_t n = atoms.size();
+        Projected& pr = proj[ii];
+        pr.sx.resize(n); pr.sy.resize(n); pr.z.resize(n); pr.brightness.resize(n);
+        const std::vector<float>& ax = atoms.table.x;
+        const std::vector<float>& ay = atoms.table.y;
+        const std::vector<float>& az = atoms.table.z;
+        parallel_for((n + 4095) / 4096, [&](size_t blk) {
+            for (size_t i = blk * 4096; i < std::min(n, (blk + 1) * 4096); i++) {
+                float X = m[0] * ax[i] + m[1] * ay[i] + m[2] * az[i] + m[9];
+                float Y = m[3] * ax[i] + m[4] * ay[i] + m[5] * az[i] + m[10];
+                float Z = m[6] * ax[i] + m[7] * ay[i] + m[8] * az[i] + m[11];
+                project(ii, min_z, max_z, X, Y, Z, pr.sx[i], pr.sy[i], pr.z[i], pr.brightness[i]);
+            }
+        });
+        for (size_t i = 0; i < n; i++) {
+            int t = tile_of(pr.sx[i], pr.sy[i]);
+            if (t >= 0 && pr.z[i] > 0.01f) hist[t]++;
+        }
+    }
+    auto dense = [&](float x, float y) {
+        int t = tile_of(x, y);
+        return t >= 0 && hist[t] > limit;
+    };
+
+    int ca_base = 0, chain_base = 0;
+    int dot_r = (use_sixel ? 3 : 0) * px_scale;
+    for (size_t ii = 0; ii < data.size(); ii++) {
+        Protein* p = data[ii];
+        std::pmr::vector<const Atom*> trace(&arena);
+        std::pmr::vector<RGB> colors(&arena);
+        residue_colors(p, ca_base, total_ca, chain_base, total_chains, colors, trace);
+        ca_base += p->get_length();
+        chain_base += (int)p->get_atoms().size();
+
+        // A residue is drawn whole, as atoms or as trace, by the tile its CA is in
+        float min_z = p->get_scaled_min_z(), max_z = p->get_scaled_max_z();
+        const size_t n_res = trace.size();
+        std::pmr::vector<float> tx(n_res, &arena), ty(n_res, &arena), tz(n_res, &arena), tb(n_res, &arena);
+        std::pmr::vector<char> coarse(n_res, &arena);
+        for (size_t r = 0; r < n_res; r++) {
+            project(ii, min_z, max_z, trace[r]->x, trace[r]->y, trace[r]->z, tx[r], ty[r], tz[r], tb[r]);
+            coarse[r] = !full[ii] || dense(tx[r], ty[r]);
+        }
+
+        // trace wherever either end of a segment is coarse
+        size_t row = 0;
+        for (auto& [cid, atoms] : p->get_atoms()) {
+            int n = p->get_chain_length(cid);
+            for (int k = 1; k < n; k++) {
+                size_t a = row + k - 1, b = row + k;
+                if (!(coarse[a] || coarse[b]) || trace[a]->hidden || trace[b]->hidden) continue;
+                if (tz[a] <= 0.01f || tz[b] <= 0.01f) continue;
+                float br = trace[b]->highlight ? 1.0f : (tb[a] + tb[b]) * 0.5f;
+                draw_line((int)tx[a], (int)ty[a], tz[a], (int)tx[b], (int)ty[b], tz[b],
+                          colors[b], br, (trace[a]->occlusion + trace[b]->occlusion) * 0.5f,
+                          residue_id((int)ii, (int)b));
+            }
+            row += n;
+        }
+        if (!full[ii]) continue;
+
+        const FullAtoms& atoms = *full[ii];
+        const Projected& pr = proj[ii];
+        const size_t n = atoms.size();
+        // 0 : skipped, 1 : single dot, 2 : full atom with bonds
+        std::pmr::vector<char> shown(n, 0, &arena);
+        std::pmr::vector<RGB> color(n, &arena);
+        std::pmr::vector<float> light(n, &arena), ao(n, 1.0f, &arena);
+        for (size_t i = 0; i < n; i++) {
+            if (pr.z[i] <= 0.01f) continue;
+            int r = atoms.residue[i];
+            RGB carbon = fg_color;
+            light[i] = pr.brightness[i];
+            if (r >= 0) {
+                if (coarse[r] || trace[r]->hidden) continue;
+                carbon = colors[r];
+                ao[i] = trace[r]->occlusion;
+                if (trace[r]->highlight) light[i] = 1.0f;
+                shown[i] = 2;
+            } else {
+                // no trace stands in for ligands, so they thin out to dots instead
+                shown[i] = dense(pr.sx[i], pr.sy[i]) ? 1 : 2;
+            }
+            color[i] = (r >= 0 && trace[r]->color >= 0) ? carbon : element_color(atoms.element[i], carbon);
+        }
+
+        // ligands have no residue to name
+        auto id = [&](size_t i) {
+            return atoms.residue[i] >= 0 ? residue_id((int)ii, atoms.residue[i]) : Rasterizer::NO_ID;
+        };
+        // half bonds in the color of their atom
+        for (size_t k = 0; k < atoms.bonds.size(); k += 2) {
+            uint32_t a = atoms.bonds[k], b = atoms.bonds[k + 1];
+            if (shown[a] != 2 || shown[b] != 2) continue;
+            int mx = (int)((pr.sx[a] + pr.sx[b]) * 0.5f), my = (int)((pr.sy[a] + pr.sy[b]) * 0.5f);
+            float mz = (pr.z[a] + pr.z[b]) * 0.5f;
+            draw_line((int)pr.sx[a], (int)pr.sy[a], pr.z[a], mx, my, mz, color[a], light[a], ao[a], id(a));
+            draw_line(mx, my, mz, (int)pr.sx[b], (int)pr.sy[b], pr.z[b], color[b], light[b], ao[b], id(b));
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (shown[i] == 2 && dot_r > 0)
+                draw_filled_circle((int)pr.sx[i], (int)pr.sy[i], pr.z[i], dot_r, color[i], light[i], ao[i], id(i));
+            else if (shown[i])
+                plot_pixel((int)pr.sx[i], (int)pr.sy[i], pr.z[i], color[i], light[i], ao[i], id(i));
+        }
+    }
+}
+
+// --- Density map overlay ---
+
+// Chicken-wire mesh of the map over any 3D view, placed like the surface
+// mesh through the first structure's Angstrom-to-screen transform.
+void UnicodeScreen::project_density() {
+    if (!density.is_open() || data.empty() || view_mode == ViewMode::CONTACT_MAP) return;
+    float m[12];
+    if (!data[0]->get_surface_transform(m)) return;
+    const ProjParams& cam = view_cam;
+    const RGB mesh_color = {90, 150, 255};
+    float min_z = data[0]->get_scaled_min_z();
+    float max_z = data[0]->get_scaled_max_z();
+
+    struct Vertex { int sx, sy; float z, brightness; };
+    std::pmr::vector<Vertex> verts(&arena);
+    for (uint32_t b : density.active_bricks()) {
+        const DensityMap::BrickMesh& mesh = density.brick_mesh(b);
+        verts.resize(mesh.x.size());
+        for (size_t v = 0; v < verts.size(); v++) {
+            float X = m[0] * mesh.x[v] + m[1] * mesh.y[v] + m[2] * mesh.z[v] + m[9];
+            float Y = m[3] * mesh.x[v] + m[4] * mesh.y[v] + m[5] * mesh.z[v] + m[10];
+            float Z = m[6] * mesh.x[v] + m[7] * mesh.y[v] + m[8] * mesh.z[v] + m[11];
+            float z = (Z - cam.cz) + focal_offset;
+            float projX = ((X - cam.cx) / z) * cam.fovRads + pan_x[0];
+            float projY = ((Y - cam.cy) / z) * cam.fovRads + pan_y[0];
+            float zn = (max_z > min_z) ? std::clamp((Z - min_z) / (max_z - min_z), 0.0f, 1.0f) : 0.5f;
+            verts[v] = {(int)(cam.half_w + projX * cam.scale), (int)(cam.half_h - projY * cam.scale), z,
+                        0.9f - zn * 0.6f};
+        }
+        for (size_t t = 0; t < mesh.tris.size(); t += 3) {
+            for (int e = 0; e < 3; e++) {
+                const Vertex& a = verts[mesh.tris[t + e]];
+                const Vertex& c = verts[mesh.tris[t + (e + 1) % 3]];
+                if (a.z <= 0.01f || c.z <= 0.01f) continue;
+                draw_line(a.sx, a.sy, a.z, c.sx, c.sy, c.z, mesh_color, (a.brightness + c.brightness) * 0.5f);
+            }
+        }
+    }
+}
+
+// --- View: Contact map ---
+
+Protein* UnicodeScreen::focus_protein() {
+    if (data.empty()) return nullptr;
+    return data[(structNum >= 0 && structNum < (int)data.size()) ? structNum : 0];
+}
+
+void UnicodeScreen::project_contact_map() {
+    Protein* p = focus_protein();
+    if (!p) return;
+    ContactMap& cmap = p->get_contact_map();
+    const int n = (int)cmap.size();
+    if (n == 0) return;
+
+    // square raster, each bin max-pooled over the residues it covers and
+    // scaled up by whole pixels when there are fewer residues than pixels
+    int square = std::min(buf_width - sidebar_cols, buf_height);
+    int bins = std::max(1, std::min(square, n));
+    int cell = std::max(1, square / bins);
+    int extent = bins * cell;
+    int ox = sidebar_cols + (buf_width - sidebar_cols - extent) / 2;
+    int oy = (buf_height - extent) / 2;
+    const std::vector<float>& pool = cmap.pooled(bins);
+
+    for (int by = 0; by < bins; by++) {
+        for (int bx = 0; bx < bins; bx++) {
+            float v = pool[(size_t)by * bins + bx];
+            if (v <= 0.0f) continue;
+            RGB color = interpolate_color(v);
+            for (int cy = 0; cy < cell; cy++)
+                for (int cx = 0; cx < cell; cx++)
+                    plot_pixel(ox + bx * cell + cx, oy + by * cell + cy, 1.0f, color, 0.5f + 0.5f * v);
+        }
+    }
+
+    // chain boundaries
+    const CATrace& trace = cmap.get_trace();
+    RGB dim = {(uint8_t)(fg_color.r / 3), (uint8_t)(fg_color.g / 3), (uint8_t)(fg_color.b / 3)};
+    for (int i = 1; i < n; i++) {
+        if (trace.chain[i] == trace.chain[i - 1]) continue;
+        int b = (int)((size_t)i * bins / n) * cell + cell / 2;
+        for (int t = 0; t < extent; t += 2) {
+            plot_pixel(ox + b, oy + t, 2.0f, dim, 1.0f);
+            plot_pixel(ox + t, oy + b, 2.0f, dim, 1.0f);
+        }
+    }
+
+    // cursor crosshair, dashed so the map stays readable underneath
+    contact_cursor_i = std::clamp(contact_cursor_i, 0, n - 1);
+    contact_cursor_j = std::clamp(contact_cursor_j, 0, n - 1);
+    int cy = oy + (int)((size_t)contact_cursor_i * bins / n) * cell + cell / 2;
+    int cx = ox + (int)((size_t)contact_cursor_j * bins / n) * cell + cell / 2;
+    for (int t = 0; t < extent; t += 3) {
+        plot_pixel(ox + t, cy, 0.0f, fg_color, 1.0f);
+        plot_pixel(cx, oy + t, 0.0f, fg_color, 1.0f);
+    }
+    draw_filled_circle(cx, cy, -1.0f, (use_sixel ? 4 : 1) * px_scale, fg_color, 1.0f);
+}
+
+void UnicodeScreen::contact_cursor_label(std::string& out) {
+    Protein* p = focus_protein();
+    if (!p || p->get_contact_map().empty()) { out += "no residues"; return; }
+    ContactMap& cmap = p->get_contact_map();
+    const CATrace& t = cmap.get_trace();
+    int i = std::clamp(contact_cursor_i, 0, (int)cmap.size() - 1);
+    int j = std::clamp(contact_cursor_j, 0, (int)cmap.size() - 1);
+
+    char buf[192];
+    float d = cmap.distance(i, j);
+    int n = snprintf(buf, sizeof(buf), "%s:%d %c  \xE2\x80\x94  %s:%d %c", t.chain[i].c_str(), t.resnum[i], t.seq[i],
+                     t.chain[j].c_str(), t.resnum[j], t.seq[j]);
+    n = std::clamp(n, 0, (int)sizeof(buf) - 1);
+    if (d >= 0.0f) snprintf(buf + n, sizeof(buf) - n, "  CA-CA %.1f A", d);
+    else snprintf(buf + n, sizeof(buf) - n, "  no contact (> %.0f A)", cmap.cutoff);
+    out += buf;
+    out += "   [wasd] move cursor";
+}
+
+void UnicodeScreen::set_hover_labels(bool enabled) {
+    hover_labels = enabled;
+    // any-motion tracking, SGR coordinates
+    const char* mode = enabled ? "\033[?1003h\033[?1006h" : "\033[?1003l\033[?1006l";
+    write(STDOUT_FILENO, mode, strlen(mode));
+    if (!enabled) hover_col = hover_row = -1;
+}
+
+void UnicodeScreen::hover_label(std::string& out) {
+    const char* hint = "   [h] hide labels";
+    if (hover_col < 0) { out += "move the mouse over the structure"; out += hint; return; }
+    // a braille pixel of the cell finds the cell; with Sixel, its middle pixel
+    int x = hover_col * 2, y = hover_row * 4;
+    if (use_sixel) {
+        int cell_w = std::max(1, buf_width / std::max(1, term_cols));
+        int cell_h = (pixel_height > 0) ? pixel_height / std::max(1, term_rows) : 16;
+        x = hover_col * cell_w + cell_w / 2;
+        y = hover_row * cell_h + cell_h / 2;
+    }
+    uint32_t id = raster.id_at(x, y);
+    size_t p = id >> 24, r = id & 0xFFFFFF;
+    const AtomTable* t = (id != Rasterizer::NO_ID && p < data.size()) ? &data[p]->get_atom_table() : nullptr;
+    if (!t || r >= t->size()) { out += "-"; out += hint; return; }
+
+    const char* ss = (t->ss[r] == 'H') ? "helix" : (t->ss[r] == 'S') ? "sheet" : "coil";
+    char buf[96];
+    snprintf(buf, sizeof(buf), "%s:%d %c  %s", t->chain_names[t->chain[r]].c_str(), t->resnum[r], t->aa[r], ss);
+    out += buf;
+    if (data.size() > 1) {
+        snprintf(buf, sizeof(buf), "  (structure %zu)", p + 1);
+        out += buf;
+    }
+    out += hint;
+}
+
+// Appends ESC [ layer ;2; r;g;b m, 38 for the foreground and 48 for the
+// background, without going through temporary strings
+static void append_sgr(std::string& out, int layer, RGB c) {
+    char buf[24] = {'\033', '['};
+    int n = 2;
+    auto put = [&](int v) {
+        if (v >= 100) buf[n++] = (char)('0' + v / 100);
+        if (v >= 10) buf[n++] = (char)('0' + v / 10 % 10);
+        buf[n++] = (char)('0' + v % 10);
+    };
+    put(layer);
+    buf[n++] = ';';
+    buf[n++] = '2';
+    for (int v : {c.r, c.g, c.b}) {
+        buf[n++] = ';';
+        put(v);
+    }
+    buf[n++] = 'm';
+    out.append(buf, n);
+}
+
 // --- Braille rendering ---
 
-std::string UnicodeScreen::render_braille() {
-    std::string out;
-    out.reserve(term_cols * (term_rows - info_rows) * 30);
+void UnicodeScreen::render_braille(std::string& out) {
     out += "\033[H";
 
+    // the rasterizer already holds each cell's dots and nearest color
     int cell_rows = buf_height / 4;
     int cell_cols = buf_width / 2;
-
-    static const int dot_bits[2][4] = {
-        {0x01, 0x02, 0x04, 0x40},
-        {0x08, 0x10, 0x20, 0x80},
-    };
+    const std::vector<uint32_t>& colors = raster.colors();
+    const std::vector<uint8_t>& dots = raster.dots();
+    const int stride = raster.plane_width();
 
     for (int cr = 0; cr < cell_rows; cr++) {
         for (int cc = 0; cc < cell_cols; cc++) {
-            int pattern = 0;
-            float best_depth = std::numeric_limits<float>::infinity();
-            RGB best_color = {0, 0, 0};
-            bool any_active = false;
-
-            for (int dc = 0; dc < 2; dc++) {
-                for (int dr = 0; dr < 4; dr++) {
-                    int px = cc * 2 + dc;
-                    int py = cr * 4 + dr;
-                    if (px >= buf_width || py >= buf_height) continue;
-                    int idx = py * buf_width + px;
-                    if (framebuffer[idx].active) {
-                        pattern |= dot_bits[dc][dr];
-                        any_active = true;
-                        if (framebuffer[idx].depth < best_depth) {
-                            best_depth = framebuffer[idx].depth;
-                            best_color = {framebuffer[idx].r, framebuffer[idx].g, framebuffer[idx].b};
-                        }
-                    }
-                }
-            }
-
-            if (any_active) {
-                out += "\033[38;2;";
-                out += std::to_string(best_color.r) + ";";
-                out += std::to_string(best_color.g) + ";";
-                out += std::to_string(best_color.b) + "m";
-                out += "\033[48;2;";
-                out += std::to_string(bg_color.r) + ";";
-                out += std::to_string(bg_color.g) + ";";
-                out += std::to_string(bg_color.b) + "m";
+            size_t idx = (size_t)cr * stride + cc;
+            int pattern = dots[idx];
+            if (pattern) {
+                append_sgr(out, 38, Rasterizer::unpack(colors[idx]));
+                append_sgr(out, 48, bg_color);
                 int codepoint = 0x2800 + pattern;
                 out += (char)(0xE0 | ((codepoint >> 12) & 0x0F));
                 out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
                 out += (char)(0x80 | (codepoint & 0x3F));
             } else {
-                out += "\033[48;2;";
-                out += std::to_string(bg_color.r) + ";";
-                out += std::to_string(bg_color.g) + ";";
-                out += std::to_string(bg_color.b) + "m ";
+                append_sgr(out, 48, bg_color);
+                out += ' ';
             }
         }
         if (cr < cell_rows - 1) out += "\033[0m\n";
     }
 
     out += "\033[0m";
-    return out;
 }
 
 // --- Sixel rendering ---
 
-std::string UnicodeScreen::render_sixel() {
-    std::vector<RGBA> pixels(buf_width * buf_height);
+void UnicodeScreen::render_sixel(std::string& out) {
+    const std::vector<uint32_t>& colors = raster.colors();
+    const std::vector<float>& depths = raster.depths();
+    sixel_pixels.resize((size_t)buf_width * buf_height);
     for (int i = 0; i < buf_width * buf_height; i++) {
-        if (framebuffer[i].active) {
-            pixels[i] = {framebuffer[i].r, framebuffer[i].g, framebuffer[i].b, 255};
-        } else {
-            pixels[i] = {bg_color.r, bg_color.g, bg_color.b, 255};
-        }
+        RGB c = (depths[i] != Rasterizer::EMPTY) ? Rasterizer::unpack(colors[i]) : bg_color;
+        sixel_pixels[i] = {c.r, c.g, c.b, 255};
     }
 
-    std::string out;
     out += "\033[H";
-    out += SixelEncoder::encode(pixels, buf_width, buf_height,
-                                bg_color.r, bg_color.g, bg_color.b);
-    return out;
+    sixel.encode(out, sixel_pixels, buf_width, buf_height, bg_color.r, bg_color.g, bg_color.b);
 }
 
 // --- View mode name ---
@@ -1157,14 +1856,16 @@ const char* UnicodeScreen::view_mode_name() {
         case ViewMode::BACKBONE: return "backbone";
         case ViewMode::GRID:    return "grid";
         case ViewMode::SURFACE: return "surface";
+        case ViewMode::ATOMS:   return "atoms";
+        case ViewMode::CONTACT_MAP: return "contacts";
+        default: break;
     }
     return "unknown";
 }
 
 // --- Info overlay ---
 
-std::string UnicodeScreen::render_info_overlay() {
-    std::string out;
+void UnicodeScreen::render_info_overlay(std::string& out) {
     out += "\033[0m\n";
 
     RGB accent = palette_colors.empty() ? fg_color : palette_colors[0];
@@ -1175,48 +1876,96 @@ std::string UnicodeScreen::render_info_overlay() {
                    (uint8_t)(fg_color.g / 3),
                    (uint8_t)(fg_color.b / 3)};
 
-    auto set_fg = [](RGB c) -> std::string {
-        return "\033[38;2;" + std::to_string(c.r) + ";" +
-               std::to_string(c.g) + ";" + std::to_string(c.b) + "m";
-    };
+    // everything is appended piece by piece, so a frame builds no temporaries
+    auto set_fg = [&out](RGB c) { append_sgr(out, 38, c); };
 
     for (size_t i = 0; i < data.size(); i++) {
         auto* p = data[i];
 
         // PDB ID or filename (accent color)
-        std::string pid = p->get_pdb_id();
-        if (pid.empty()) {
-            pid = p->get_file_name();
-            size_t slash = pid.find_last_of('/');
-            if (slash != std::string::npos) pid = pid.substr(slash + 1);
+        set_fg(accent);
+        out += ' ';
+        if (!p->get_pdb_id().empty()) {
+            out += p->get_pdb_id();
+        } else {
+            const std::string& name = p->get_file_name();
+            size_t slash = name.find_last_of('/');
+            out.append(name, (slash != std::string::npos) ? slash + 1 : 0, std::string::npos);
         }
-        out += set_fg(accent) + " " + pid;
 
         // Title (dim)
-        std::string title = p->get_title();
+        const std::string& title = p->get_title();
         if (!title.empty()) {
-            std::string tc = title_case(title);
-            if ((int)tc.size() > term_cols / 2) tc = tc.substr(0, term_cols / 2 - 3) + "...";
-            out += set_fg(dim_fg) + "  " + tc;
+            set_fg(dim_fg);
+            out += "  ";
+            size_t max_len = std::max(term_cols / 2, 3);
+            size_t start = out.size();
+            append_title_case(out, title);
+            if (out.size() - start > max_len) {
+                out.resize(start + max_len - 3);
+                out += "...";
+            }
+        }
+
+        // Search score of the hit against the query
+        if (search_hit_idx >= 0 && i == 1) {
+            char tm[48];
+            snprintf(tm, sizeof(tm), "  TM %.2f (#%d/%zu)", search_hits[search_hit_idx].tm,
+                     search_hit_idx + 1, search_hits.size());
+            set_fg(accent);
+            out += tm;
         }
 
         // Chain/residue stats
-        auto chain_lengths = p->get_chain_length();
-        auto residue_counts = p->get_residue_count();
+        const auto& residue_counts = p->get_residue_count();
         int total_res = 0, total_chains = 0;
-        for (const auto& [cid, len] : chain_lengths) {
+        for (const auto& [cid, atoms] : p->get_atoms()) {
             total_chains++;
             auto it = residue_counts.find(cid);
             if (it != residue_counts.end()) total_res += it->second;
         }
-        out += set_fg(dim_fg) + "  " + std::to_string(total_chains) + " chain" +
-               (total_chains > 1 ? "s" : "") + ", " +
-               std::to_string(total_res) + " res";
+        char counts[64];
+        snprintf(counts, sizeof(counts), "  %d chain%s, %d res", total_chains, total_chains > 1 ? "s" : "", total_res);
+        set_fg(dim_fg);
+        out += counts;
 
         // Mode tags
-        out += set_fg(dim2_fg) + "  [" + std::string(view_mode_name()) + "]" +
-               " [" + std::string(color_scheme_name()) + "]" +
-               " [" + std::string(palette_name()) + "]";
+        set_fg(dim2_fg);
+        out += "  [";
+        out += view_mode_name();
+        out += "] [";
+        out += color_scheme_name();
+        out += "] [";
+        out += palette_name();
+        out += "]";
+        if (i == 0 && density.is_open()) {
+            char tag[32];
+            snprintf(tag, sizeof(tag), " [map %.1f\xCF\x83]", density_sigma);
+            out += tag;
+        }
+        if (i == 0 && show_stats) {
+            const Rasterizer::Stats& st = raster.stats();
+            size_t tested = st.drawn + st.culled;
+            char tag[48];
+            snprintf(tag, sizeof(tag), " [cull %d%% overdraw %.2fx]",
+                     tested ? (int)(100 * st.culled / tested) : 0, st.overdraw());
+            out += tag;
+#ifdef PDBTERM_COUNT_ALLOCS
+            snprintf(tag, sizeof(tag), " [alloc %zu]", frame_allocs);
+            out += tag;
+#endif
+        }
+        if (p == nma_protein && nma_mode > 0) {
+            if (!nma_applied) {
+                out += " [modes computing]";
+            } else {
+                char tag[32];
+                snprintf(tag, sizeof(tag), " [mode %d%s]", nma_mode, morph_playing ? "" : " paused");
+                out += tag;
+            }
+        } else if (p->is_morphing()) {
+            out += morph_playing ? " [morph]" : " [morph paused]";
+        }
 
         out += "\033[0m";
         if (i < data.size() - 1) out += "\n";
@@ -1224,7 +1973,9 @@ std::string UnicodeScreen::render_info_overlay() {
 
     // Second line: sidebar info (method, resolution, weight, organism, etc.) joined compactly
     if (!sidebar_info.empty()) {
-        out += "\n" + set_fg(dim2_fg) + " ";
+        out += '\n';
+        set_fg(dim2_fg);
+        out += ' ';
         bool first = true;
         for (const auto& info_line : sidebar_info) {
             if (info_line.empty()) continue;
@@ -1235,7 +1986,29 @@ std::string UnicodeScreen::render_info_overlay() {
         out += "\033[0m";
     }
 
-    return out;
+    if (view_mode == ViewMode::CONTACT_MAP || hover_labels) {
+        out += '\n';
+        set_fg(dim_fg);
+        out += ' ';
+        if (view_mode == ViewMode::CONTACT_MAP) contact_cursor_label(out);
+        else hover_label(out);
+        out += "\033[0m";
+    }
+
+    if (prompt_active) {
+        out += '\n';
+        set_fg(accent);
+        out += " select> ";
+        set_fg(fg_color);
+        out += prompt_text;
+        out += "_\033[0m";
+    } else if (!prompt_status.empty()) {
+        out += '\n';
+        set_fg(dim_fg);
+        out += ' ';
+        out += prompt_status;
+        out += "\033[0m";
+    }
 }
 
 // --- Left sidebar with protein info ---
@@ -1353,6 +2126,8 @@ std::string UnicodeScreen::render_sidebar() {
 // --- Main draw ---
 
 void UnicodeScreen::draw_screen() {
+    size_t allocs_before = heap_allocations();
+    arena.reset();
     int old_w = buf_width, old_h = buf_height;
     query_terminal_size();
 
@@ -1360,40 +2135,91 @@ void UnicodeScreen::draw_screen() {
     sidebar_cols = 0;
 
     if (buf_width != old_w || buf_height != old_h)
-        framebuffer.resize(buf_width * buf_height);
+        raster.resize(buf_width, buf_height, raster_target());
 
     auto_rotate_step();
+    nma_step();
+    morph_step();
+    if (color_scheme == ColorScheme::EXPOSURE)
+        for (auto* p : data) p->compute_exposure();
+    if (color_scheme == ColorScheme::INTERFACE)
+        for (auto* p : data) p->compute_interface();
     clear_framebuffer();
 
     switch (view_mode) {
         case ViewMode::BACKBONE: project_backbone(); break;
         case ViewMode::GRID:     project_grid();     break;
         case ViewMode::SURFACE:  project_surface();  break;
+        case ViewMode::ATOMS:    project_full_atoms(); break;
+        case ViewMode::CONTACT_MAP: project_contact_map(); break;
+        default: break;
     }
+    project_density();
+    raster.flush();
 
-    // Compose all output into a single buffer to avoid flickering
-    std::string frame;
-    frame.reserve(term_cols * term_rows * 30);
+    // Compose all output into a single buffer to avoid flickering; it keeps
+    // its capacity, so only a larger terminal makes it grow
+    frame.clear();
+    frame.reserve((size_t)term_cols * term_rows * 30);
 
     if (use_sixel)
-        frame += render_sixel();
+        render_sixel(frame);
     else
-        frame += render_braille();
-    frame += render_info_overlay();
+        render_braille(frame);
+    render_info_overlay(frame);
 
     write(STDOUT_FILENO, frame.c_str(), frame.size());
+    frame_allocs = heap_allocations() - allocs_before;
 }
 
 // --- Input handling ---
 
-bool UnicodeScreen::handle_input() {
+// Arrow keys become WASD outside the prompt and nothing inside it; mouse
+// reports, which come with every motion while hover labels are on, move the
+// hover cell and are skipped. Only an ESC with nothing after it is returned
+// as a key, the one that cancels the prompt.
+char UnicodeScreen::read_key() {
     struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
-    if (poll(&pfd, 1, 0) <= 0) return true;
-
     char c;
-    if (read(STDIN_FILENO, &c, 1) != 1) return true;
+    while (poll(&pfd, 1, 0) > 0 && read(STDIN_FILENO, &c, 1) == 1) {
+        if (c != '\033') return c;
+        std::string seq;
+        char k;
+        while (poll(&pfd, 1, 0) > 0 && read(STDIN_FILENO, &k, 1) == 1) {
+            seq += k;
+            if (seq.size() > 1 && (isalpha((unsigned char)k) || k == '~')) break;
+        }
+        if (seq.empty()) return c;
+        int b, col, row;
+        if (seq.size() == 2 && seq[0] == '[' && seq[1] >= 'A' && seq[1] <= 'D') {
+            if (!prompt_active) return "wsda"[seq[1] - 'A'];
+        } else if (seq.size() > 2 && seq[1] == '<' && sscanf(seq.c_str() + 2, "%d;%d;%d", &b, &col, &row) == 3) {
+            hover_col = col - 1;
+            hover_row = row - 1;
+        }
+    }
+    return 0;
+}
+
+bool UnicodeScreen::handle_input() {
+    char c = read_key();
+    if (!c) return true;
+
+    if (prompt_active) {
+        // drain what is buffered so typing is not paced by the frame rate
+        do handle_prompt_key(c);
+        while (prompt_active && (c = read_key()));
+        return true;
+    }
 
     float pan_step = 0.05f;
+    // cursor moves one map pixel, however many residues that covers
+    int contact_step = 1;
+    if (view_mode == ViewMode::CONTACT_MAP && focus_protein()) {
+        int n = (int)focus_protein()->get_contact_map().size();
+        int bins = std::max(1, std::min({buf_width, buf_height, n}));
+        contact_step = std::max(1, n / bins);
+    }
 
     switch (c) {
         case '0': structNum = -1; break;
@@ -1402,23 +2228,27 @@ bool UnicodeScreen::handle_input() {
             break;
         case 'v': case 'V': {
             int m = (int)view_mode;
-            m = (m + 1) % 3;
+            m = (m + 1) % (int)ViewMode::VIEW_MODE_COUNT;
             view_mode = (ViewMode)m;
             break;
         }
         case 'a': case 'A':
+            if (view_mode == ViewMode::CONTACT_MAP) { contact_cursor_j -= contact_step; break; }
             if (structNum >= 0) pan_x[structNum] -= pan_step;
             else for (auto& px : pan_x) px -= pan_step;
             break;
         case 'd': case 'D':
+            if (view_mode == ViewMode::CONTACT_MAP) { contact_cursor_j += contact_step; break; }
             if (structNum >= 0) pan_x[structNum] += pan_step;
             else for (auto& px : pan_x) px += pan_step;
             break;
         case 'w': case 'W':
+            if (view_mode == ViewMode::CONTACT_MAP) { contact_cursor_i -= contact_step; break; }
             if (structNum >= 0) pan_y[structNum] += pan_step;
             else for (auto& py : pan_y) py += pan_step;
             break;
         case 's': case 'S':
+            if (view_mode == ViewMode::CONTACT_MAP) { contact_cursor_i += contact_step; break; }
             if (structNum >= 0) pan_y[structNum] -= pan_step;
             else for (auto& py : pan_y) py -= pan_step;
             break;
@@ -1443,9 +2273,36 @@ bool UnicodeScreen::handle_input() {
         case ' ':
             auto_rotate = !auto_rotate;
             break;
+        case 'm': case 'M':
+            morph_playing = !morph_playing;
+            break;
+        case '+': case '=':
+            if (density.is_open()) set_density_sigma(density_sigma + 0.1f);
+            break;
+        case '-': case '_':
+            if (density.is_open()) set_density_sigma(density_sigma - 0.1f);
+            break;
+        case 'e': case 'E': {
+            // the morph between two inputs owns the animation
+            if (morph_mode || !focus_protein()) break;
+            if (nma_protein != focus_protein()) {
+                if (nma_protein) nma_protein->stop_morph();
+                nma_protein = focus_protein();
+                nma_mode = 0;
+            }
+            nma_protein->stop_morph();
+            nma_mode = (nma_mode + 1) % (NMA_MODES + 1);
+            nma_applied = false;
+            if (nma_mode > 0) nma_protein->request_modes(NMA_MODES);
+            break;
+        }
+        case 't': case 'T':
+            screen_show_structure = !screen_show_structure;
+            for (auto* p : data) p->set_show_structure(screen_show_structure);
+            break;
         case 'c': case 'C': {
             int s = (int)color_scheme;
-            s = (s + 1) % 3;
+            s = (s + 1) % (int)ColorScheme::COLOR_SCHEME_COUNT;
             color_scheme = (ColorScheme)s;
             break;
         }
@@ -1459,6 +2316,20 @@ bool UnicodeScreen::handle_input() {
         case 'n': case 'N':
             if (random_mode) load_random_pdb();
             break;
+        case ']':
+            if (search_hit_idx >= 0 && search_hit_idx + 1 < (int)search_hits.size())
+                show_search_hit(search_hit_idx + 1);
+            break;
+        case '[':
+            if (search_hit_idx > 0) show_search_hit(search_hit_idx - 1);
+            break;
+        case '/':
+            prompt_active = true;
+            prompt_text.clear();
+            break;
+        case 'h': case 'H':
+            set_hover_labels(!hover_labels);
+            break;
         case 'q': case 'Q':
             return false;
     }
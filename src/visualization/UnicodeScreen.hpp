@@ -4,32 +4,39 @@
 #include "RenderPoint.hpp"
 #include "Palette.hpp"
 #include "SixelEncoder.hpp"
+#include "StructureSearch.hpp"
+#include "DensityMap.hpp"
+#include "Rasterizer.hpp"
+#include "FrameArena.hpp"
 #include <vector>
 #include <string>
 #include <cmath>
 #include <map>
+#include <memory_resource>
 #include <cstdint>
 
-struct RGB {
-    uint8_t r, g, b;
-};
-
-struct Pixel {
-    uint8_t r, g, b;
-    float depth;
-    bool active;
+// Camera used by project_atoms, for projecting anything else the same way.
+struct ProjParams {
+    float cx, cy, cz;
+    float fovRads, half_w, half_h, scale;
 };
 
 enum class ViewMode {
     BACKBONE,
     GRID,
     SURFACE,
+    ATOMS,
+    CONTACT_MAP,
+    VIEW_MODE_COUNT,    // sentinel for cycling
 };
 
 enum class ColorScheme {
     RAINBOW,     // gradient along full sequence
     CHAIN,       // each chain gets a distinct color
     STRUCTURE,   // by secondary structure (helix/sheet/coil)
+    EXPOSURE,    // by relative solvent accessible area, buried to exposed
+    INTERFACE,   // residues near another chain in their chain color, the rest gray
+    COLOR_SCHEME_COUNT,  // sentinel for cycling
 };
 
 enum class PaletteType {
@@ -52,6 +59,19 @@ public:
     void set_tmatrix();
     void set_utmatrix(const std::string& utmatrix, bool onlyU);
     void set_chainfile(const std::string& chainfile, int filesize);
+    void set_align(bool enabled) { align_structures = enabled; }
+    // morph the first of two structures into the second, implies alignment
+    void set_morph(bool enabled) { morph_mode = enabled; }
+    // culling and overdraw of the last frame in the overlay
+    void set_show_stats(bool enabled) { show_stats = enabled; }
+    // heap allocations of the last draw_screen, counted with PDBTERM_COUNT_ALLOCS
+    size_t last_frame_allocations() const { return frame_allocs; }
+    void run_search(const std::string& query_file, const std::string& dir);
+    // "<action> <selection>", see SelectionCommand; false on a parse error
+    bool run_selection(const std::string& command);
+    // CCP4/MRC map in the frame of the first structure, contoured at
+    // mean + sigma * rms; false if it cannot be read
+    bool load_map(const std::string& path, float sigma);
 
     void set_random_mode(bool enabled);
     bool load_random_pdb();
@@ -63,7 +83,9 @@ public:
     void enter_raw_mode();
     void exit_raw_mode();
 
-    bool write_framebuffer_png(const std::string& path);
+    // headless width x height image, drawn at ssaa times the size and
+    // averaged down (1 to Rasterizer::MAX_SSAA)
+    bool write_framebuffer_png(const std::string& path, int width = 1280, int height = 720, int ssaa = 1);
 
 private:
     int term_cols = 80;
@@ -75,7 +97,16 @@ private:
 
     void query_terminal_size();
 
-    std::vector<Pixel> framebuffer;
+    // primitives are recorded by the views and drawn at once by flush
+    Rasterizer raster;
+
+    // Scratch of the frame being drawn, rewound by draw_screen; the frame's
+    // text and Sixel pixels keep their buffers from one frame to the next
+    FrameArena arena;
+    std::string frame;
+    std::vector<RGBA> sixel_pixels;
+    SixelEncoder sixel;
+    size_t frame_allocs = 0;        // heap allocations of the last frame, see heap_allocations
 
     // Colors and palettes
     std::vector<RGB> palette_colors;
@@ -98,41 +129,116 @@ private:
     std::vector<std::string> chainVec;
     float** vectorpointer = nullptr;
     bool yesUT = false;
+    bool align_structures = false;
+    void superpose_proteins();
+
+    // Directory search: data = {query, current hit}
+    std::vector<SearchHit> search_hits;
+    int search_hit_idx = -1;
+    std::string search_query;
+    std::string search_query_chains = "-";
+    void show_search_hit(int idx);
 
     BoundingBox global_bb;
     std::string screen_mode;
     bool screen_show_structure;
     int structNum = -1;
+    ProjParams view_cam{};          // camera of the last 3D view drawn
     float zoom_level = 3.8f;
     float focal_offset = 5.0f;
 
+    // Contact map cursor, residue indices into the shown structure
+    int contact_cursor_i = 0;
+    int contact_cursor_j = 0;
+    // the selected structure, or the first while all are selected
+    Protein* focus_protein();
+    void contact_cursor_label(std::string& out);
+
+    // Hover labels: the terminal reports mouse motion, the residue under the
+    // mouse is read back from the rasterizer
+    bool hover_labels = false;
+    int hover_col = -1, hover_row = -1;     // terminal cell, from 0
+    // next key buffered on stdin, 0 if none; escape sequences are taken apart
+    // first, so a mouse report never reaches the prompt or the view keys
+    char read_key();
+    void set_hover_labels(bool enabled);
+    void hover_label(std::string& out);
+
+    // Selections, re-applied whenever structures are reloaded
+    std::vector<SelectionCommand> selections;
+    bool prompt_active = false;
+    std::string prompt_text;
+    std::string prompt_status;
+    void apply_selections();
+    bool handle_prompt_key(char c);
+
+    // Density map, meshed around the first structure
+    DensityMap density;
+    float density_sigma = 1.5f;
+    void set_density_sigma(float sigma);
+
     // Auto-rotation
     bool auto_rotate = true;
     float rotation_speed = 0.02f;
 
+    // Morph between two conformations, played back and forth
+    bool morph_mode = false;
+    bool morph_playing = true;
+    float morph_phase = 0.0f;       // [0, 2), the way back is the second half
+    float morph_speed = 0.015f;     // phase per frame
+    void start_morph();
+    void morph_step();
+
+    // Normal modes of the focused structure, cycled with 'e' and played
+    // through the morph above
+    static const int NMA_MODES = 3;
+    Protein* nma_protein = nullptr;
+    int nma_mode = 0;               // 0 off, else the mode shown, lowest first
+    bool nma_applied = false;       // false while the modes are computed
+    void nma_step();
+
     void auto_rotate_step();
     void project_backbone();
     void project_grid();
     void project_surface();
+    void project_full_atoms();
+    void project_contact_map();
+    void project_density();
     void clear_framebuffer();
 
+    // id : what hovering the primitive names, see residue_id
     void draw_line(int x0, int y0, float z0,
                    int x1, int y1, float z1,
-                   RGB color, float brightness);
+                   RGB color, float brightness, float occlusion = 1.0f, uint32_t id = Rasterizer::NO_ID);
 
     void draw_filled_circle(int cx, int cy, float z, int radius,
-                            RGB color, float brightness);
+                            RGB color, float brightness, float occlusion = 1.0f, uint32_t id = Rasterizer::NO_ID);
+
+    void draw_triangle(const RasterVertex& v0, const RasterVertex& v1, const RasterVertex& v2,
+                       uint32_t id = Rasterizer::NO_ID);
 
-    void plot_pixel(int x, int y, float z, RGB color, float brightness);
+    void plot_pixel(int x, int y, float z, RGB color, float brightness, float occlusion = 1.0f,
+                    uint32_t id = Rasterizer::NO_ID);
 
-    RGB depth_shade(RGB color, float brightness);
     RGB get_color_for_point(int point_idx, int total_points);
     RGB get_chain_color(int chain_idx, int total_chains);
     RGB get_ss_color(char ss_type);
+    RGB get_exposure_color(float exposure);
+    RGB get_interface_color(bool interface, int chain_idx, int total_chains);
+    // color under scheme S; idx counts points over all structures. The scheme
+    // is a template argument so view kernels resolve it once per frame
+    template <ColorScheme S>
+    RGB scheme_color(int idx, int total, int chain_idx, int total_chains,
+                     char ss_type, float exposure, bool interface);
+    // scheme colors of a structure's residues with selection overrides, and
+    // their trace atoms; ca_base/chain_base offset it among all structures
+    void residue_colors(Protein* p, int ca_base, int total_ca, int chain_base, int total_chains,
+                        std::pmr::vector<RGB>& colors, std::pmr::vector<const Atom*>& trace);
 
-    std::string render_braille();
-    std::string render_sixel();
-    std::string render_info_overlay();
+    // append to out
+    void render_braille(std::string& out);
+    void render_sixel(std::string& out);
+    void render_info_overlay(std::string& out);
     std::string render_sidebar();
 
     const char* view_mode_name();
@@ -142,6 +248,14 @@ private:
 
     bool use_sixel = false;
     bool random_mode = false;
+    // braille cells are rasterized as such, Sixel and PNG need pixels
+    Rasterizer::Target raster_target() const {
+        return use_sixel ? Rasterizer::Target::PIXELS : Rasterizer::Target::BRAILLE;
+    }
+    bool show_stats = false;
+    // framebuffer pixels per image pixel while supersampling; line widths and
+    // dot radii scale with it so they keep their size in the image
+    int px_scale = 1;
     int pixel_width = 0;
     int pixel_height = 0;
     bool raw_mode_active = false;
@@ -150,6 +264,7 @@ private:
     static const std::vector<std::string> notable_pdbs;
     std::string download_pdb(const std::string& pdb_id);
     void reload_protein(const std::string& filepath);
+    void clear_proteins();
 
     // Sidebar info (fetched from RCSB API, cached to ~/.cache/pdbterm/)
     std::vector<std::string> sidebar_info;
@@ -0,0 +1,54 @@
+// The steady frame loop stays off the heap: after a warm-up, every
+// draw_screen of an auto-rotating structure makes no heap allocation, on
+// both the braille and the Sixel backend. Built with PDBTERM_COUNT_ALLOCS;
+// the count is the frame thread's, so the surface build that loading starts
+// in the background does not make the result depend on its timing.
+//
+//   frame_alloc_test file.cif
+#include "UnicodeScreen.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// one full turn at the default rotation speed
+static const int TURN = 315;
+
+static int check(const std::string& path, bool sixel) {
+    UnicodeScreen screen(true, "protein", sixel);
+    screen.set_chainfile("", 1);
+    screen.set_protein(path, 0, true);
+    screen.set_tmatrix();
+    screen.normalize_proteins("");
+
+    // the frames themselves go to /dev/null, the report to stderr
+    int saved = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    // two turns to reach the largest arena and bins any orientation needs
+    for (int f = 0; f < 2 * TURN; f++) screen.draw_screen();
+    size_t worst = 0, total = 0;
+    for (int f = 0; f < TURN; f++) {
+        screen.draw_screen();
+        worst = std::max(worst, screen.last_frame_allocations());
+        total += screen.last_frame_allocations();
+    }
+    dup2(saved, STDOUT_FILENO);
+    close(null_fd);
+    close(saved);
+
+    fprintf(stderr, "%-8s %d frames, %zu allocations, at most %zu in one frame  %s\n",
+            sixel ? "sixel" : "braille", TURN, total, worst, total ? "FAIL" : "ok");
+    return total ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: frame_alloc_test file.cif\n");
+        return 2;
+    }
+    return check(argv[1], false) | check(argv[1], true);
+}
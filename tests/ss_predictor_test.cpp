@@ -0,0 +1,208 @@
+// SSPredictor labels against the scalar predictor it replaced: the SIMD
+// feature kernel, the prefix-sum break test and the lazy torsion must give
+// the same label on every residue.
+//
+//   ss_predictor_test file.cif ...
+//
+// Each file is checked as read, in Angstrom as Protein predicts on it, with
+// perturbed copies of its chains, and as one many-chain structure;
+// random-walk chains cover break and torsion cases the files lack.
+#include "SSPredictor.hpp"
+#include "StructureSearch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace reference {
+
+// the scalar path as it was before the SIMD kernel, one window at a time
+
+float dist(const Atom& a, const Atom& b) {
+    float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+    return std::sqrt(dx*dx + dy*dy + dz*dz);
+}
+
+void cross(const float a[3], const float b[3], float out[3]) {
+    out[0] = a[1]*b[2] - a[2]*b[1];
+    out[1] = a[2]*b[0] - a[0]*b[2];
+    out[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+float dot(const float a[3], const float b[3]) {
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+void sub(const Atom& p, const Atom& q, float out[3]) {
+    out[0] = p.x - q.x; out[1] = p.y - q.y; out[2] = p.z - q.z;
+}
+
+float torsion_deg(const Atom& a, const Atom& b, const Atom& c, const Atom& d) {
+    float b1[3], b2[3], b3[3];
+    sub(b, a, b1); sub(c, b, b2); sub(d, c, b3);
+    float n1[3], n2[3];
+    cross(b1, b2, n1);
+    cross(b2, b3, n2);
+    float b2n[3] = { b2[0], b2[1], b2[2] };
+    float nn = std::sqrt(dot(b2n, b2n));
+    if (nn > 1e-8f) { b2n[0]/=nn; b2n[1]/=nn; b2n[2]/=nn; }
+    float m1[3];
+    cross(n1, b2n, m1);
+    return std::atan2(dot(m1, n2), dot(n1, n2)) * 180.0f / 3.14159265358979323846f;
+}
+
+void squash_short_segments(std::vector<char>& lab, char target, int min_len) {
+    size_t i = 0;
+    while (i < lab.size()) {
+        if (lab[i] != target) { ++i; continue; }
+        size_t j = i;
+        while (j < lab.size() && lab[j] == target) ++j;
+        if ((int)(j - i) < min_len)
+            for (size_t k = i; k < j; ++k) lab[k] = 'x';
+        i = j;
+    }
+}
+
+std::vector<char> labels(const SSPredictor& p, const std::vector<Atom>& A) {
+    const size_t n = A.size();
+    std::vector<char> is_break(n, 0);
+    for (size_t i = 0; i + 1 < n; ++i)
+        if (dist(A[i], A[i+1]) * p.scale > p.break_gap) is_break[i] = 1;
+    auto unbroken = [&](size_t i, size_t j) {
+        if (i > j) std::swap(i, j);
+        for (size_t k = i; k < j; ++k) if (is_break[k]) return false;
+        return true;
+    };
+
+    std::vector<int> hs(n, 0), es(n, 0);
+    for (size_t i = 0; n >= 4 && i + 3 < n; ++i) {
+        if (!unbroken(i, i+3)) continue;
+        float d13 = dist(A[i], A[i+2]) * p.scale;
+        float d14 = dist(A[i], A[i+3]) * p.scale;
+        float at = std::fabs(torsion_deg(A[i], A[i+1], A[i+2], A[i+3]));
+        int h = 0, e = 0;
+        if (d13 >= p.d13_helix_min && d13 <= p.d13_helix_max) h++;
+        if (d14 >= p.d14_helix_min && d14 <= p.d14_helix_max) h++;
+        if (at >= p.tors_helix_abs_min && at <= p.tors_helix_abs_max) h++;
+        if (d13 >= p.d13_beta_min) e++;
+        if (d14 >= p.d14_beta_min) e++;
+        if (at >= p.tors_beta_abs_min) e++;
+        if (h >= 2) { hs[i+1]++; hs[i+2]++; }
+        if (e >= 2) { es[i+1]++; es[i+2]++; }
+    }
+
+    std::vector<char> lab(n, 'x');
+    for (size_t i = 0; i < n; ++i) {
+        if (hs[i] >= p.vote_threshold && hs[i] > es[i]) lab[i] = 'H';
+        else if (es[i] >= p.vote_threshold && es[i] > hs[i]) lab[i] = 'S';
+    }
+    if (p.smooth_island >= 1) {
+        for (char t : {'H', 'S'}) {
+            size_t i = 0;
+            while (i < n) {
+                if (lab[i] != t) { ++i; continue; }
+                size_t j = i;
+                while (j < n && lab[j] == t) ++j;
+                if ((int)(j - i) <= p.smooth_island) {
+                    bool across = (i > 0 && !unbroken(i-1, i)) || (j < n && !unbroken(j-1, j));
+                    if (!across)
+                        for (size_t k = i; k < j; ++k) lab[k] = 'x';
+                }
+                i = j;
+            }
+        }
+    }
+    squash_short_segments(lab, 'H', p.helix_min_len);
+    squash_short_segments(lab, 'S', p.beta_min_len);
+    return lab;
+}
+
+} // namespace reference
+
+static int failures = 0;
+
+static void check(const std::string& name, std::map<std::string, std::vector<Atom>> chains) {
+    SSPredictor predictor;
+    std::map<std::string, std::vector<char>> expected;
+    size_t residues = 0;
+    for (const auto& [cid, atoms] : chains) {
+        expected[cid] = reference::labels(predictor, atoms);
+        residues += atoms.size();
+    }
+    predictor.run(chains);
+
+    size_t diff = 0;
+    for (const auto& [cid, atoms] : chains)
+        for (size_t i = 0; i < atoms.size(); i++)
+            if (atoms[i].get_structure() != expected[cid][i]) {
+                if (diff++ < 5)
+                    fprintf(stderr, "  %s chain %s residue %zu: %c, scalar %c\n", name.c_str(),
+                            cid.c_str(), i, atoms[i].get_structure(), expected[cid][i]);
+            }
+    printf("%-40s %3zu chains %7zu residues  %s\n", name.c_str(), chains.size(), residues,
+           diff ? "MISMATCH" : "ok");
+    if (diff) failures++;
+}
+
+static std::vector<Atom> jittered(const std::vector<Atom>& atoms, float sigma, std::mt19937& rng) {
+    std::normal_distribution<float> noise(0.0f, sigma);
+    std::vector<Atom> out = atoms;
+    for (Atom& a : out) a.set_position(a.x + noise(rng), a.y + noise(rng), a.z + noise(rng));
+    return out;
+}
+
+// 3.8 A steps whose bond and torsion angles drift, with the odd chain break
+static std::vector<Atom> random_walk(size_t n, std::mt19937& rng) {
+    std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+    std::vector<Atom> out;
+    float p[3] = {0, 0, 0}, d[3] = {1, 0, 0};
+    for (size_t i = 0; i < n; i++) {
+        float step = (rng() % 97 == 0) ? 7.0f : 3.8f;
+        for (int c = 0; c < 3; c++) d[c] += 0.8f * u(rng);
+        float len = std::sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+        for (int c = 0; c < 3; c++) p[c] += step * d[c] / len;
+        out.emplace_back(p[0], p[1], p[2]);
+    }
+    return out;
+}
+
+int main(int argc, char** argv) {
+    std::mt19937 rng(28);
+    std::map<std::string, std::vector<Atom>> combined;
+
+    for (int a = 1; a < argc; a++) {
+        CATrace trace;
+        if (!StructureSearch::read_ca_trace(argv[a], trace)) {
+            fprintf(stderr, "cannot read %s\n", argv[a]);
+            return 1;
+        }
+        std::map<std::string, std::vector<Atom>> chains;
+        for (size_t i = 0; i < trace.size(); i++)
+            chains[trace.chain[i]].emplace_back(trace.x[i], trace.y[i], trace.z[i]);
+        std::string name = argv[a];
+        name = name.substr(name.find_last_of('/') + 1);
+
+        check(name, chains);
+        for (float sigma : {0.05f, 0.2f, 0.5f}) {
+            std::map<std::string, std::vector<Atom>> noisy;
+            for (int copy = 0; copy < 8; copy++)
+                for (const auto& [cid, atoms] : chains)
+                    noisy[cid + std::to_string(copy)] = jittered(atoms, sigma, rng);
+            char label[64];
+            snprintf(label, sizeof(label), " (8 copies, %.2f A noise)", sigma);
+            check(name + label, noisy);
+        }
+        for (const auto& [cid, atoms] : chains) combined[std::to_string(a) + cid] = atoms;
+    }
+    if (!combined.empty()) check("all files as one structure", combined);
+
+    std::map<std::string, std::vector<Atom>> walks;
+    for (int c = 0; c < 40; c++) walks["W" + std::to_string(c)] = random_walk(50 + rng() % 2000, rng);
+    check("random walks", walks);
+
+    return failures ? 1 : 0;
+}